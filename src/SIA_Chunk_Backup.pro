@@ -16,7 +16,17 @@ SOURCES += main.cpp \
     config.cpp \
     database.cpp \
     siacom.cpp \
-    archivebuilder.cpp
+    archivebuilder.cpp \
+    chunkbuilder.cpp \
+    defragplanner.cpp \
+    restoreengine.cpp \
+    cryptostream.cpp \
+    metrics.cpp \
+    progressreporter.cpp \
+    clustercandidates.cpp \
+    uploadscheduler.cpp \
+    compressionpolicy.cpp \
+    solidcompressor.cpp
 
 # The following define makes your compiler emit warnings if you use
 # any feature of Qt which as been marked deprecated (the exact warnings
@@ -37,6 +47,16 @@ HEADERS += \
     siacom.h \
     apptypeutils.h \
     archivebuilder.h \
+    chunkbuilder.h \
+    defragplanner.h \
+    restoreengine.h \
+    cryptostream.h \
+    metrics.h \
+    progressreporter.h \
+    clustercandidates.h \
+    uploadscheduler.h \
+    compressionpolicy.h \
+    solidcompressor.h \
     libarchive/archive.h \
     libarchive/archive_entry.h
 
@@ -47,3 +67,11 @@ DISTFILES +=
 
 win32:LIBS += $$_PRO_FILE_PWD_/bin/win/libarchive.dll
 unix:LIBS  += $$_PRO_FILE_PWD_/bin/linux/libarchive.so
+
+# OpenSSL (libcrypto) for the encryption
+win32:LIBS += -llibcrypto
+unix:LIBS  += -lcrypto
+
+# zstd for the solid compression
+win32:LIBS += -llibzstd
+unix:LIBS  += -lzstd
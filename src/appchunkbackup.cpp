@@ -14,6 +14,8 @@ AppChunkBackup::AppChunkBackup(int &argc, char **argv) : QCoreApplication(argc,
     //Init app object
     m_config    = new Config(this);
     m_dataBase  = new DataBase(this);
+    m_restoreMode = false;
+    m_planMode    = false;
 
     //Wait until the app is ready to continue
     QObject::connect(this, SIGNAL(ready()), this, SLOT(runBackup()));
@@ -57,7 +59,10 @@ int AppChunkBackup::exec(void)
 
 void AppChunkBackup::running(void)
 {
-    emit this->runBackup();
+    if(m_restoreMode == true)
+        this->runRestore();
+    else
+        emit this->runBackup();
 }
 
 void AppChunkBackup::quitApp(void)
@@ -68,17 +73,97 @@ void AppChunkBackup::quitApp(void)
 
 void AppChunkBackup::runBackup(void)
 {
-    QStringList *dirList  = new QStringList();
-    QStringList *fileList = new QStringList();
+    QList<QStringList> dirLists;
+    QStringList dirList;
+    ProgressReporter *progressReporter = 0;
+
+    //Start the run clock of the metrics
+    Metrics::tick();
+
+    //In RECURSIVE mode the roots of a manifest share the packing (a cluster can hold the files of several roots)
+    m_dataBase->setSharedRoots((m_syncDataList.count() > 1) && (Config::getBackupMode() == BackupMode::RECURSIVE));
+
+    //Finish the work of a stopped run before scanning again
+    m_dataBase->resumeJournal();
+
+    //Scan the source directorys of each root
+    for(int i(0); i < m_syncDataList.count(); i++)
+    {
+        m_dataBase->setSyncData(&m_syncDataList[i]);
+
+        qInfo(QString("Building directorys list of "+ m_syncDataList[i].rootSrcPath +"...").toUtf8());
+        dirList.clear();
+        m_dataBase->getDirList(&dirList);
+        qInfo("Done (%d results)", dirList.count());
+
+        dirLists << dirList;
+    }
+
+    //The totals are needed for the remaining time of the run
+    if(Config::getProgressInterval() > 0)
+    {
+        for(int i(0); i < dirLists.count(); i++)
+            m_dataBase->planProgress(&dirLists[i]);
+    }
+
+    //The same thread logs the progress and writes the metrics files
+    if((Config::getProgressInterval() > 0) || (!Config::getMetricsPath().isEmpty()))
+    {
+        progressReporter = new ProgressReporter(Config::getProgressInterval());
+        progressReporter->start();
+    }
+
+    //The roots are synced one after the other in the same database session
+    for(int i(0); i < m_syncDataList.count(); i++)
+    {
+        m_dataBase->setSyncData(&m_syncDataList[i]);
+
+        //Only the last root build the last partial cluster
+        m_dataBase->setCarryTail((m_syncDataList.count() > 1) && (Config::getBackupMode() == BackupMode::RECURSIVE) && (i + 1 < m_syncDataList.count()));
+
+        this->backupRoot(&dirLists[i]);
+    }
+
+    //Release the chunk clusters which are no more used
+    m_dataBase->collectGarbage();
+
+    //Send the remaining deletes to SIA
+    m_dataBase->flushDeleteQueue();
+
+    //The clusters built while the uploads were paused are sent at the next window
+    m_dataBase->drainJournal();
+
+    //The deamon gets back its own upload settings
+    m_dataBase->restoreUploadRate();
+
+    //Prediction of a dry run
+    if(m_planMode == true)
+        m_dataBase->printPlan();
+
+    //Clusters to download for the restore of a directory (and invalidated by an edit in it)
+    m_dataBase->printLocality();
+
+    if(progressReporter != 0)
+    {
+        progressReporter->stop();
+        delete progressReporter;
+    }
+
+    //Totals of the run
+    Metrics::write();
+
+    this->quit();
+}
+
+void AppChunkBackup::backupRoot(QStringList *dirList)
+{
+    QFileInfoList *fileList = new QFileInfoList();
     QString currentDir, baseDir;
+    QMap<QString, QMap<QString, QFileInfoList> > dirPools;
+    const quint64 POOL_DIR_SIZE(Config::getPoolDirSize());
 
     baseDir = m_dataBase->getSyncData().rootSrcPath;
 
-    //Scan the source directorys
-    qInfo("Building directorys list...");
-    m_dataBase->getDirList(dirList);
-    qInfo("Done (%d results)", dirList->count());
-
     if(Config::getBackupMode() == BackupMode::SEPARTE_BY_DIR)
     {
         qInfo("All future actions take in account the \"SEPARTE_BY_DIR\" backup mode.");
@@ -90,7 +175,18 @@ void AppChunkBackup::runBackup(void)
             currentDir = dirList->takeFirst();
 
             //Scan files in the current directory
-            *fileList  = QDir(currentDir).entryList(QDir::Files | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System | QDir::CaseSensitive, QDir::Name);
+            m_dataBase->getFileList(currentDir, fileList);
+
+            //A small directory is synced later with its siblings (the base directory is pooled in itself), its file list is kept
+            if((POOL_DIR_SIZE > 0) && (m_dataBase->getDirSize(fileList) < POOL_DIR_SIZE))
+            {
+                if(currentDir == QFileInfo(baseDir).absoluteFilePath())
+                    dirPools[currentDir].insert(currentDir, *fileList);
+                else
+                    dirPools[QFileInfo(currentDir).path()].insert(currentDir, *fileList);
+
+                continue;
+            }
 
             //Build the temp table in database
             m_dataBase->buildTemporaryTable(currentDir, fileList);
@@ -99,7 +195,10 @@ void AppChunkBackup::runBackup(void)
             m_dataBase->syncDataBase(currentDir);
         }
 
-        delete dirList;
+        //The pooled directorys share clusters in their parent directory
+        foreach(QString poolDir, dirPools.keys())
+            m_dataBase->syncDirPool(poolDir, dirPools.value(poolDir));
+
         delete fileList;
     }
     else if(Config::getBackupMode() == BackupMode::RECURSIVE)
@@ -113,18 +212,23 @@ void AppChunkBackup::runBackup(void)
             currentDir = dirList->takeFirst();
 
             //Scan files in the current directory
-            *fileList  = QDir(currentDir).entryList(QDir::Files | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System | QDir::CaseSensitive, QDir::Name);
+            m_dataBase->getFileList(currentDir, fileList);
 
             //Build the temp table in database
             m_dataBase->buildTemporaryTable(currentDir, fileList);
         }
 
-        delete dirList;
         delete fileList;
 
         //Sync database
         m_dataBase->syncDataBase(baseDir);
     }
+}
+
+void AppChunkBackup::runRestore(void)
+{
+    if(m_dataBase->restoreFiles(m_restorePrefix, m_restoreDir) != true)
+        qCritical("The restore is not complete !");
 
     this->quit();
 }
@@ -140,8 +244,6 @@ bool AppChunkBackup::loadConfigFile(void)
 bool AppChunkBackup::loadAppArguments(void)
 {
     QStringList argList = this->arguments();
-    QFileInfo file;
-    t_SyncData syncData;
 
     //Delete the first argument (the executable name)
     argList.removeFirst();
@@ -154,9 +256,111 @@ bool AppChunkBackup::loadAppArguments(void)
         return false;
     }
 
+    //Restore mode : the prefix is the local path of the backed up files (it may not exist anymore)
+    if(argList.first() == ARG_RESTORE)
+    {
+        argList.removeFirst();
+
+        if(argList.count() < ARG_MIN_TO_FUNCTION)
+        {
+            qCritical("Not enough arguments !");
+            this->printUsage();
+            return false;
+        }
+
+        m_restoreMode   = true;
+        m_restorePrefix = QDir::fromNativeSeparators(argList.takeFirst());
+        m_restoreDir    = QFileInfo(argList.takeFirst()).absoluteFilePath();
+
+        if(m_restorePrefix.endsWith('/'))
+            m_restorePrefix.chop(1);
+
+        return true;
+    }
+
+    //Dry run : the same sync on a snapshot of the database, without archive, upload nor delete
+    if(argList.first() == ARG_PLAN)
+    {
+        argList.removeFirst();
+
+        if(argList.count() < ARG_MIN_TO_FUNCTION)
+        {
+            qCritical("Not enough arguments !");
+            this->printUsage();
+            return false;
+        }
+
+        m_planMode = true;
+        m_dataBase->setPlanMode(true);
+    }
+
+    //Several roots in one run
+    if(argList.first() == ARG_MANIFEST)
+    {
+        argList.removeFirst();
+
+        if(this->loadManifest(argList.takeFirst()) != true)
+            return false;
+    }
     //Get the arguments
-    syncData.rootSrcPath = argList.takeFirst();
-    syncData.rootDstPath = argList.takeFirst();
+    else if(this->addSyncData(argList.at(0), argList.at(1)) != true)
+        return false;
+
+    //Commit the first root (the others are set by the run)
+    m_dataBase->setSyncData(&m_syncDataList[0]);
+
+    return true;
+}
+
+bool AppChunkBackup::loadManifest(const QString manifestPath)
+{
+    QFile manifest(manifestPath);
+    QString line;
+    int lineNumber(0);
+
+    if(!manifest.open(QFile::ReadOnly | QFile::Text))
+    {
+        qCritical(QString("Cannot open the manifest "+ manifestPath +" !").toUtf8());
+        return false;
+    }
+
+    //One "<source_dir>|<target_dir>" per line, the empty lines and the lines starting with '#' are skipped
+    while(!manifest.atEnd())
+    {
+        line = QString::fromUtf8(manifest.readLine()).trimmed();
+        lineNumber++;
+
+        if(line.isEmpty() || line.startsWith('#'))
+            continue;
+
+        if(line.count(MANIFEST_SEPARATOR) != 1)
+        {
+            qCritical(QString("Bad manifest line "+ QString::number(lineNumber) +" : "+ line).toUtf8());
+            return false;
+        }
+
+        if(this->addSyncData(line.section(MANIFEST_SEPARATOR, 0, 0).trimmed(), line.section(MANIFEST_SEPARATOR, 1, 1).trimmed()) != true)
+            return false;
+    }
+
+    if(m_syncDataList.isEmpty())
+    {
+        qCritical("The manifest is empty !");
+        return false;
+    }
+
+    qInfo("%d source roots in the manifest", m_syncDataList.count());
+
+    return true;
+}
+
+bool AppChunkBackup::addSyncData(const QString srcPath, const QString dstPath)
+{
+    QFileInfo file;
+    t_SyncData syncData;
+
+    syncData.rootSrcPath = srcPath;
+    syncData.rootDstPath = dstPath;
 
     //### Check Arguments ###
     file.setFile(syncData.rootSrcPath);
@@ -164,7 +368,7 @@ bool AppChunkBackup::loadAppArguments(void)
     //If the source dos not exist or if source is not dir => close app
     if(!file.exists() || !file.isDir())
     {
-        qCritical("The source directory does not exist !");
+        qCritical(QString("The source directory "+ srcPath +" does not exist !").toUtf8());
         return false;
     }
 
@@ -180,8 +384,18 @@ bool AppChunkBackup::loadAppArguments(void)
     if(syncData.rootDstPath.endsWith('/') || syncData.rootDstPath.endsWith('\\'))
         syncData.rootDstPath.chop(1);
 
+    //A root inside another one would be backed up twice
+    foreach(t_SyncData other, m_syncDataList)
+    {
+        if((other.rootSrcPath == syncData.rootSrcPath) || syncData.rootSrcPath.startsWith(other.rootSrcPath +"/") || other.rootSrcPath.startsWith(syncData.rootSrcPath +"/"))
+        {
+            qCritical(QString("The source directorys "+ other.rootSrcPath +" and "+ syncData.rootSrcPath +" overlap !").toUtf8());
+            return false;
+        }
+    }
+
     //Commit the new data
-    m_dataBase->setSyncData(&syncData);
+    m_syncDataList << syncData;
 
     return true;
 }
@@ -209,6 +423,13 @@ void AppChunkBackup::printUsage(void)
     usage.append(this->applicationName() + " <source_dir> <target_dir>\n");
     usage.append("source_dir : Is the directory path to backup.\n");
     usage.append("target_dir : Is SIA target path to store the backup.\n");
+    usage.append(this->applicationName() + " --manifest <manifest_file>\n");
+    usage.append("manifest_file : Is a text file with one \"<source_dir>|<target_dir>\" per line, all the roots are backed up in one run.\n");
+    usage.append(this->applicationName() + " --plan <source_dir> <target_dir> | --plan --manifest <manifest_file>\n");
+    usage.append("--plan : Predicts the clusters, the bytes to upload, the padding and the deletes without building nor sending anything.\n");
+    usage.append(this->applicationName() + " --restore <path_prefix> <output_dir>\n");
+    usage.append("path_prefix : Is the local path (file or directory) of the backed up files to restore.\n");
+    usage.append("output_dir : Is the directory where the files are restored.\n");
 
     qInfo("Usage :");
     qInfo(usage.toUtf8());
@@ -4,13 +4,21 @@
 #include "apptypeutils.h"
 #include "config.h"
 #include "database.h"
+#include "progressreporter.h"
 #include <QCoreApplication>
 #include <QTimer>
 #include <QFileInfo>
+#include <QMap>
 
 #define QT_MESSAGE_PATTERN QString("%{time dd/MM/yyyy-h:mm:ss} [%{if-debug}DEBUG %{file}:%{line}%{endif}%{if-info}INFO%{endif}%{if-warning}WARNING%{endif}%{if-critical}CRITICAL%{endif}%{if-fatal}FATAL%{endif}] - %{message}")
 
 #define ARG_MIN_TO_FUNCTION 2
+#define ARG_RESTORE         QString("--restore")
+#define ARG_MANIFEST        QString("--manifest")
+#define ARG_PLAN            QString("--plan")
+
+//Separator of the source and target in a manifest line
+#define MANIFEST_SEPARATOR  QChar('|')
 
 #define APP_NAME            QString("SIA Chunk Backup")
 #define APP_VERSION         QString("V0.5 ALPHA")
@@ -33,13 +41,22 @@ private slots:
     void running(void);
     void quitApp(void);
     void runBackup(void);
+    void runRestore(void);
 private:
+    void backupRoot(QStringList *dirList);
     bool loadConfigFile(void);
     bool loadAppArguments(void);
+    bool loadManifest(const QString manifestPath);
+    bool addSyncData(const QString srcPath, const QString dstPath);
     bool loadDataBase(void);
 
     Config      *m_config;
     DataBase    *m_dataBase;
+    bool        m_restoreMode;
+    bool        m_planMode;
+    QString     m_restorePrefix;
+    QString     m_restoreDir;
+    QList<t_SyncData> m_syncDataList;
 };
 
 #endif // APPCHUNKBACKUP_H
@@ -9,15 +9,40 @@ ArchiveBuilder::ArchiveBuilder(QObject *parent) : QProcess(parent)
 
     m_mirrorDir = new QTemporaryDir(this->getTempDir() +"/mirror");
     m_mirrorDir->setAutoRemove(true);
+
+    m_chunkDir = new QTemporaryDir(this->getTempDir() +"/chunk");
+    m_chunkDir->setAutoRemove(true);
+
+    m_cryptoStream = new CryptoStream(this);
+}
+
+void ArchiveBuilder::setBaseDir(const QString baseDir)
+{
+    delete m_chunkDir;
+    delete m_mirrorDir;
+    delete m_tempDir;
+
+    QDir().mkpath(baseDir);
+
+    //The archives are built on the same disk than the journal (moved there without copy)
+    m_tempDir = new QTemporaryDir(baseDir +"/work-XXXXXX");
+    m_tempDir->setAutoRemove(true);
+
+    m_mirrorDir = new QTemporaryDir(this->getTempDir() +"/mirror");
+    m_mirrorDir->setAutoRemove(true);
+
+    m_chunkDir = new QTemporaryDir(this->getTempDir() +"/chunk");
+    m_chunkDir->setAutoRemove(true);
 }
 
 ArchiveBuilder::~ArchiveBuilder(void)
 {
+    delete m_chunkDir;
     delete m_mirrorDir;
     delete m_tempDir;
 }
 
-QFileInfo ArchiveBuilder::createTar(const QString tarName, const QStringList *srcFiles)
+QFileInfo ArchiveBuilder::createTar(const QString tarName, const QStringList *srcFiles, QList<t_memberOffset> *memberOffsets)
 {
     QString                 dstFile;
     QString                 tarEntryFile;
@@ -26,6 +51,14 @@ QFileInfo ArchiveBuilder::createTar(const QString tarName, const QStringList *sr
     struct archive_entry    *entry;
     int                     len;
     char                    *buff;
+    t_memberOffset          memberOffset;
+    qint64                  entryEnd(0);
+    quint64                 entrySize;
+    qint64                  plainSize;
+    bool                    written(true);
+    StageTimer              stageTimer(Stage::TAR);
+
+    m_failedFile.clear();
 
     dstFile     = QString(this->getTempDir()+"/"+tarName);
     buff        = new char[STREAM_BUFF_BYTE];
@@ -39,39 +72,146 @@ QFileInfo ArchiveBuilder::createTar(const QString tarName, const QStringList *sr
     foreach(QString srcFile, *srcFiles)
     {
         //Eleminate the redundant path
-        tarEntryFile = srcFile.section(this->workingDirectory(), 1);
-        tarEntryFile.remove(0, 1);
+        tarEntryFile = this->getEntryName(srcFile);
+
+        //An encrypted member has the nonce and the tag around the data
+        plainSize = QFileInfo(srcFile).size();
+        entrySize = plainSize;
+
+        if(m_encryptionKeys.contains(srcFile))
+            entrySize = CryptoStream::encryptedSize(entrySize);
 
         //Write the tar entry
         entry = archive_entry_new();
         archive_entry_set_pathname(entry, tarEntryFile.toUtf8().data());
-        archive_entry_set_size(entry, QFileInfo(srcFile).size());
+        archive_entry_set_size(entry, entrySize);
         archive_entry_set_filetype(entry, AE_IFREG);//Regular file
         archive_entry_set_perm(entry, 0644);
         archive_write_header(archiveTar, entry);
 
+        //The header start after the padding of the previous entry, the data start after the header
+        //(the bytes count of the first filter is the tar stream before the blocking of the output)
+        if(memberOffsets != 0)
+        {
+            memberOffset.headerOffset = ((entryEnd + TAR_HEADER_BYTE - 1) / TAR_HEADER_BYTE) * TAR_HEADER_BYTE;
+            memberOffset.dataOffset   = archive_filter_bytes(archiveTar, 0);
+            memberOffset.dataLength   = entrySize;
+            entryEnd                  = memberOffset.dataOffset + memberOffset.dataLength;
+
+            (*memberOffsets) << memberOffset;
+        }
+
         file.setFileName(srcFile);
-        file.open(QIODevice::ReadOnly);
 
-        //Copy the data in the tar archive
-        len = file.read(buff, STREAM_BUFF_BYTE);
-        while(len > 0)
+        //Copy the data in the tar archive (encrypted on the fly, in the same pass)
+        if(!file.open(QIODevice::ReadOnly))
+            written = false;
+        else if(m_encryptionKeys.contains(srcFile))
+            written = this->writeEncrypted(archiveTar, &file, m_encryptionKeys.value(srcFile), buff);
+        else
         {
-            archive_write_data(archiveTar, buff, len);
             len = file.read(buff, STREAM_BUFF_BYTE);
+            while(len > 0)
+            {
+                archive_write_data(archiveTar, buff, len);
+                len = file.read(buff, STREAM_BUFF_BYTE);
+            }
+
+            written = (len == 0);
         }
+
+        //A file changed since its size was read can't fill the declared member
+        written = written && (file.pos() == plainSize);
         file.close();
 
         archive_entry_free(entry);
+
+        //The header has already declared the size of the member, the archive can't be used
+        if(!written)
+        {
+            qCritical(QString("Cannot write "+ srcFile +" in the cluster").toUtf8());
+            m_failedFile = srcFile;
+            break;
+        }
     }
 
     archive_write_close(archiveTar);
     archive_write_free(archiveTar);
     delete[] buff;
 
+    if(!written)
+    {
+        QFile::remove(dstFile);
+        return QFileInfo();
+    }
+
+    Metrics::add(Stage::TAR, srcFiles->count(), QFileInfo(dstFile).size());
+
     return QFileInfo(dstFile);
 }
 
+bool ArchiveBuilder::writeEncrypted(struct archive *archiveTar, QFile *file, const QByteArray key, char *buff)
+{
+    QByteArray  out;
+    int         len;
+
+    if(!m_cryptoStream->beginEncrypt(this->getCipher(), key, &out))
+    {
+        qCritical(QString("Cannot encrypt "+ file->fileName()).toUtf8());
+        return false;
+    }
+
+    archive_write_data(archiveTar, out.constData(), out.size());
+
+    len = file->read(buff, STREAM_BUFF_BYTE);
+    while(len > 0)
+    {
+        if(!m_cryptoStream->update(buff, len, &out))
+            return false;
+
+        archive_write_data(archiveTar, out.constData(), out.size());
+        len = file->read(buff, STREAM_BUFF_BYTE);
+    }
+
+    //A read error would give a valid tag on a truncated member
+    if(len < 0)
+        return false;
+
+    if(!m_cryptoStream->finish(&out))
+        return false;
+
+    archive_write_data(archiveTar, out.constData(), out.size());
+
+    return true;
+}
+
+void ArchiveBuilder::setEncryptionKey(const QString srcFile, const QString hash)
+{
+    m_encryptionKeys.insert(srcFile, CryptoStream::deriveKey(hash));
+}
+
+void ArchiveBuilder::clearEncryptionKeys(void)
+{
+    m_encryptionKeys.clear();
+}
+
+QString ArchiveBuilder::getFailedFile(void)
+{
+    return m_failedFile;
+}
+
+QString ArchiveBuilder::getCipher(void)
+{
+    //Resolved at the first use (the config is not loaded when the object is built)
+    if(m_cipher.isEmpty())
+        m_cipher = Config::getEncryptionCipher();
+
+    if(m_cipher.isEmpty())
+        m_cipher = CryptoStream::hardwareCipher();
+
+    return m_cipher;
+}
+
 t_archiveInfo ArchiveBuilder::createTar(const QString tarName, const QStringList *srcFiles, const quint64 limit)
 {
     t_archiveInfo   archiveInfo;
@@ -89,9 +229,10 @@ t_archiveInfo ArchiveBuilder::createTar(const QString tarName, const QStringList
     //If you are only one file, all the algo can be reduce to :
     if(maxHeight == 1)
     {
-        archiveFileInfo         = this->createTar(tarName, srcFiles);
+        archiveFileInfo         = this->createTar(tarName, srcFiles, &archiveInfo.memberOffsets);
         archiveInfo.archiveFile = archiveFileInfo;
-        archiveInfo.entryCount  = srcFiles->count();
+        archiveInfo.entryCount  = archiveFileInfo.filePath().isEmpty() ? 0 : srcFiles->count();
+        archiveInfo.archiveSize = archiveFileInfo.size();
 
         return archiveInfo;
     }
@@ -116,10 +257,18 @@ t_archiveInfo ArchiveBuilder::createTar(const QString tarName, const QStringList
         filesList->clear();
         (*filesList)    << srcFiles->mid(0, currentHeight);
 
-        //Build the archive
-        archiveFileInfo = this->createTar(tarName, filesList);
+        //Build the archive (the offsets of the last build are the ones of the returned archive)
+        archiveInfo.memberOffsets.clear();
+        archiveFileInfo = this->createTar(tarName, filesList, &archiveInfo.memberOffsets);
         archiveSize     = archiveFileInfo.size();
 
+        //A member can't be written (getFailedFile), no cluster
+        if(archiveFileInfo.filePath().isEmpty())
+        {
+            filesList->clear();
+            break;
+        }
+
         //This condition blocs produce the counter-reaction (converge to the result, derivate sign opposite to the "dichotomy" above)
         if(archiveSize < limit)//If the curve increase
             minHeight = currentHeight;//Update the min files in the current "dichotomy" (closed loop)
@@ -145,14 +294,61 @@ t_archiveInfo ArchiveBuilder::createTar(const QString tarName, const QStringList
 
     archiveInfo.archiveFile = archiveFileInfo;
     archiveInfo.entryCount  = filesList->count();
+    archiveInfo.archiveSize = archiveFileInfo.size();
 
     delete filesList;
 
     return archiveInfo;
 }
 
+t_archiveInfo ArchiveBuilder::planTar(const QStringList *srcFiles, const QList<quint64> *srcSizes, const quint64 limit)
+{
+    t_archiveInfo   archiveInfo;
+    t_memberOffset  memberOffset;
+    quint64         entrySize, nameSize, archiveSize;
+    quint64         tarEnd(0);
+
+    archiveInfo.entryCount  = 0;
+    archiveInfo.archiveSize = 0;
+
+    //Same layout than the gnutar format of createTar, computed without reading or writing any file
+    for(int i(0); i < srcFiles->count(); i++)
+    {
+        entrySize = srcSizes->value(i);
+
+        if(m_encryptionKeys.contains((*srcFiles)[i]))
+            entrySize = CryptoStream::encryptedSize(entrySize);
+
+        memberOffset.headerOffset = tarEnd;
+
+        //A long name is written in its own entry before the member header
+        nameSize = this->getEntryName((*srcFiles)[i]).toUtf8().size();
+        if(nameSize > TAR_NAME_BYTE)
+            tarEnd += TAR_HEADER_BYTE + TAR_BLOCKS(nameSize + 1);
+
+        memberOffset.dataOffset = tarEnd + TAR_HEADER_BYTE;
+        memberOffset.dataLength = entrySize;
+
+        archiveSize = TAR_RECORDS(memberOffset.dataOffset + TAR_BLOCKS(entrySize) + TAR_END_BYTE);
+
+        //The biggest first files under the limit (one file at least), as createTar
+        if((archiveSize > limit) && (archiveInfo.entryCount > 0))
+            break;
+
+        tarEnd = memberOffset.dataOffset + TAR_BLOCKS(entrySize);
+
+        archiveInfo.memberOffsets << memberOffset;
+        archiveInfo.entryCount++;
+        archiveInfo.archiveSize = archiveSize;
+    }
+
+    return archiveInfo;
+}
+
 QFileInfo ArchiveBuilder::createZIP(QString srcFile)
 {
+    StageTimer stageTimer(Stage::ZIP);
+
     srcFile = QFileInfo(srcFile).absoluteFilePath();
 
     if(srcFile.isEmpty())
@@ -168,11 +364,8 @@ QFileInfo ArchiveBuilder::createZIP(QString srcFile)
     int                     len;
     char                    *buff;
 
-    //Build the shorter file path before create archive
-    fileName     = srcFile.section(this->workingDirectory(), 1);
-
-    if(fileName.startsWith("/") || fileName.startsWith("\\"))
-        fileName.remove(0, 1);
+    //Build the shorter file path before create archive (same as the tar entry name)
+    fileName     = this->getEntryName(srcFile);
 
     zipFileDir   = QFileInfo(m_mirrorDir->path() +"/"+ fileName).absolutePath();
     zipFilePath  = QFileInfo(m_mirrorDir->path() +"/"+ fileName).absoluteFilePath() +".zip";
@@ -213,17 +406,16 @@ QFileInfo ArchiveBuilder::createZIP(QString srcFile)
     archive_write_free(archiveZip);
     delete[] buff;
 
+    Metrics::add(Stage::ZIP, 1, QFileInfo(srcFile).size());
+
     return QFileInfo(zipFilePath);
 #else
     QString     zipFileDir;
     QString     zipFilePath;
     QString     fileName;
 
-    //Build the shorter file path before create archive
-    fileName     = srcFile.section(this->workingDirectory(), 1);
-
-    if(fileName.startsWith("/") || fileName.startsWith("\\"))
-        fileName.remove(0, 1);
+    //Build the shorter file path before create archive (same as the tar entry name)
+    fileName     = this->getEntryName(srcFile);
 
     zipFileDir   = QFileInfo(m_mirrorDir->path() +"/"+ fileName).absolutePath();
     zipFilePath  = QFileInfo(m_mirrorDir->path() +"/"+ fileName).absoluteFilePath();
@@ -238,10 +430,61 @@ QFileInfo ArchiveBuilder::createZIP(QString srcFile)
 
     zipFilePath += ".gz";
 
+    Metrics::add(Stage::ZIP, 1, QFileInfo(srcFile).size());
+
     return QFileInfo(zipFilePath);
 #endif
 }
 
+QFileInfo ArchiveBuilder::createStored(QString srcFile)
+{
+    QString storedFilePath;
+
+    srcFile = QFileInfo(srcFile).absoluteFilePath();
+
+    if(srcFile.isEmpty())
+        return QFileInfo();
+
+    //Same place than a zipped copy in the mirror (the tar reads the file through it)
+    storedFilePath = QFileInfo(m_mirrorDir->path() +"/"+ this->getEntryName(srcFile)).absoluteFilePath() + STORED_SUFFIX;
+
+    QDir(this->getMirrorDir()).mkpath(QFileInfo(storedFilePath).absolutePath());
+    QFile::remove(storedFilePath);
+
+#ifndef _WIN32
+    //A link avoid the copy of the data (the size and the content are the ones of the source)
+    if(!QFile::link(srcFile, storedFilePath))
+        QFile::copy(srcFile, storedFilePath);
+#else
+    //A shortcut is not a link for the tar
+    QFile::copy(srcFile, storedFilePath);
+#endif
+
+    return QFileInfo(storedFilePath);
+}
+
+QString ArchiveBuilder::getEntryName(const QString srcFile)
+{
+    QString entryName;
+
+    //Without working directory (clusters shared by several source roots) the entry name is the absolute path
+    if(this->workingDirectory().isEmpty())
+    {
+        entryName = QDir::fromNativeSeparators(srcFile).remove(':');
+
+        while(entryName.startsWith('/'))
+            entryName.remove(0, 1);
+
+        return entryName;
+    }
+
+    //The entry name is the path relative to the working directory
+    entryName = srcFile.section(this->workingDirectory(), 1);
+    entryName.remove(0, 1);
+
+    return entryName;
+}
+
 void ArchiveBuilder::cleanMirrorDir(void)
 {
     delete m_mirrorDir;
@@ -257,3 +500,8 @@ QString ArchiveBuilder::getMirrorDir(void)
 {
     return m_mirrorDir->path();
 }
+
+QString ArchiveBuilder::getChunkDir(void)
+{
+    return m_chunkDir->path();
+}
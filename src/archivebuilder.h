@@ -11,6 +11,8 @@
 #include <unistd.h>
 
 #include "config.h"
+#include "cryptostream.h"
+#include "metrics.h"
 #include <cmath>
 #include <QObject>
 #include <QProcess>
@@ -23,10 +25,35 @@
 
 #define STREAM_BUFF_BYTE 8192
 
+//Suffix of a file stored as-is in compression mode (its name can't be the one of the zip of another file)
+#define STORED_SUFFIX    QString(".raw")
+
+//Tar layout : a 512 bytes header per entry, 1024 bytes of end blocks and the archive padded to a 10240 bytes record
+#define TAR_HEADER_BYTE  512
+#define TAR_END_BYTE     1024
+#define TAR_RECORD_BYTE  10240
+#define TAR_NAME_BYTE    100//Longer names are written in a GNU long name entry before the member
+
+//Size rounded up to the tar blocks and to the tar records
+#define TAR_BLOCKS(SIZE)  (((((quint64)(SIZE)) + TAR_HEADER_BYTE - 1) / TAR_HEADER_BYTE) * TAR_HEADER_BYTE)
+#define TAR_RECORDS(SIZE) (((((quint64)(SIZE)) + TAR_RECORD_BYTE - 1) / TAR_RECORD_BYTE) * TAR_RECORD_BYTE)
+
+//Biggest part of a file that fill exactly a tar of a given size (one entry with a short name)
+#define TAR_PART_BYTE(SIZE) ((((quint64)(SIZE)) / TAR_RECORD_BYTE) * TAR_RECORD_BYTE - TAR_HEADER_BYTE - TAR_END_BYTE)
+
+struct t_memberOffset
+{
+    qint64  headerOffset;   //Position of the first header block of the member (long name blocks included)
+    qint64  dataOffset;     //Position of the member data
+    quint64 dataLength;     //Size of the member data (compressed size in compression mode)
+};
+
 struct t_archiveInfo
 {
-    QFileInfo archiveFile;
-    quint32   entryCount;
+    QFileInfo               archiveFile;
+    quint32                 entryCount;
+    quint64                 archiveSize;
+    QList<t_memberOffset>   memberOffsets;
 };
 
 class ArchiveBuilder : public QProcess
@@ -34,16 +61,32 @@ class ArchiveBuilder : public QProcess
 public:
     ArchiveBuilder(QObject *parent = 0);
     ~ArchiveBuilder(void);
-    QFileInfo createTar(const QString tarName, const QStringList *srcFiles);
+    void setBaseDir(const QString baseDir);
+    QFileInfo createTar(const QString tarName, const QStringList *srcFiles, QList<t_memberOffset> *memberOffsets = 0);
     t_archiveInfo createTar(const QString tarName, const QStringList *srcFiles, const quint64 limit);
+    t_archiveInfo planTar(const QStringList *srcFiles, const QList<quint64> *srcSizes, const quint64 limit);
     QFileInfo createZIP(QString srcFile);
+    QFileInfo createStored(QString srcFile);
+    QString getEntryName(const QString srcFile);
     void cleanMirrorDir(void);
     QString getTempDir(void);
     QString getMirrorDir(void);
+    QString getChunkDir(void);
+    void setEncryptionKey(const QString srcFile, const QString hash);
+    void clearEncryptionKeys(void);
+    QString getCipher(void);
+    QString getFailedFile(void);
 private:
+    bool writeEncrypted(struct archive *archiveTar, QFile *file, const QByteArray key, char *buff);
+
     QTemporaryDir   *m_tempDir;
     QTemporaryDir   *m_mirrorDir;
+    QTemporaryDir   *m_chunkDir;
     QString         m_gzipPath;
+    QString         m_cipher;
+    QString         m_failedFile;//Source of the member which stopped the last archive (unreadable or not encrypted)
+    CryptoStream    *m_cryptoStream;
+    QHash<QString, QByteArray> m_encryptionKeys;//Key : source file of the member
 };
 
 #endif // ARCHIVEBUILDER_H
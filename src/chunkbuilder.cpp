@@ -0,0 +1,143 @@
+#include "chunkbuilder.h"
+
+ChunkBuilder::ChunkBuilder(const quint32 avgSize, QObject *parent) : QObject(parent)
+{
+    quint64 state(CDC_GEAR_SEED);
+    quint64 z;
+    int     bits(0);
+
+    m_avgSize   = avgSize;
+    m_minSize   = avgSize / CDC_MIN_SIZE_DIVISOR;
+    m_maxSize   = avgSize * CDC_MAX_SIZE_FACTOR;
+    m_fixedSize = 0;
+    m_bufferPos = 0;
+    m_offset    = 0;
+
+    //Build the gear table with splitmix64 (deterministic)
+    for(int i(0); i < 256; i++)
+    {
+        z  = (state += Q_UINT64_C(0x9E3779B97F4A7C15));
+        z  = (z ^ (z >> 30)) * Q_UINT64_C(0xBF58476D1CE4E5B9);
+        z  = (z ^ (z >> 27)) * Q_UINT64_C(0x94D049BB133111EB);
+        m_gear[i] = z ^ (z >> 31);
+    }
+
+    while((1u << (bits + 1)) <= avgSize)
+        bits++;
+
+    //The gear hash is shifted to the left, so the top bits depend on the most bytes
+    //Before the average size the mask is harder to match (bits + 1), after it is easier (bits - 1)
+    m_maskS = ~Q_UINT64_C(0) << (64 - (bits + 1));
+    m_maskL = ~Q_UINT64_C(0) << (64 - qMax(bits - 1, 1));
+}
+
+void ChunkBuilder::setFixedSize(const quint32 size)
+{
+    this->close();
+
+    m_fixedSize = size;
+    m_minSize   = size;
+    m_avgSize   = size;
+    m_maxSize   = size;
+}
+
+quint32 ChunkBuilder::getAvgSize(void) const
+{
+    return m_avgSize;
+}
+
+bool ChunkBuilder::open(const QString srcFile)
+{
+    this->close();
+
+    m_file.setFileName(srcFile);
+
+    if(!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    return true;
+}
+
+void ChunkBuilder::close(void)
+{
+    if(m_file.isOpen())
+        m_file.close();
+
+    m_buffer.clear();
+    m_bufferPos = 0;
+    m_offset    = 0;
+}
+
+void ChunkBuilder::fillBuffer(void)
+{
+    //Keep at least one max chunk in the buffer (if the file is long enough)
+    if((quint32)(m_buffer.size() - m_bufferPos) >= m_maxSize)
+        return;
+
+    m_buffer.remove(0, m_bufferPos);
+    m_bufferPos = 0;
+
+    m_buffer.append(m_file.read(2 * m_maxSize - m_buffer.size()));
+}
+
+bool ChunkBuilder::next(QByteArray *chunk, t_chunkInfo *info)
+{
+    quint32 len;
+
+    this->fillBuffer();
+
+    len = m_buffer.size() - m_bufferPos;
+
+    if(len == 0)
+        return false;
+
+    len = this->cutPoint((const uchar*)m_buffer.constData() + m_bufferPos, len);
+
+    *chunk       = m_buffer.mid(m_bufferPos, len);
+    info->hash   = QCryptographicHash::hash(*chunk, QCryptographicHash::Sha1);
+    info->offset = m_offset;
+    info->size   = len;
+
+    m_bufferPos += len;
+    m_offset    += len;
+
+    return true;
+}
+
+quint32 ChunkBuilder::cutPoint(const uchar *data, const quint32 len) const
+{
+    quint64 fp(0);
+    quint32 i(m_minSize);
+    quint32 n(len);
+    quint32 normal(m_avgSize);
+
+    if(m_fixedSize > 0)
+        return qMin(n, m_fixedSize);
+
+    if(n <= m_minSize)
+        return n;
+
+    if(n > m_maxSize)
+        n = m_maxSize;
+
+    if(n < normal)
+        normal = n;
+
+    //Skip the min size and look for a boundary with the hard mask
+    for(; i < normal; i++)
+    {
+        fp = (fp << 1) + m_gear[data[i]];
+        if(!(fp & m_maskS))
+            return i;
+    }
+
+    //After the average size, look for a boundary with the easy mask
+    for(; i < n; i++)
+    {
+        fp = (fp << 1) + m_gear[data[i]];
+        if(!(fp & m_maskL))
+            return i;
+    }
+
+    return n;
+}
@@ -0,0 +1,55 @@
+#ifndef CHUNKBUILDER_H
+#define CHUNKBUILDER_H
+
+#include <QObject>
+#include <QFile>
+#include <QByteArray>
+#include <QCryptographicHash>
+
+//FastCDC bounds around the average chunk size
+#define CDC_MIN_SIZE_DIVISOR    4
+#define CDC_MAX_SIZE_FACTOR     4
+
+//Max size of a fixed chunk, the buffer holds two chunks in a QByteArray (less than 2 GiB)
+#define CDC_MAX_FIXED_SIZE      Q_UINT64_C(0x20000000)
+
+//Seed of the gear table, it must never change (the chunk boundaries of the stored files depend on it)
+#define CDC_GEAR_SEED           Q_UINT64_C(0x5349414348554E4B)
+
+struct t_chunkInfo
+{
+    QByteArray  hash;
+    quint64     offset;
+    quint64     size;
+};
+
+//Content defined chunking (FastCDC with normalized chunking) of one file
+//An edit in the file only change the chunks around the edit, the others keep the same boundaries and hash
+//With a fixed size the file is only cut in parts of this size (the last one is smaller)
+class ChunkBuilder : public QObject
+{
+public:
+    ChunkBuilder(const quint32 avgSize, QObject *parent = 0);
+    void setFixedSize(const quint32 size);
+    quint32 getAvgSize(void) const;
+    bool open(const QString srcFile);
+    bool next(QByteArray *chunk, t_chunkInfo *info);
+    void close(void);
+private:
+    void fillBuffer(void);
+    quint32 cutPoint(const uchar *data, const quint32 len) const;
+
+    QFile       m_file;
+    QByteArray  m_buffer;
+    quint32     m_bufferPos;
+    quint64     m_offset;
+    quint32     m_minSize;
+    quint32     m_avgSize;
+    quint32     m_maxSize;
+    quint32     m_fixedSize;
+    quint64     m_maskS;
+    quint64     m_maskL;
+    quint64     m_gear[256];
+};
+
+#endif // CHUNKBUILDER_H
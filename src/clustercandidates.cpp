@@ -0,0 +1,213 @@
+#include "clustercandidates.h"
+
+ClusterCandidates::ClusterCandidates(void)
+{
+    m_count     = 0;
+    m_arenaUsed = 0;
+}
+
+void ClusterCandidates::reserve(const int count, const int arenaBytes)
+{
+    if(m_entries.size() < count)
+        m_entries.resize(count);
+
+    if(m_arena.size() < arenaBytes)
+        m_arena.resize(arenaBytes);
+}
+
+void ClusterCandidates::clear(void)
+{
+    //The memory is kept for the next cluster
+    m_count     = 0;
+    m_arenaUsed = 0;
+}
+
+int ClusterCandidates::count(void) const
+{
+    return m_count;
+}
+
+bool ClusterCandidates::isEmpty(void) const
+{
+    return (m_count == 0);
+}
+
+void ClusterCandidates::append(const QString &source, const QString &member, const QString &hashHex, const quint64 size)
+{
+    t_candidate *entry(this->next(hashHex, size));
+
+    entry->sourceOffset = this->store(source.constData(), source.length(), &entry->sourceLength);
+    entry->memberOffset = this->store(member.constData(), member.length(), &entry->memberLength);
+}
+
+void ClusterCandidates::append(const QString &source, const int memberStart, const QString &hashHex, const quint64 size)
+{
+    t_candidate *entry(this->next(hashHex, size));
+
+    //The member is the end of the source (path relative to the working directory), no substring is built
+    entry->sourceOffset = this->store(source.constData(), source.length(), &entry->sourceLength);
+    entry->memberOffset = this->store(source.constData() + memberStart, source.length() - memberStart, &entry->memberLength);
+}
+
+t_candidate *ClusterCandidates::next(const QString &hashHex, const quint64 size)
+{
+    t_candidate *entry;
+    uchar       *hash;
+    ushort      unit;
+    int         nibble;
+
+    //Grow by doubling (amortized, the list is reused between clusters)
+    if(m_count >= m_entries.size())
+        m_entries.resize(qMax(2 * m_entries.size(), 1024));
+
+    entry = &m_entries[m_count++];
+
+    entry->size         = size;
+    entry->headerOffset = 0;
+    entry->dataOffset   = 0;
+    entry->dataLength   = 0;
+    entry->stored       = false;
+    entry->hashBytes    = qMin(hashHex.length() / 2, CANDIDATE_HASH_BYTE);
+
+    memset(entry->hash, 0, CANDIDATE_HASH_BYTE);
+
+    //The hex is decoded in place (no temporary QByteArray per file), an invalid digit ends the hash
+    hash = (uchar*)entry->hash;
+
+    for(int i(0); i < 2 * (int)entry->hashBytes; i++)
+    {
+        unit = hashHex.at(i).unicode();
+
+        if((unit >= '0') && (unit <= '9'))
+            nibble = unit - '0';
+        else if((unit >= 'a') && (unit <= 'f'))
+            nibble = unit - 'a' + 10;
+        else if((unit >= 'A') && (unit <= 'F'))
+            nibble = unit - 'A' + 10;
+        else
+        {
+            entry->hashBytes = i / 2;
+            break;
+        }
+
+        hash[i / 2] |= (i % 2) ? nibble : (nibble << 4);
+    }
+
+    return entry;
+}
+
+void ClusterCandidates::removeLast(void)
+{
+    if(m_count == 0)
+        return;
+
+    //The paths of the last entry are at the end of the arena
+    m_count--;
+    m_arenaUsed = m_entries[m_count].sourceOffset;
+}
+
+const t_candidate &ClusterCandidates::at(const int i) const
+{
+    return m_entries[i];
+}
+
+QString ClusterCandidates::source(const int i) const
+{
+    return QString::fromUtf8(m_arena.constData() + m_entries[i].sourceOffset, m_entries[i].sourceLength);
+}
+
+QString ClusterCandidates::member(const int i) const
+{
+    return QString::fromUtf8(m_arena.constData() + m_entries[i].memberOffset, m_entries[i].memberLength);
+}
+
+QString ClusterCandidates::hash(const int i) const
+{
+    return QString(QByteArray((const char*)m_entries[i].hash, m_entries[i].hashBytes).toHex());
+}
+
+quint64 ClusterCandidates::size(const int i) const
+{
+    return m_entries[i].size;
+}
+
+quint64 ClusterCandidates::totalSize(void) const
+{
+    quint64 total(0);
+
+    for(int i(0); i < m_count; i++)
+        total += m_entries[i].size;
+
+    return total;
+}
+
+void ClusterCandidates::setOffsets(const int i, const t_memberOffset offsets)
+{
+    m_entries[i].headerOffset = offsets.headerOffset;
+    m_entries[i].dataOffset   = offsets.dataOffset;
+    m_entries[i].dataLength   = offsets.dataLength;
+}
+
+void ClusterCandidates::setStored(const int i, const bool stored)
+{
+    m_entries[i].stored = stored;
+}
+
+QStringList ClusterCandidates::archivePaths(const QString mirrorDir) const
+{
+    QStringList paths;
+
+    paths.reserve(m_count);
+
+    //In compression mode the archived file is the zipped copy in the mirror directory
+    for(int i(0); i < m_count; i++)
+        paths << (mirrorDir.isEmpty() ? this->source(i) : (mirrorDir +"/"+ this->member(i)));
+
+    return paths;
+}
+
+quint32 ClusterCandidates::store(const QChar *str, const int count, quint32 *length)
+{
+    quint32 offset(m_arenaUsed);
+    int     maxBytes(count * 3);//Worst case of UTF-8 for the UTF-16 units
+    int     written(0);
+    ushort  unit;
+
+    if(m_arenaUsed + maxBytes > m_arena.size())
+        m_arena.resize(qMax(2 * m_arena.size(), m_arenaUsed + maxBytes + 65536));
+
+    //Encoded in place (no temporary QByteArray per path)
+    for(int i(0); i < count; i++)
+    {
+        unit = str[i].unicode();
+
+        if(unit < 0x80)
+            m_arena.data()[offset + written++] = (char)unit;
+        else if(unit < 0x800)
+        {
+            m_arena.data()[offset + written++] = (char)(0xC0 | (unit >> 6));
+            m_arena.data()[offset + written++] = (char)(0x80 | (unit & 0x3F));
+        }
+        else if(str[i].isHighSurrogate() && (i + 1 < count) && str[i + 1].isLowSurrogate())
+        {
+            //Surrogate pair => 4 bytes (the 6 bytes of the two units are reserved)
+            uint codePoint = 0x10000 + ((unit - 0xD800) << 10) + (str[++i].unicode() - 0xDC00);
+
+            m_arena.data()[offset + written++] = (char)(0xF0 | (codePoint >> 18));
+            m_arena.data()[offset + written++] = (char)(0x80 | ((codePoint >> 12) & 0x3F));
+            m_arena.data()[offset + written++] = (char)(0x80 | ((codePoint >> 6) & 0x3F));
+            m_arena.data()[offset + written++] = (char)(0x80 | (codePoint & 0x3F));
+        }
+        else
+        {
+            m_arena.data()[offset + written++] = (char)(0xE0 | (unit >> 12));
+            m_arena.data()[offset + written++] = (char)(0x80 | ((unit >> 6) & 0x3F));
+            m_arena.data()[offset + written++] = (char)(0x80 | (unit & 0x3F));
+        }
+    }
+
+    m_arenaUsed += written;
+    *length      = written;
+
+    return offset;
+}
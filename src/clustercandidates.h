@@ -0,0 +1,63 @@
+#ifndef CLUSTERCANDIDATES_H
+#define CLUSTERCANDIDATES_H
+
+#include "archivebuilder.h"
+#include <QVector>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <string.h>
+
+//SHA1 in 32 bits words
+#define CANDIDATE_HASH_BYTE  20
+#define CANDIDATE_HASH_WORDS (CANDIDATE_HASH_BYTE / 4)
+
+//One file of the next cluster, the paths are in the arena of the list (UTF-8)
+struct t_candidate
+{
+    quint32 sourceOffset;
+    quint32 sourceLength;
+    quint32 memberOffset;
+    quint32 memberLength;
+    quint32 hash[CANDIDATE_HASH_WORDS];
+    quint32 hashBytes;      //0 if the file couldn't be hashed
+    quint64 size;
+    qint64  headerOffset;
+    qint64  dataOffset;
+    quint64 dataLength;
+    bool    stored;         //Compression mode : the file is archived as-is (already compressed content)
+};
+
+//Files of the next cluster in two contiguous blocks (the entries and their paths)
+//The list is cleared and filled again for each cluster : once the capacity is reached nothing is allocated per file
+class ClusterCandidates
+{
+public:
+    ClusterCandidates(void);
+    void reserve(const int count, const int arenaBytes);
+    void clear(void);
+    int count(void) const;
+    bool isEmpty(void) const;
+    void append(const QString &source, const QString &member, const QString &hashHex, const quint64 size);
+    void append(const QString &source, const int memberStart, const QString &hashHex, const quint64 size);
+    void removeLast(void);
+    const t_candidate &at(const int i) const;
+    QString source(const int i) const;
+    QString member(const int i) const;
+    QString hash(const int i) const;
+    quint64 size(const int i) const;
+    quint64 totalSize(void) const;
+    void setOffsets(const int i, const t_memberOffset offsets);
+    void setStored(const int i, const bool stored);
+    QStringList archivePaths(const QString mirrorDir) const;
+private:
+    t_candidate *next(const QString &hashHex, const quint64 size);
+    quint32 store(const QChar *str, const int count, quint32 *length);
+
+    QVector<t_candidate>    m_entries;
+    QByteArray              m_arena;
+    int                     m_count;
+    int                     m_arenaUsed;
+};
+
+#endif // CLUSTERCANDIDATES_H
@@ -0,0 +1,93 @@
+#include "compressionpolicy.h"
+
+//Images, audio, video, archives and compressed documents (their content is already compressed)
+static const t_magic MAGIC_LIST[] =
+{
+    {0, "\xFF\xD8\xFF",                 3}, //JPEG
+    {0, "\x89PNG",                      4}, //PNG
+    {0, "GIF8",                         4}, //GIF
+    {8, "WEBP",                         4}, //WEBP (RIFF container)
+    {4, "ftyp",                         4}, //MP4, MOV, HEIC
+    {0, "\x1A\x45\xDF\xA3",             4}, //MKV, WEBM
+    {0, "OggS",                         4}, //OGG, OPUS
+    {0, "fLaC",                         4}, //FLAC
+    {0, "ID3",                          3}, //MP3
+    {0, "PK\x03\x04",                   4}, //ZIP, JAR, DOCX, ODT...
+    {0, "\x1F\x8B",                     2}, //GZIP
+    {0, "BZh",                          3}, //BZIP2
+    {0, "\xFD" "7zXZ",                  5}, //XZ
+    {0, "7z\xBC\xAF\x27\x1C",           6}, //7Z
+    {0, "Rar!",                         4}, //RAR
+    {0, "\x28\xB5\x2F\xFD",             4}, //ZSTD
+    {0, "\x04\x22\x4D\x18",             4}  //LZ4
+};
+
+CompressionPolicy::CompressionPolicy(QObject *parent) : QObject(parent)
+{
+}
+
+QString CompressionPolicy::decide(const QString srcFile)
+{
+    QFile       file(srcFile);
+    QByteArray  head;
+
+    if(Config::getCompressionProbe() == false)
+        return COMPRESSION_DEFLATE;
+
+    //The cheapest check, without reading the file
+    if(Config::getStoreExtensions().contains(QFileInfo(srcFile).suffix().toLower()))
+        return COMPRESSION_STORE;
+
+    if(!file.open(QIODevice::ReadOnly))
+        return COMPRESSION_DEFLATE;
+
+    head = file.read(PROBE_BLOCK_BYTE * PROBE_BLOCKS);
+    file.close();
+
+    if(CompressionPolicy::isCompressedFormat(head))
+        return COMPRESSION_STORE;
+
+    //Encrypted or already compressed data looks random (about 8 bits per byte)
+    if((head.size() >= PROBE_MIN_BYTE) && (CompressionPolicy::entropy(head) >= Config::getEntropyThreshold()))
+        return COMPRESSION_STORE;
+
+    return COMPRESSION_DEFLATE;
+}
+
+bool CompressionPolicy::isCompressedFormat(const QByteArray head)
+{
+    for(unsigned int i(0); i < sizeof(MAGIC_LIST) / sizeof(t_magic); i++)
+    {
+        if(head.mid(MAGIC_LIST[i].offset, MAGIC_LIST[i].length) == QByteArray(MAGIC_LIST[i].bytes, MAGIC_LIST[i].length))
+            return true;
+    }
+
+    return false;
+}
+
+double CompressionPolicy::entropy(const QByteArray data)
+{
+    quint32         count[256];
+    const uchar     *bytes((const uchar*)data.constData());
+    double          result(0.0), p;
+
+    if(data.isEmpty())
+        return 0.0;
+
+    memset(count, 0, sizeof(count));
+
+    for(int i(0); i < data.size(); i++)
+        count[bytes[i]]++;
+
+    //Shannon entropy in bits per byte (0 to 8)
+    for(int i(0); i < 256; i++)
+    {
+        if(count[i] == 0)
+            continue;
+
+        p       = (double)count[i] / (double)data.size();
+        result -= p * std::log2(p);
+    }
+
+    return result;
+}
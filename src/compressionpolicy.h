@@ -0,0 +1,43 @@
+#ifndef COMPRESSIONPOLICY_H
+#define COMPRESSIONPOLICY_H
+
+#include "config.h"
+#include <QObject>
+#include <QFile>
+#include <QFileInfo>
+#include <QByteArray>
+#include <QString>
+#include <cmath>
+#include <string.h>
+
+//Decision recorded in the index (an older index has none, the member name tells if it is compressed)
+#define COMPRESSION_STORE       QString("store")
+#define COMPRESSION_DEFLATE     QString("deflate")
+#define COMPRESSION_NONE        QString("none")//Compression mode off : the member is the file itself
+
+//The entropy probe reads the first blocks of the file
+#define PROBE_BLOCK_BYTE        16384
+#define PROBE_BLOCKS            4
+//Below this size the entropy is not significant (the file is compressed)
+#define PROBE_MIN_BYTE          512
+
+//Signature of a compressed format at the start of a file
+struct t_magic
+{
+    int         offset;
+    const char  *bytes;
+    int         length;
+};
+
+//Tells if a file is worth compressing (compression mode)
+//The extension is checked first, then the signature and the entropy of the first blocks
+class CompressionPolicy : public QObject
+{
+public:
+    CompressionPolicy(QObject *parent = 0);
+    QString decide(const QString srcFile);
+    static bool isCompressedFormat(const QByteArray head);
+    static double entropy(const QByteArray data);
+};
+
+#endif // COMPRESSIONPOLICY_H
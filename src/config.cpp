@@ -1,4 +1,8 @@
 #include "config.h"
+#include "cryptostream.h"
+#include "archivebuilder.h"
+#include "chunkbuilder.h"
+#include "uploadscheduler.h"
 
 t_GeneralConfig Config::m_configData;
 t_SiaConfig     Config::m_siaConfig;
@@ -19,23 +23,66 @@ void Config::createDefault(void)
 }
 
 bool Config::load(void)
+{
+    return this->load(CONFIG_FILE_PATH);
+}
+
+bool Config::load(const QString configPath)
 {
     QString backupMode;
-    QSettings settings(CONFIG_FILE_PATH, QSettings::IniFormat);
+    QString packingPolicy;
+    QString encryptionCipher;
+    QList<t_uploadWindow> uploadWindows;
+    QSettings settings(configPath, QSettings::IniFormat);
 
     backupMode                          = settings.value(KEY_BACKUP_MODE, BM_SEPARTE_BY_DIR).toString();
     Config::m_configData.clusterSize    = settings.value(KEY_CLUSTER_SIZE, 40000000).toULongLong();
+    Config::m_configData.poolDirSize    = settings.value(KEY_POOL_DIR_SIZE, 0).toULongLong();
+    packingPolicy                       = settings.value(KEY_PACKING_POLICY, PP_SIZE).toString();
+    Config::m_configData.hotChanges     = settings.value(KEY_HOT_CHANGES, 0).toInt();
+    Config::m_configData.hotDays        = settings.value(KEY_HOT_DAYS, 30).toInt();
     Config::m_configData.dbDirPath      = settings.value(KEY_DATA_BASE_PATH, QString("./")).toString();
     Config::m_configData.dbName         = settings.value(KEY_DATA_BASE_NAME, QString("sia_backup.db")).toString();
+    Config::m_configData.journalDirPath = settings.value(KEY_JOURNAL_PATH, QString("./journal")).toString();
+    Config::m_configData.metricsDirPath = settings.value(KEY_METRICS_PATH, QString()).toString();
+    Config::m_configData.metricsInterval= settings.value(KEY_METRICS_INTERVAL, 60).toInt();
+    Config::m_configData.progressInterval = settings.value(KEY_PROGRESS_INTERVAL, 30).toInt();
     Config::m_configData.useCompression = settings.value(KEY_USE_COMPRESSION, false).toBool();
+    Config::m_configData.compressionProbe = settings.value(KEY_COMPRESSION_PROBE, true).toBool();
+    Config::m_configData.storeExtensions = settings.value(KEY_STORE_EXTENSIONS, QString(DEFAULT_STORE_EXTENSIONS).split(',')).toStringList();
+    Config::m_configData.entropyThreshold = settings.value(KEY_ENTROPY_THRESHOLD, 7.5).toDouble();
+    Config::m_configData.solidCompression = settings.value(KEY_SOLID_COMPRESSION, false).toBool();
+    Config::m_configData.zstdLevel      = settings.value(KEY_ZSTD_LEVEL, 3).toInt();
+    Config::m_configData.zstdWorkers    = settings.value(KEY_ZSTD_WORKERS, 0).toInt();
     Config::m_configData.useEncryption  = settings.value(KEY_USE_ENCRYPTION, false).toBool();
+    encryptionCipher                    = settings.value(KEY_ENC_CIPHER, EC_AUTO).toString();
     Config::m_configData.avoidFrag      = settings.value(KEY_AVOID_FRAG, true).toBool();
+    Config::m_configData.defragBudget   = settings.value(KEY_DEFRAG_BUDGET, 400000000).toULongLong();
+    Config::m_configData.defragUploadCost = settings.value(KEY_DEFRAG_COST, 1.0).toDouble();
+    Config::m_configData.compactionRatio= settings.value(KEY_COMPACT_RATIO, 0.5).toDouble();
+    Config::m_configData.splitBigFiles  = settings.value(KEY_SPLIT_BIG_FILES, false).toBool();
+    Config::m_configData.cdcThreshold   = settings.value(KEY_CDC_THRESHOLD, 0).toULongLong();
+    Config::m_configData.cdcChunkSize   = settings.value(KEY_CDC_CHUNK_SIZE, 1048576).toUInt();
 
     Config::m_configData.dbDirPath      = QFileInfo(Config::m_configData.dbDirPath).absoluteFilePath();
     Config::m_configData.tempDirPath    = QFileInfo(Config::m_configData.tempDirPath).absoluteFilePath();
+    Config::m_configData.journalDirPath = QFileInfo(Config::m_configData.journalDirPath).absoluteFilePath();
+
+    //Empty => no metrics files
+    if(!Config::m_configData.metricsDirPath.isEmpty())
+        Config::m_configData.metricsDirPath = QFileInfo(Config::m_configData.metricsDirPath).absoluteFilePath();
 
     Config::m_siaConfig.ipAddress       = settings.value(KEY_IP_ADDRESS, QString("localhost")).toString();
     Config::m_siaConfig.port            = settings.value(KEY_PORT, QString("9980")).toString();
+    Config::m_siaConfig.deleteParallel  = settings.value(KEY_DELETE_PARALLEL, 8).toInt();
+    Config::m_siaConfig.uploadParallel  = settings.value(KEY_UPLOAD_PARALLEL, 4).toInt();
+    Config::m_siaConfig.downloadParallel= settings.value(KEY_DOWNLOAD_PARALLEL, 4).toInt();
+    Config::m_siaConfig.requestParallel = settings.value(KEY_REQUEST_PARALLEL, 8).toInt();
+    Config::m_siaConfig.requestTimeout  = settings.value(KEY_REQUEST_TIMEOUT, 60).toInt();
+    Config::m_siaConfig.requestRetries  = settings.value(KEY_REQUEST_RETRIES, 3).toInt();
+    Config::m_siaConfig.retryBackoff    = settings.value(KEY_RETRY_BACKOFF, 500).toInt();
+    Config::m_siaConfig.uploadSchedule  = settings.value(KEY_UPLOAD_SCHEDULE, QStringList()).toStringList();
+    Config::m_siaConfig.uploadBacklog   = settings.value(KEY_UPLOAD_BACKLOG, 4000000000ULL).toULongLong();
 
     if(backupMode == BM_SEPARTE_BY_DIR)
         Config::m_configData.backupMode = BackupMode::SEPARTE_BY_DIR;
@@ -44,6 +91,23 @@ bool Config::load(void)
     else
         return false;
 
+    if(packingPolicy == PP_SIZE)
+        Config::m_configData.packingPolicy = PackingPolicy::SIZE;
+    else if(packingPolicy == PP_LOCALITY)
+        Config::m_configData.packingPolicy = PackingPolicy::LOCALITY;
+    else
+        return false;
+
+    //Empty => the fastest cipher on this CPU
+    if(encryptionCipher == EC_AUTO)
+        Config::m_configData.encryptionCipher = QString();
+    else if(encryptionCipher == EC_AES_256_GCM)
+        Config::m_configData.encryptionCipher = CIPHER_AES_256_GCM;
+    else if(encryptionCipher == EC_CHACHA20_POLY1305)
+        Config::m_configData.encryptionCipher = CIPHER_CHACHA20_POLY1305;
+    else
+        return false;
+
     if(Config::m_configData.dbDirPath.isEmpty())
         return false;
 
@@ -53,12 +117,93 @@ bool Config::load(void)
     if(Config::m_configData.tempDirPath.isEmpty())
         return false;
 
+    if(Config::m_configData.journalDirPath.isEmpty())
+        return false;
+
+    if(Config::m_configData.metricsInterval < 1)
+        return false;
+
+    if(Config::m_configData.progressInterval < 0)
+        return false;
+
+    if(Config::m_configData.cdcChunkSize < 64)
+        return false;
+
+    //A part must hold at least one record of data, and it is read in memory by the chunk builder
+    if(Config::m_configData.splitBigFiles && ((Config::m_configData.clusterSize < 2 * TAR_RECORD_BYTE) || (TAR_PART_BYTE(Config::m_configData.clusterSize) > CDC_MAX_FIXED_SIZE)))
+        return false;
+
+    if(Config::m_configData.defragUploadCost < 0.0)
+        return false;
+
+    //Bits per byte
+    if((Config::m_configData.entropyThreshold < 0.0) || (Config::m_configData.entropyThreshold > 8.0))
+        return false;
+
+    if((Config::m_configData.zstdLevel < 1) || (Config::m_configData.zstdLevel > 19))
+        return false;
+
+    //0 => one worker per core
+    if(Config::m_configData.zstdWorkers < 0)
+        return false;
+
+    if(Config::m_configData.zstdWorkers == 0)
+        Config::m_configData.zstdWorkers = QThread::idealThreadCount();
+
+    //The encrypted files can't be compressed, the solid mode would only cost time
+    if(Config::m_configData.solidCompression && Config::m_configData.useEncryption)
+        return false;
+
+    //The whole cluster is compressed, the files are written as-is in the tar
+    if(Config::m_configData.solidCompression)
+        Config::m_configData.useCompression = false;
+
+    //The extensions are compared without the dot and in lower case
+    for(int i(0); i < Config::m_configData.storeExtensions.count(); i++)
+        Config::m_configData.storeExtensions[i] = Config::m_configData.storeExtensions[i].trimmed().remove('.').toLower();
+
+    //0 => no hot clusters
+    if(Config::m_configData.hotChanges < 0)
+        return false;
+
+    if(Config::m_configData.hotDays < 1)
+        return false;
+
+    if((Config::m_configData.compactionRatio < 0.0) || (Config::m_configData.compactionRatio > 1.0))
+        return false;
+
     if(Config::m_siaConfig.ipAddress.isEmpty())
         return false;
 
     if(Config::m_siaConfig.port.isEmpty())
         return false;
 
+    if(Config::m_siaConfig.deleteParallel < 1)
+        return false;
+
+    if(Config::m_siaConfig.uploadParallel < 1)
+        return false;
+
+    if(Config::m_siaConfig.downloadParallel < 1)
+        return false;
+
+    if(Config::m_siaConfig.requestParallel < 1)
+        return false;
+
+    //0 => no timeout
+    if(Config::m_siaConfig.requestTimeout < 0)
+        return false;
+
+    if(Config::m_siaConfig.requestRetries < 0)
+        return false;
+
+    if((Config::m_siaConfig.retryBackoff < 1) || (Config::m_siaConfig.retryBackoff > 60000))
+        return false;
+
+    //Each window must be "HH:MM-HH:MM=rate" and the upload must be allowed at least one minute of the day
+    if(!UploadScheduler::parse(Config::m_siaConfig.uploadSchedule, &uploadWindows))
+        return false;
+
     return true;
 }
 
@@ -77,26 +222,131 @@ QString Config::getDatabasePath(void)
     return Config::m_configData.dbDirPath;
 }
 
+QString Config::getJournalPath(void)
+{
+    return Config::m_configData.journalDirPath;
+}
+
+QString Config::getMetricsPath(void)
+{
+    return Config::m_configData.metricsDirPath;
+}
+
+int Config::getMetricsInterval(void)
+{
+    return Config::m_configData.metricsInterval;
+}
+
+int Config::getProgressInterval(void)
+{
+    return Config::m_configData.progressInterval;
+}
+
 quint64 Config::getClusterSize(void)
 {
     return Config::m_configData.clusterSize;
 }
 
+quint64 Config::getPoolDirSize(void)
+{
+    return Config::m_configData.poolDirSize;
+}
+
+PackingPolicy Config::getPackingPolicy(void)
+{
+    return Config::m_configData.packingPolicy;
+}
+
+int Config::getHotChanges(void)
+{
+    return Config::m_configData.hotChanges;
+}
+
+int Config::getHotDays(void)
+{
+    return Config::m_configData.hotDays;
+}
+
 bool Config::getUseCompression(void)
 {
     return Config::m_configData.useCompression;
 }
 
+bool Config::getCompressionProbe(void)
+{
+    return Config::m_configData.compressionProbe;
+}
+
+QStringList Config::getStoreExtensions(void)
+{
+    return Config::m_configData.storeExtensions;
+}
+
+double Config::getEntropyThreshold(void)
+{
+    return Config::m_configData.entropyThreshold;
+}
+
+bool Config::getSolidCompression(void)
+{
+    return Config::m_configData.solidCompression;
+}
+
+int Config::getZstdLevel(void)
+{
+    return Config::m_configData.zstdLevel;
+}
+
+int Config::getZstdWorkers(void)
+{
+    return Config::m_configData.zstdWorkers;
+}
+
 bool Config::getUseEncryption(void)
 {
     return Config::m_configData.useEncryption;
 }
 
+QString Config::getEncryptionCipher(void)
+{
+    return Config::m_configData.encryptionCipher;
+}
+
 bool Config::getAvoidFrag(void)
 {
     return Config::m_configData.avoidFrag;
 }
 
+quint64 Config::getDefragBudget(void)
+{
+    return Config::m_configData.defragBudget;
+}
+
+double Config::getDefragUploadCost(void)
+{
+    return Config::m_configData.defragUploadCost;
+}
+
+double Config::getCompactionRatio(void)
+{
+    return Config::m_configData.compactionRatio;
+}
+
+bool Config::getSplitBigFiles(void)
+{
+    return Config::m_configData.splitBigFiles;
+}
+
+quint64 Config::getCdcThreshold(void)
+{
+    return Config::m_configData.cdcThreshold;
+}
+
+quint32 Config::getCdcChunkSize(void)
+{
+    return Config::m_configData.cdcChunkSize;
+}
+
 QString Config::getSiaIpAdrress(void)
 {
     return Config::m_siaConfig.ipAddress;
@@ -106,3 +356,48 @@ QString Config::getSiaPort(void)
 {
     return Config::m_siaConfig.port;
 }
+
+int Config::getDeleteParallel(void)
+{
+    return Config::m_siaConfig.deleteParallel;
+}
+
+int Config::getUploadParallel(void)
+{
+    return Config::m_siaConfig.uploadParallel;
+}
+
+int Config::getDownloadParallel(void)
+{
+    return Config::m_siaConfig.downloadParallel;
+}
+
+int Config::getRequestParallel(void)
+{
+    return Config::m_siaConfig.requestParallel;
+}
+
+int Config::getRequestTimeout(void)
+{
+    return Config::m_siaConfig.requestTimeout;
+}
+
+int Config::getRequestRetries(void)
+{
+    return Config::m_siaConfig.requestRetries;
+}
+
+int Config::getRetryBackoff(void)
+{
+    return Config::m_siaConfig.retryBackoff;
+}
+
+QStringList Config::getUploadSchedule(void)
+{
+    return Config::m_siaConfig.uploadSchedule;
+}
+
+quint64 Config::getUploadBacklog(void)
+{
+    return Config::m_siaConfig.uploadBacklog;
+}
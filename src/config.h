@@ -6,6 +6,8 @@
 #include <QCoreApplication>
 #include <QFileInfo>
 #include <QSettings>
+#include <QStringList>
+#include <QThread>
 
 #define CONFIG_FILE_NAME QString("SIACBackup.ini")
 #define CONFIG_FILE_PATH QString(QCoreApplication::applicationDirPath()+"/"+CONFIG_FILE_NAME)
@@ -13,38 +15,114 @@
 #define KEY_BACKUP_MODE     "general/backup_mode"
 #define KEY_DATA_BASE_NAME  "general/database_name"
 #define KEY_DATA_BASE_PATH  "general/database_dir"
+#define KEY_JOURNAL_PATH    "general/journal_dir"
+#define KEY_METRICS_PATH    "general/metrics_dir"
+#define KEY_METRICS_INTERVAL "general/metrics_interval"
+#define KEY_PROGRESS_INTERVAL "general/progress_interval"
 #define KEY_CLUSTER_SIZE    "general/cluster_size"
+#define KEY_POOL_DIR_SIZE   "general/pool_dir_size"
+#define KEY_PACKING_POLICY  "general/packing_policy"
+#define KEY_HOT_CHANGES     "general/hot_changes"
+#define KEY_HOT_DAYS        "general/hot_days"
 #define KEY_USE_COMPRESSION "general/use_compression"
+#define KEY_COMPRESSION_PROBE "general/compression_probe"
+#define KEY_STORE_EXTENSIONS "general/store_extensions"
+#define KEY_ENTROPY_THRESHOLD "general/entropy_threshold"
+#define KEY_SOLID_COMPRESSION "general/solid_compression"
+#define KEY_ZSTD_LEVEL      "general/zstd_level"
+#define KEY_ZSTD_WORKERS    "general/zstd_workers"
 #define KEY_USE_ENCRYPTION  "general/use_encryption"
+#define KEY_ENC_CIPHER      "general/encryption_cipher"
 #define KEY_AVOID_FRAG      "general/avoid_frag"
+#define KEY_DEFRAG_BUDGET   "general/defrag_budget"
+#define KEY_DEFRAG_COST     "general/defrag_upload_cost"
+#define KEY_COMPACT_RATIO   "general/compaction_ratio"
+#define KEY_SPLIT_BIG_FILES "general/split_big_files"
+#define KEY_CDC_THRESHOLD   "general/cdc_threshold"
+#define KEY_CDC_CHUNK_SIZE  "general/cdc_chunk_size"
 #define KEY_IP_ADDRESS      "sia/ip_address"
 #define KEY_PORT            "sia/port"
+#define KEY_DELETE_PARALLEL "sia/delete_parallel"
+#define KEY_UPLOAD_PARALLEL "sia/upload_parallel"
+#define KEY_DOWNLOAD_PARALLEL "sia/download_parallel"
+#define KEY_REQUEST_PARALLEL "sia/request_parallel"
+#define KEY_REQUEST_TIMEOUT "sia/request_timeout"
+#define KEY_REQUEST_RETRIES "sia/request_retries"
+#define KEY_RETRY_BACKOFF   "sia/retry_backoff"
+#define KEY_UPLOAD_SCHEDULE "sia/upload_schedule"
+#define KEY_UPLOAD_BACKLOG  "sia/upload_backlog"
 
 #define BM_SEPARTE_BY_DIR  QString("SEPARTE_BY_DIR")
 #define BM_RECURSIVE       QString("RECURSIVE")
 
+//Already compressed formats (stored as-is in compression mode)
+#define DEFAULT_STORE_EXTENSIONS "jpg,jpeg,png,gif,webp,heic,mp3,m4a,aac,ogg,opus,flac,mp4,m4v,mkv,mov,avi,webm,zip,gz,tgz,bz2,xz,7z,rar,zst,lz4,jar,apk,docx,xlsx,pptx,odt,ods,odp,gpg"
+
+#define PP_SIZE            QString("SIZE")
+#define PP_LOCALITY        QString("LOCALITY")
+
+#define EC_AUTO              QString("AUTO")
+#define EC_AES_256_GCM       QString("AES_256_GCM")
+#define EC_CHACHA20_POLY1305 QString("CHACHA20_POLY1305")
+
 enum class BackupMode : int
 {
     SEPARTE_BY_DIR,
     RECURSIVE
 };
 
+enum class PackingPolicy : int
+{
+    SIZE,       //Biggest files first (tightest clusters)
+    LOCALITY    //Path order (the files of a directory stay together)
+};
+
 struct t_GeneralConfig
 {
     BackupMode  backupMode;
     QString     dbName;
     QString     dbDirPath;
     quint64     clusterSize;
+    quint64     poolDirSize;
+    PackingPolicy packingPolicy;
+    int         hotChanges;
+    int         hotDays;
     QString     tempDirPath;
+    QString     journalDirPath;
+    QString     metricsDirPath;
+    int         metricsInterval;
+    int         progressInterval;
     bool        useCompression;
+    bool        compressionProbe;
+    QStringList storeExtensions;
+    double      entropyThreshold;
+    bool        solidCompression;
+    int         zstdLevel;
+    int         zstdWorkers;
     bool        useEncryption;
+    QString     encryptionCipher;
     bool        avoidFrag;
+    quint64     defragBudget;
+    double      defragUploadCost;
+    double      compactionRatio;
+    bool        splitBigFiles;
+    quint64     cdcThreshold;
+    quint32     cdcChunkSize;
 };
 
 struct t_SiaConfig
 {
     QString ipAddress;
     QString port;
+    int     deleteParallel;
+    int     uploadParallel;
+    int     downloadParallel;
+    int     requestParallel;
+    int     requestTimeout;
+    int     requestRetries;
+    int     retryBackoff;
+    QStringList uploadSchedule;
+    quint64 uploadBacklog;
 };
 
 class Config : public QObject
@@ -54,15 +132,46 @@ public:
     explicit Config(QObject *parent = 0);
     void createDefault(void);
     bool load(void);
+    bool load(const QString configPath);
     static BackupMode getBackupMode(void);
     static QString getDatabaseName(void);
     static QString getDatabasePath(void);
+    static QString getJournalPath(void);
+    static QString getMetricsPath(void);
+    static int getMetricsInterval(void);
+    static int getProgressInterval(void);
     static quint64 getClusterSize(void);
+    static quint64 getPoolDirSize(void);
+    static PackingPolicy getPackingPolicy(void);
+    static int getHotChanges(void);
+    static int getHotDays(void);
     static bool getUseCompression(void);
+    static bool getCompressionProbe(void);
+    static QStringList getStoreExtensions(void);
+    static double getEntropyThreshold(void);
+    static bool getSolidCompression(void);
+    static int getZstdLevel(void);
+    static int getZstdWorkers(void);
     static bool getUseEncryption(void);
+    static QString getEncryptionCipher(void);
     static bool getAvoidFrag(void);
+    static quint64 getDefragBudget(void);
+    static double getDefragUploadCost(void);
+    static double getCompactionRatio(void);
+    static bool getSplitBigFiles(void);
+    static quint64 getCdcThreshold(void);
+    static quint32 getCdcChunkSize(void);
     static QString getSiaIpAdrress(void);
     static QString getSiaPort(void);
+    static int getDeleteParallel(void);
+    static int getUploadParallel(void);
+    static int getDownloadParallel(void);
+    static int getRequestParallel(void);
+    static int getRequestTimeout(void);
+    static int getRequestRetries(void);
+    static int getRetryBackoff(void);
+    static QStringList getUploadSchedule(void);
+    static quint64 getUploadBacklog(void);
 private:
     static t_GeneralConfig  m_configData;
     static t_SiaConfig      m_siaConfig;
@@ -0,0 +1,194 @@
+#include "cryptostream.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+CryptoStream::CryptoStream(QObject *parent) : QObject(parent)
+{
+    m_ctx     = EVP_CIPHER_CTX_new();
+    m_encrypt = true;
+    m_ready   = false;
+}
+
+CryptoStream::~CryptoStream(void)
+{
+    EVP_CIPHER_CTX_free(m_ctx);
+}
+
+QString CryptoStream::hardwareCipher(void)
+{
+    bool aesNi(false);
+
+    //OpenSSL use AES-NI (and VAES) by itself when the CPU has it, otherwise ChaCha20 is much faster than a software AES
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned int eax, ebx, ecx, edx;
+
+    if(__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        aesNi = (ecx & bit_AES) != 0;
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+
+    __cpuid(info, 1);
+    aesNi = (info[2] & (1 << 25)) != 0;
+#elif defined(__ARM_FEATURE_CRYPTO)
+    aesNi = true;
+#endif
+
+    return aesNi ? CIPHER_AES_256_GCM : CIPHER_CHACHA20_POLY1305;
+}
+
+QByteArray CryptoStream::deriveKey(const QString hash)
+{
+    //The key is made from the hash of the plain content (kept in the database)
+    return QCryptographicHash::hash(hash.toUtf8(), QCryptographicHash::Sha256);
+}
+
+quint64 CryptoStream::encryptedSize(const quint64 size)
+{
+    return size + ENC_EXTRA_BYTE;
+}
+
+bool CryptoStream::init(const QString cipher, const QByteArray key, const QByteArray nonce)
+{
+    const EVP_CIPHER *evpCipher;
+
+    if(cipher == CIPHER_AES_256_GCM)
+        evpCipher = EVP_aes_256_gcm();
+    else if(cipher == CIPHER_CHACHA20_POLY1305)
+        evpCipher = EVP_chacha20_poly1305();
+    else
+        return false;
+
+    EVP_CIPHER_CTX_reset(m_ctx);
+
+    if(EVP_CipherInit_ex(m_ctx, evpCipher, NULL, NULL, NULL, m_encrypt ? 1 : 0) != 1)
+        return false;
+
+    if(EVP_CIPHER_CTX_ctrl(m_ctx, EVP_CTRL_AEAD_SET_IVLEN, ENC_NONCE_BYTE, NULL) != 1)
+        return false;
+
+    if(EVP_CipherInit_ex(m_ctx, NULL, NULL, (const uchar*)key.constData(), (const uchar*)nonce.constData(), m_encrypt ? 1 : 0) != 1)
+        return false;
+
+    m_ready = true;
+
+    return true;
+}
+
+bool CryptoStream::beginEncrypt(const QString cipher, const QByteArray key, QByteArray *out)
+{
+    QByteArray nonce(ENC_NONCE_BYTE, '\0');
+
+    m_encrypt = true;
+    m_ready   = false;
+    m_pending.clear();
+
+    if(RAND_bytes((uchar*)nonce.data(), ENC_NONCE_BYTE) != 1)
+        return false;
+
+    //The nonce is the first bytes of the member
+    *out = nonce;
+
+    return this->init(cipher, key, nonce);
+}
+
+bool CryptoStream::beginDecrypt(const QString cipher, const QByteArray key)
+{
+    //The context is initialized when the nonce is read
+    m_encrypt = false;
+    m_ready   = false;
+    m_cipher  = cipher;
+    m_key     = key;
+    m_pending.clear();
+
+    return true;
+}
+
+bool CryptoStream::cipherUpdate(const char *data, const int len, QByteArray *out)
+{
+    int outLen(0);
+
+    out->resize(len);
+
+    if(len == 0)
+        return true;
+
+    if(EVP_CipherUpdate(m_ctx, (uchar*)out->data(), &outLen, (const uchar*)data, len) != 1)
+        return false;
+
+    out->resize(outLen);
+
+    return true;
+}
+
+bool CryptoStream::update(const char *data, const int len, QByteArray *out)
+{
+    int available;
+
+    out->clear();
+
+    if(m_encrypt)
+        return this->cipherUpdate(data, len, out);
+
+    m_pending.append(data, len);
+
+    if(!m_ready)
+    {
+        if(m_pending.size() < ENC_NONCE_BYTE)
+            return true;
+
+        if(!this->init(m_cipher, m_key, m_pending.left(ENC_NONCE_BYTE)))
+            return false;
+
+        m_pending.remove(0, ENC_NONCE_BYTE);
+    }
+
+    //The last bytes can be the tag, they are kept until the end
+    available = m_pending.size() - ENC_TAG_BYTE;
+
+    if(available <= 0)
+        return true;
+
+    if(!this->cipherUpdate(m_pending.constData(), available, out))
+        return false;
+
+    m_pending.remove(0, available);
+
+    return true;
+}
+
+bool CryptoStream::finish(QByteArray *out)
+{
+    uchar   block[EVP_MAX_BLOCK_LENGTH];
+    int     outLen(0);
+
+    out->clear();
+
+    if(!m_ready)
+        return false;
+
+    m_ready = false;
+
+    if(m_encrypt)
+    {
+        if(EVP_CipherFinal_ex(m_ctx, block, &outLen) != 1)
+            return false;
+
+        //The tag is the last bytes of the member
+        out->resize(ENC_TAG_BYTE);
+
+        return (EVP_CIPHER_CTX_ctrl(m_ctx, EVP_CTRL_AEAD_GET_TAG, ENC_TAG_BYTE, out->data()) == 1);
+    }
+
+    if(m_pending.size() != ENC_TAG_BYTE)
+        return false;
+
+    if(EVP_CIPHER_CTX_ctrl(m_ctx, EVP_CTRL_AEAD_SET_TAG, ENC_TAG_BYTE, m_pending.data()) != 1)
+        return false;
+
+    //Fail if the member was altered
+    return (EVP_CipherFinal_ex(m_ctx, block, &outLen) == 1);
+}
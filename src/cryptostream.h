@@ -0,0 +1,46 @@
+#ifndef CRYPTOSTREAM_H
+#define CRYPTOSTREAM_H
+
+#include <openssl/evp.h>
+#include <openssl/rand.h>
+
+#include <QObject>
+#include <QByteArray>
+#include <QString>
+#include <QCryptographicHash>
+
+#define CIPHER_AES_256_GCM          QString("AES-256-GCM")
+#define CIPHER_CHACHA20_POLY1305    QString("CHACHA20-POLY1305")
+
+//Layout of an encrypted member : nonce + cipher text (same size than the plain text) + tag
+#define ENC_NONCE_BYTE   12
+#define ENC_TAG_BYTE     16
+#define ENC_EXTRA_BYTE   (ENC_NONCE_BYTE + ENC_TAG_BYTE)
+
+//Authenticated encryption of one member, fed block by block while the archive is written (or read)
+//Both ciphers are stream ciphers, so nothing is padded and the size of the member is known before the data
+class CryptoStream : public QObject
+{
+public:
+    CryptoStream(QObject *parent = 0);
+    ~CryptoStream(void);
+    bool beginEncrypt(const QString cipher, const QByteArray key, QByteArray *out);
+    bool beginDecrypt(const QString cipher, const QByteArray key);
+    bool update(const char *data, const int len, QByteArray *out);
+    bool finish(QByteArray *out);
+    static QString hardwareCipher(void);
+    static QByteArray deriveKey(const QString hash);
+    static quint64 encryptedSize(const quint64 size);
+private:
+    bool init(const QString cipher, const QByteArray key, const QByteArray nonce);
+    bool cipherUpdate(const char *data, const int len, QByteArray *out);
+
+    EVP_CIPHER_CTX  *m_ctx;
+    bool            m_encrypt;
+    QString         m_cipher;
+    QByteArray      m_key;
+    QByteArray      m_pending;//Decrypt : the nonce until the context is ready, then the bytes which can be the tag
+    bool            m_ready;
+};
+
+#endif // CRYPTOSTREAM_H
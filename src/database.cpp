@@ -4,12 +4,22 @@ DataBase::DataBase(QObject *parent) : QObject(parent)
 {
     m_siaCom            = new SIACom(this);
     m_archiveBuilder    = new ArchiveBuilder(this);
+    m_compressionPolicy = new CompressionPolicy(this);
+    m_defragBytes       = 0;
+    m_sharedRoots       = false;
+    m_carryTail         = false;
+    m_solidInBytes      = 0;
+    m_solidOutBytes     = 0;
+    m_planMode          = false;
+
+    memset(&m_planReport, 0, sizeof(m_planReport));
 }
 
 DataBase::~DataBase(void)
 {
     delete m_siaCom;
     delete m_archiveBuilder;
+    delete m_compressionPolicy;
 }
 
 bool DataBase::load(void)
@@ -24,6 +34,21 @@ bool DataBase::load(void)
     //Setup the database with this name respectively
     m_sqlDb.setDatabaseName(QString(Config::getDatabasePath() +"/"+ Config::getDatabaseName()));
 
+    //A dry run works on a copy, the real database is never changed
+    if(m_planMode == true)
+    {
+        QDir().mkpath(Config::getJournalPath());
+        QFile::remove(Config::getJournalPath() +"/"+ PLAN_SNAPSHOT_NAME);
+
+        if(QFile::exists(m_sqlDb.databaseName()) && !QFile::copy(m_sqlDb.databaseName(), Config::getJournalPath() +"/"+ PLAN_SNAPSHOT_NAME))
+        {
+            qCritical("Cannot copy the database for the plan !");
+            return false;
+        }
+
+        m_sqlDb.setDatabaseName(Config::getJournalPath() +"/"+ PLAN_SNAPSHOT_NAME);
+    }
+
     //Open the database and look for error
     if(!m_sqlDb.open())
     {
@@ -31,15 +56,35 @@ bool DataBase::load(void)
         return false;
     }
 
+    //The clusters are built next to the journal (the config is loaded now)
+    m_archiveBuilder->setBaseDir(Config::getJournalPath());
+
+    m_siaCom->setUploadSchedule(Config::getUploadSchedule());
+
     return true;
 }
 
+QSqlQuery DataBase::execQuery(const QString sql)
+{
+    StageTimer stageTimer(Stage::SQL);
+
+    return m_sqlDb.exec(sql);
+}
+
 void DataBase::unload(void)
 {
     QSqlQuery query;
 
+    //The snapshot of a dry run is thrown away
+    if(m_planMode == true)
+    {
+        m_sqlDb.close();
+        QFile::remove(Config::getJournalPath() +"/"+ PLAN_SNAPSHOT_NAME);
+        return;
+    }
+
     //Clean the database
-    query = m_sqlDb.exec("VACUUM;");
+    query = this->execQuery("VACUUM;");
     qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
 
     //Close the database
@@ -53,10 +98,91 @@ bool DataBase::setupDataBase(void)
     if(!m_sqlDb.isOpen())
         return false;
 
-    query = m_sqlDb.exec(SQL_QUERY_CREATE_TABLE_INDEX);
+    query = this->execQuery(SQL_QUERY_CREATE_TABLE_INDEX);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_CREATE_TABLE_TEMP);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    //Database made by an older version (fail silently if the column already exist)
+    query = this->execQuery(SQL_QUERY_UPGRADE_TABLE_INDEX_MEMBER);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_UPGRADE_TABLE_INDEX_HEADER_OFFSET);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_UPGRADE_TABLE_INDEX_DATA_OFFSET);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_UPGRADE_TABLE_INDEX_DATA_LENGTH);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_UPGRADE_TABLE_INDEX_CIPHER);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_UPGRADE_TABLE_INDEX_CHANGES);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_UPGRADE_TABLE_INDEX_CHANGED_AT);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_UPGRADE_TABLE_INDEX_COMPRESSION);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_CREATE_INDEX_INDEX_HASH);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_CREATE_TABLE_DEDUP_TEMP);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_CREATE_TABLE_CHURN);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_CREATE_TABLE_DELETE);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_CREATE_TABLE_CLUSTER);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    //Clusters made by an older version (all their files are considered alive)
+    query = this->execQuery(SQL_QUERY_UPGRADE_TABLE_CLUSTER);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    //The dead members are not kept anymore (the live size of a cluster is computed from the index)
+    query = this->execQuery(SQL_QUERY_DROP_TABLE_TOMBSTONE);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_CREATE_TABLE_CHUNK);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_UPGRADE_TABLE_CHUNK_CIPHER);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_CREATE_TABLE_FILE_CHUNK);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_CREATE_INDEX_FILE_CHUNK_SOURCE);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_CREATE_INDEX_FILE_CHUNK_HASH);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_CREATE_TABLE_CHUNK_TEMP);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_CREATE_TABLE_FILE_CHUNK_TEMP);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_CREATE_TABLE_CHUNKED_TEMP);
     qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
 
-    query = m_sqlDb.exec(SQL_QUERY_CREATE_TABLE_TEMP);
+    query = this->execQuery(SQL_QUERY_CREATE_TABLE_HASH_CACHE);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_UPGRADE_TABLE_HASH_CACHE_PENDING);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_CREATE_TABLE_JOURNAL);
     qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
 
     return true;
@@ -73,9 +199,93 @@ t_SyncData DataBase::getSyncData(void) const
     return m_syncData;
 }
 
+void DataBase::setSharedRoots(const bool sharedRoots)
+{
+    m_sharedRoots = sharedRoots;
+}
+
+void DataBase::setCarryTail(const bool carryTail)
+{
+    m_carryTail = carryTail;
+}
+
+void DataBase::setPlanMode(const bool planMode)
+{
+    m_planMode = planMode;
+}
+
+void DataBase::printPlan(void)
+{
+    QSqlQuery query;
+
+    //The deletes are only queued by a dry run
+    query = this->execQuery(SQL_QUERY_COUNT_PENDING_DELETE);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+    query.next();
+
+    qInfo("Plan :");
+    qInfo(QString("Clusters to upload : "+ QString::number(m_planReport.clusters) +" ("+ QString::number(m_planReport.files) +" files)").toUtf8());
+    qInfo(QString("Chunk clusters to upload : "+ QString::number(m_planReport.chunkClusters) +" ("+ QString::number(m_planReport.chunks) +" chunks)").toUtf8());
+    qInfo(QString("Bytes to upload : "+ QString::number(m_planReport.uploadBytes) +" (data : "+ QString::number(m_planReport.payloadBytes) +")").toUtf8());
+    qInfo(QString("Padding on SIA : "+ QString::number(m_planReport.paddingBytes) +" bytes").toUtf8());
+    qInfo(QString("Clusters to delete from SIA : "+ query.value(0).toString()).toUtf8());
+
+    //What the plan can't know without reading the files
+    if((Config::getUseCompression() == true) || (Config::getSolidCompression() == true))
+        qInfo("The sizes are computed without compression (upper bound).");
+
+    qInfo("The new and changed files are not read : the duplicates of their content are not predicted.");
+}
+
+QString DataBase::planClusterId(void)
+{
+    //Unique in the snapshot, never uploaded
+    return QString("plan-%1").arg(m_planReport.clusters + m_planReport.chunkClusters + 1, 6, 10, QChar('0'));
+}
+
+void DataBase::planCluster(const t_archiveInfo archiveInfo, const quint64 payloadBytes, const bool chunkCluster)
+{
+    const quint64 CLUSTER_SIZE(Config::getClusterSize());
+
+    if(chunkCluster)
+    {
+        m_planReport.chunkClusters++;
+        m_planReport.chunks += archiveInfo.entryCount;
+    }
+    else
+    {
+        m_planReport.clusters++;
+        m_planReport.files += archiveInfo.entryCount;
+    }
+
+    m_planReport.payloadBytes += payloadBytes;
+    m_planReport.uploadBytes  += archiveInfo.archiveSize;
+
+    //SIA store the data by chunks of the cluster size, the end of the last one is padded
+    if((archiveInfo.archiveSize % CLUSTER_SIZE) != 0)
+        m_planReport.paddingBytes += CLUSTER_SIZE - (archiveInfo.archiveSize % CLUSTER_SIZE);
+
+    qInfo(QString("Plan : "+ QString::number(archiveInfo.entryCount) +" members, "+ QString::number(archiveInfo.archiveSize) +" bytes").toUtf8());
+}
+
+void DataBase::printLocality(void)
+{
+    QSqlQuery query;
+
+    //The chunked files have no cluster of their own
+    query = this->execQuery(SQL_QUERY_GET_CLUSTERS_PER_DIR);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    if(!query.next())
+        return;
+
+    qInfo(QString("Locality : "+ QString::number(query.value(1).toDouble(), 'f', 2) +" clusters per directory (max "+ query.value(2).toString() +", "+ query.value(0).toString() +" directorys)").toUtf8());
+}
+
 void DataBase::getDirList(QStringList *dirList)
 {
     QStringList subList;
+    StageTimer  stageTimer(Stage::SCAN);
 
     //Append the base directory in the top of the main research list
     (*dirList) << QFileInfo(m_syncData.rootSrcPath).absoluteFilePath();
@@ -92,40 +302,154 @@ void DataBase::getDirList(QStringList *dirList)
     }
 }
 
-void DataBase::buildTemporaryTable(const QString currentDir, const QStringList *fileList)
+void DataBase::getFileList(const QString dir, QFileInfoList *fileList)
+{
+    StageTimer stageTimer(Stage::SCAN);
+
+    //Scan files in the directory (the infos keep the size and date read by the first stat)
+    *fileList = QDir(dir).entryInfoList(QDir::Files | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System | QDir::CaseSensitive, QDir::Name);
+
+    Metrics::add(Stage::SCAN, fileList->count(), 0);
+}
+
+quint64 DataBase::getDirSize(const QFileInfoList *fileList)
+{
+    quint64 dirSize(0);
+
+    //Files of the directory only (not recursive)
+    foreach(QFileInfo file, *fileList)
+        dirSize += file.size();
+
+    return dirSize;
+}
+
+void DataBase::planProgress(const QStringList *dirList)
+{
+    QFileInfoList   infoList;
+    quint64         fileCount(0), byteCount(0), uploadBytes(0);
+
+    //Files to scan and bytes to hash (the files with a cached hash are removed while hashing)
+    foreach(QString dir, *dirList)
+    {
+        infoList = QDir(dir).entryInfoList(QDir::Files | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System);
+
+        foreach(QFileInfo info, infoList)
+        {
+            byteCount += info.size();
+
+            //The new and changed files are uploaded, counted as tar members like the uploaded clusters (an upper bound : the deduplication and the compression are not known yet)
+            if(this->getCachedHash(info, false).isEmpty())
+                uploadBytes += TAR_HEADER_BYTE + TAR_BLOCKS(info.size() + (Config::getUseEncryption() ? ENC_EXTRA_BYTE : 0));
+        }
+
+        fileCount += infoList.count();
+    }
+
+    Metrics::addTotal(Stage::SCAN, fileCount, 0);
+    Metrics::addTotal(Stage::HASH, fileCount, byteCount);
+    Metrics::addTotal(Stage::UPLOAD, 0, uploadBytes);
+
+    qInfo(QString("Planned : "+ QString::number(fileCount) +" files, "+ QString::number(byteCount) +" bytes").toUtf8());
+}
+
+void DataBase::buildTemporaryTable(const QString currentDir, const QFileInfoList *fileList)
+{
+    //In the sperate by dir mode the temp database need to be wiped
+    if(Config::getBackupMode() == BackupMode::SEPARTE_BY_DIR)
+        this->resetTemporaryTable();
+
+    this->fillTemporaryTable(currentDir, fileList);
+}
+
+void DataBase::fillTemporaryTable(const QString currentDir, const QFileInfoList *fileList)
 {
     t_TempTable entry;
-    QFileInfo   file;
     QSqlQuery   query;
+    QString     cachedHash;
 
     qInfo(QString("Getting "+ QString::number(fileList->count()) +" files infos in the directory : ").toUtf8());
     qInfo(currentDir.toUtf8());
 
-    //In the sperate by dir mode the temp database need to be wiped
-    if(Config::getBackupMode() == BackupMode::SEPARTE_BY_DIR)
-        this->resetTemporaryTable();
+    //The directory is recorded at once (a stopped run hash again only the unfinished directory)
+    m_sqlDb.transaction();
 
     //for each files in the current directory
-    foreach(QString str_file, *fileList)
+    foreach(QFileInfo file, *fileList)
     {
-        //Get file informations
-        file = QFileInfo(currentDir +"/"+ str_file);
-
         //Pickup useful informations
         entry.source    = file.absoluteFilePath();
-        entry.hash      = this->getFileHash(entry.source);
         entry.size      = file.size();
 
+        //A file hashed by a stopped run (same size and date) is not read again, a dry run takes any file with the same size and date as unchanged
+        cachedHash = this->getCachedHash(file, !m_planMode);
+
+        if(!cachedHash.isEmpty())
+        {
+            entry.hash = QByteArray::fromHex(cachedHash.toUtf8());
+            Metrics::removeTotal(Stage::HASH, 1, entry.size);
+        }
+        //A dry run doesn't read the new and changed files (seen as new content)
+        else if(m_planMode == true)
+        {
+            entry.hash = QCryptographicHash::hash(QString(entry.source +"|"+ QString::number(file.lastModified().toMSecsSinceEpoch())).toUtf8(), QCryptographicHash::Sha1);
+            Metrics::removeTotal(Stage::HASH, 1, entry.size);
+        }
+        else
+        {
+            entry.hash = this->getFileHash(entry.source);
+
+            //An unreadable file (locked, no right) keeps its last backup, a new one is left to the next run
+            if(entry.hash.isEmpty())
+            {
+                query = this->execQuery(SQL_QUERY_GET_INDEX_HASH(entry.source));
+                qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+                if(!query.next())
+                {
+                    qWarning(QString("Cannot read "+ entry.source +", it is left to the next run.").toUtf8());
+                    continue;
+                }
+
+                qWarning(QString("Cannot read "+ entry.source +", its last backup is kept.").toUtf8());
+
+                entry.hash = QByteArray::fromHex(query.value(0).toString().toUtf8());
+
+                query = this->execQuery(SQL_QUERY_INSERT_TABLE_TEMP(entry.source, entry.hash.toHex(), QString::number(entry.size)));
+                qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+                continue;
+            }
+
+            query = this->execQuery(SQL_QUERY_CACHE_HASH(entry.source, QString::number(entry.size), QString::number(file.lastModified().toMSecsSinceEpoch()), entry.hash.toHex()));
+            qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+        }
+
         //Store information in database
-        query = m_sqlDb.exec(SQL_QUERY_INSERT_TABLE_TEMP(entry.source, entry.hash.toHex(), QString::number(entry.size)));
+        query = this->execQuery(SQL_QUERY_INSERT_TABLE_TEMP(entry.source, entry.hash.toHex(), QString::number(entry.size)));
         qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
     }
+
+    m_sqlDb.commit();
+}
+
+QString DataBase::getCachedHash(const QFileInfo file, const bool thisRunOnly)
+{
+    QSqlQuery query;
+
+    //An edit can keep the size and the date (touch -r, rsync -t...), only the hashes of the unfinished run are trusted to skip the read
+    query = this->execQuery(SQL_QUERY_GET_CACHED_HASH(file.absoluteFilePath(), QString::number(file.size()), QString::number(file.lastModified().toMSecsSinceEpoch()), QString::number(thisRunOnly ? 1 : 0)));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    if(!query.next())
+        return QString();
+
+    return query.value(0).toString();
 }
 
 QByteArray DataBase::getFileHash(const QString str_file)
 {
     QFile               file(str_file);
     QCryptographicHash  sha1(QCryptographicHash::Sha1);
+    StageTimer          stageTimer(Stage::HASH);
 
     if(!file.open(QFile::ReadOnly))
         return QByteArray();
@@ -133,6 +457,8 @@ QByteArray DataBase::getFileHash(const QString str_file)
     if(!sha1.addData(&file))
         return QByteArray();
 
+    Metrics::add(Stage::HASH, 1, file.size());
+
     return sha1.result();
 }
 
@@ -143,6 +469,43 @@ void DataBase::syncDataBase(const QString currentDir)
     this->appendProcedure(currentDir);
 }
 
+void DataBase::syncDirPool(const QString poolDir, const QMap<QString, QFileInfoList> pooledDirs)
+{
+    QFileInfoList fileList;
+
+    qInfo(QString("Pooling "+ QString::number(pooledDirs.count()) +" small directorys in the clusters of : "+ poolDir).toUtf8());
+
+    //The temp table hold the files of all the pooled directorys (the file lists of the scan are reused)
+    this->resetTemporaryTable();
+
+    foreach(QString dir, pooledDirs.keys())
+    {
+        fileList = pooledDirs.value(dir);
+        this->fillTemporaryTable(dir, &fileList);
+    }
+
+    //The missing and changed files are looked for in each directory (not recursive)
+    foreach(QString dir, pooledDirs.keys())
+    {
+        this->deleteProcedure(dir);
+        this->changeProcedure(dir);
+
+        if(Config::getCompactionRatio() > 0.0)
+            this->compactProcedure(dir);
+    }
+
+    //The new files of the pool are packed together, under the SIA path of the pool directory
+    //The deduplication can reference the clusters of every pooled directory (and of the pool directory)
+    m_dedupDirs = pooledDirs.keys();
+
+    if(!m_dedupDirs.contains(poolDir))
+        m_dedupDirs << poolDir;
+
+    this->appendProcedure(poolDir);
+
+    m_dedupDirs.clear();
+}
+
 void DataBase::deleteProcedure(const QString currentDir)
 {
     QLinkedList<t_IndexTable> list;
@@ -153,397 +516,1822 @@ void DataBase::deleteProcedure(const QString currentDir)
     //Find the deleted files in the local directory
     list = this->lookForDeletedFiles(currentDir);
 
-    //Delete from both SIA and database the entry
+    //Tombstone the entries (the empty clusters are deleted from SIA)
     foreach(t_IndexTable entry, list)
     {
-        //Delete the entry from database
-        this->deleteCluster(entry.cluster);
+        //A chunked file only release its chunks (the unused chunk clusters are deleted at the end of the run)
+        if(entry.cluster.startsWith(CDC_CLUSTER_PREFIX))
+        {
+            this->releaseChunkedFile(entry.source);
+            continue;
+        }
 
-        //Delete target on SIA
-        m_siaCom->deleteFile(entry.target);
+        //Only this entry is removed, the other files of the cluster stay on SIA
+        this->tombstoneFile(entry);
     }
 
-    qInfo(QString("Sync : Result "+QString::number(list.count())+" files removed from SIA.").toUtf8());
+    qInfo(QString("Sync : Result "+QString::number(list.count())+" files removed from the index.").toUtf8());
 }
 
 void DataBase::changeProcedure(const QString currentDir)
 {
     QLinkedList<t_IndexTable> list;
     QSqlQuery                 query;
+    qint64                    now(QDateTime::currentDateTime().toMSecsSinceEpoch() / 1000);
 
     qInfo("Sync : Looking for changes in files...");
 
     //Find the changed files in the local directory
     list = this->lookForChangedFiles(currentDir);
 
-    //Delete from both SIA and database the entry
+    //Tombstone the entries (the new version will be in a new cluster)
     foreach (t_IndexTable entry, list)
     {
-        //Delete the entry from database
-        this->deleteCluster(entry.cluster);
+        //The new version keeps the change frequency of the file
+        query = this->execQuery(SQL_QUERY_RECORD_CHANGE(entry.source, QString::number(now), QString::number(now - Config::getHotDays() * 86400)));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+        //A chunked file only release its chunks, the unchanged ones are used again by the new version
+        if(entry.cluster.startsWith(CDC_CLUSTER_PREFIX))
+        {
+            this->releaseChunkedFile(entry.source);
+            continue;
+        }
 
-        //Delete target on SIA
-        m_siaCom->deleteFile(entry.target);
+        //Only this entry is removed, the other files of the cluster stay on SIA
+        this->tombstoneFile(entry);
     }
 
-    qInfo(QString("Sync : Result "+QString::number(list.count())+" files removed from SIA.").toUtf8());
+    qInfo(QString("Sync : Result "+QString::number(list.count())+" files removed from the index.").toUtf8());
 }
 
 void DataBase::appendProcedure(const QString currentDir)
 {
     t_clusterInfo clusterInfo;
+    QSqlQuery     query;
 
     qInfo("Sync : Looking for new files...");
 
     //Sync the temp table with the index table, after that the remains entry in temp table is the files to upload
     this->syncTables();
 
-    //To avoid fragmentation, the smaller cluster in this directory is delete
-    if((Config::getAvoidFrag() == true) && (this->getFileCountInTempTable() > 0))
-        this->deleteSmallerCluster(currentDir);
+    //The clusters with too many dead files give back their live files to the pending list
+    if(Config::getCompactionRatio() > 0.0)
+        this->compactProcedure(currentDir);
+
+    //The files already on SIA (same content at another path) are not uploaded again
+    this->dedupProcedure(currentDir);
+
+    //The big files are cut in chunks and uploaded apart from the other files
+    if(Config::getCdcThreshold() > 0)
+    {
+        ChunkBuilder chunkBuilder(Config::getCdcChunkSize());
+        this->chunkProcedure(currentDir, &chunkBuilder, Config::getCdcThreshold());
+    }
+
+    //The files bigger than a cluster are cut in parts of one cluster (uploaded at the same time)
+    if(Config::getSplitBigFiles() == true)
+    {
+        ChunkBuilder partBuilder(Config::getCdcChunkSize());
+        quint64      partSize(TAR_PART_BYTE(Config::getClusterSize()));
+
+        //An encrypted part has the nonce and the tag around the data
+        if(Config::getUseEncryption() == true)
+            partSize -= ENC_EXTRA_BYTE;
+
+        partBuilder.setFixedSize(partSize);
+        this->chunkProcedure(currentDir, &partBuilder, partSize + 1);
+    }
+
+    //To avoid fragmentation, the under-filled clusters are merged with the new files when it pays off
+    if(Config::getAvoidFrag() == true)
+        this->defragProcedure(currentDir);
 
     qInfo(QString("Sync : Result "+QString::number(this->getFileCountInTempTable())+" files to upload on SIA.").toUtf8());
 
+    //The pending deletes must reach SIA before a cluster with the same name is uploaded again
+    if(this->getFileCountInTempTable() > 0)
+        this->flushDeleteQueue();
+
     //Continu if there is another files to upload
     while(this->getFileCountInTempTable() > 0)
     {
+        //The last partial cluster is filled with the files of the next source root
+        if(m_carryTail && (this->getFileBytesInTempTable() < this->getPackingLimit()))
+        {
+            qInfo(QString("Sync : "+ QString::number(this->getFileCountInTempTable()) +" files left to the clusters of the next source root.").toUtf8());
+            break;
+        }
+
+        Metrics::setQueueDepth(Stage::PACK, this->getFileCountInTempTable());
+
         //Form cluster
         clusterInfo = this->buildCluster(currentDir);
 
+        //No cluster (a file can't be archived)
+        if(clusterInfo.clusterId.isEmpty())
+            continue;
+
         qInfo("Submiting cluster to SIA");
 
-        //upload source on SIA
-        m_siaCom->uploadFile(clusterInfo.tarFile.absoluteFilePath(), clusterInfo.targetSiaName);
+        //A dry run only count the cluster
+        if(m_planMode == true)
+            continue;
+
+        //Outside of the upload windows the cluster waits in the journal and the next one is built
+        if(this->deferUpload())
+            continue;
+
+        //upload source on SIA (a failed upload stay in the journal for the next run)
+        if(!m_siaCom->uploadFile(clusterInfo.tarFile.absoluteFilePath(), clusterInfo.targetSiaName))
+        {
+            qWarning("The cluster stay in the journal, it will be uploaded at the next run.");
+            continue;
+        }
 
         qInfo("Deleting cluster from local directory");
 
-        //Delete the temp archive
-        QFile::remove(clusterInfo.tarFile.absoluteFilePath());
+        //Delete the journaled archive
+        this->releaseJournal(clusterInfo);
     }
-}
 
-t_clusterInfo DataBase::buildCluster(const QString currentDir)
-{
-    QSqlQuery                       query;
-    QLinkedList<t_IndexTable*>      *clusterEntryList;
-    QStringList                     filesToArchive;
-    t_clusterInfo                   clusterInfo;
+    Metrics::setQueueDepth(Stage::PACK, 0);
 
-    clusterEntryList = new QLinkedList<t_IndexTable*>();
+    //The duplicates of the uploaded files point now to their clusters
+    this->resolveDuplicates(currentDir);
 
-    //Get the cluster files list
-    this->buildClusterFilesList(currentDir, clusterEntryList, &filesToArchive);
+    //The packed files get back their change frequency
+    query = this->execQuery(SQL_QUERY_RESTORE_CHURN);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
 
-    //Create the cluster file with previous data
-    clusterInfo = this->makeClusterFile(currentDir, clusterEntryList, &filesToArchive);
+    query = this->execQuery(SQL_QUERY_CLEAR_RESTORED_CHURN);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+}
 
-    qInfo("New cluster build !");
-    qInfo("Recording in database...");
+void DataBase::dedupProcedure(const QString currentDir)
+{
+    QSqlQuery   query;
+    int         referenced;
 
-    //Record in database the new cluster and remove them from the temp table
-    foreach(t_IndexTable *clusterEntry, (*clusterEntryList))
-    {
-        //Build the target path on SIA
-        clusterInfo.targetSiaName  = m_syncData.rootDstPath;
-        clusterInfo.targetSiaName += currentDir.section(m_syncData.rootSrcPath, 1);
-        clusterInfo.targetSiaName += "/";
-        clusterInfo.targetSiaName += clusterInfo.tarFile.fileName();
+    qInfo("Sync : Looking for files already on SIA...");
 
-        query = m_sqlDb.exec(SQL_QUERY_INSERT_INDEX_TABLE(clusterInfo.clusterId, clusterEntry->source, clusterInfo.targetSiaName, clusterEntry->hash, QString::number(clusterEntry->size)));
-        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
-    }
+    //Record the files with a known hash as reference to the existing cluster and member
+    referenced = this->dedupFromIndex("temp_table", currentDir);
 
-    qInfo("Synchronizing the temporary files list with permanent database...");
-    //Sync the temp table with the index table
+    //They are now in index_table
     this->syncTables();
 
-    //Delete the zip dir
-    m_archiveBuilder->cleanMirrorDir();
+    //The pending files with the same content are uploaded once, the duplicates are set apart until the upload is done
+    query = this->execQuery(SQL_QUERY_CLEAR_DEDUP_TEMP);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
 
-    qInfo("Done !");
-    qInfo("Result :");
-    qInfo(QString("Cluster ID : "+ clusterInfo.clusterId +", Files : "+ QString::number(clusterEntryList->count()).toUtf8() +", Size : "+ QString::number(clusterInfo.tarFile.size())).toUtf8());
+    query = this->execQuery(SQL_QUERY_MOVE_PENDING_DUPLICATES(this->getDedupMaxSize()));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
 
-    //Unload all the entry list from memory
-    while(!clusterEntryList->isEmpty())
-          delete clusterEntryList->takeFirst();
+    query = this->execQuery(SQL_QUERY_REMOVE_PENDING_DUPLICATES);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
 
-    delete clusterEntryList;
+    query = this->execQuery(SQL_QUERY_COUNT_DEDUP_TEMP_TABLE_ROW);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+    query.next();
 
-    return clusterInfo;
+    qInfo(QString("Sync : Result "+ QString::number(referenced) +" files already on SIA, "+ query.value(0).toString() +" duplicates in the new files.").toUtf8());
 }
 
-void DataBase::buildClusterFilesList(const QString currentDir, QLinkedList<t_IndexTable *> *outDataList, QStringList *outStrList)
+void DataBase::resolveDuplicates(const QString currentDir)
 {
-    QSqlQuery       query;
-    int             sourceField(0), sizeField(0), hashField(0);
-    int             counter(0);
-    quint64         clusterSize(0), fileSize(0);
-    QFileInfo       zipFile;
-    t_IndexTable    *clusterEntry;
+    QSqlQuery query;
 
-    m_archiveBuilder->setWorkingDirectory(currentDir);
+    this->dedupFromIndex("dedup_temp_table", currentDir);
 
-    const quint64 CLUSTER_SIZE(Config::getClusterSize());
+    query = this->execQuery(SQL_QUERY_RESOLVE_PENDING_DUPLICATES);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    //Should never happen, the unresolved duplicates go back in the pending list for the next sync
+    query = this->execQuery(SQL_QUERY_RESTORE_PENDING_DUPLICATES);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_CLEAR_DEDUP_TEMP);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+}
+
+int DataBase::dedupFromIndex(const QString table, const QString currentDir)
+{
+    QSqlQuery   query;
+    QStringList scopes;
+
+    if(Config::getBackupMode() == BackupMode::SEPARTE_BY_DIR)
+    {
+        //Only the clusters of this directory can be referenced (keep each directory usable on its own), or of the directorys of its pool
+        if(m_dedupDirs.isEmpty())
+            scopes << SQL_QUERY_DEDUP_SCOPE(currentDir);
+
+        foreach(QString dir, m_dedupDirs)
+            scopes << SQL_QUERY_DEDUP_SCOPE(dir);
+
+        query = this->execQuery(SQL_QUERY_DEDUP_FROM_INDEX(table, "("+ scopes.join(" OR ") +")", this->getDedupMaxSize()));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+    }
+    else if(Config::getBackupMode() == BackupMode::RECURSIVE)
+    {
+        query = this->execQuery(SQL_QUERY_DEDUP_FROM_INDEX(table, SQL_QUERY_DEDUP_SCOPE_RECURSIVE(currentDir), this->getDedupMaxSize()));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+    }
+
+    return query.numRowsAffected();
+}
+
+QString DataBase::getDedupMaxSize(void)
+{
+    //The big files are deduplicated by chunks
+    if(Config::getCdcThreshold() > 0)
+        return QString::number(Config::getCdcThreshold());
+
+    return QString::number(std::numeric_limits<qint64>::max());
+}
+
+t_clusterInfo DataBase::buildCluster(const QString currentDir)
+{
+    QSqlQuery                       query;
+    t_clusterInfo                   clusterInfo;
+    QString                         source;
+    quint64                         clusterDataSize(0);
+
+    //Get the cluster files list
+    this->buildClusterFilesList(currentDir, &m_candidates);
+
+    //Create the cluster file with previous data
+    clusterInfo = this->makeClusterFile(currentDir, &m_candidates);
+
+    if(clusterInfo.clusterId.isEmpty())
+    {
+        m_archiveBuilder->cleanMirrorDir();
+        m_candidates.clear();
+
+        return clusterInfo;
+    }
+
+    qInfo("New cluster build !");
+    qInfo("Recording in database...");
+
+    //The cluster and its files are recorded at once with its journal entry
+    m_sqlDb.transaction();
+
+    //Record in database the new cluster and remove them from the temp table
+    for(int i(0); i < m_candidates.count(); i++)
+    {
+        const t_candidate &clusterEntry = m_candidates.at(i);
+
+        source = m_candidates.source(i);
+
+        //Build the target path on SIA (the files carried from the previous source roots go under the target of the current root)
+        clusterInfo.targetSiaName  = m_syncData.rootDstPath;
+        clusterInfo.targetSiaName += currentDir.section(m_syncData.rootSrcPath, 1);
+        clusterInfo.targetSiaName += "/";
+        clusterInfo.targetSiaName += clusterInfo.tarFile.fileName();
+
+        query = this->execQuery(SQL_QUERY_INSERT_INDEX_TABLE(clusterInfo.clusterId, source, clusterInfo.targetSiaName, m_candidates.hash(i), QString::number(clusterEntry.size), m_candidates.member(i)));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+        //Position of the member in the cluster (a single file can be read without the whole cluster)
+        query = this->execQuery(SQL_QUERY_SET_INDEX_OFFSETS(source, QString::number(clusterEntry.headerOffset), QString::number(clusterEntry.dataOffset), QString::number(clusterEntry.dataLength)));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+        //The restore knows if the member is packed without its name, the next runs don't probe again the file (its cluster can be merged)
+        if((Config::getUseCompression() == true) && (m_planMode == false))
+            query = this->execQuery(SQL_QUERY_SET_INDEX_COMPRESSION(source, clusterEntry.stored ? COMPRESSION_STORE : COMPRESSION_DEFLATE));
+        else
+            query = this->execQuery(SQL_QUERY_SET_INDEX_COMPRESSION(source, COMPRESSION_NONE));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+        //The key is made from the hash, only the cipher is recorded
+        if(Config::getUseEncryption() == true)
+        {
+            query = this->execQuery(SQL_QUERY_SET_INDEX_CIPHER(source, m_archiveBuilder->getCipher()));
+            qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+        }
+
+        clusterDataSize += clusterEntry.size;
+    }
+
+    //All the bytes of a new cluster are alive
+    query = this->execQuery(SQL_QUERY_INSERT_CLUSTER_TABLE(clusterInfo.clusterId, clusterInfo.targetSiaName, QString::number(clusterDataSize)));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    qInfo("Synchronizing the temporary files list with permanent database...");
+    //Sync the temp table with the index table
+    this->syncTables();
+
+    //Keep the archive until SIA confirm the upload
+    this->journalCluster(&clusterInfo, JOURNAL_KIND_FILES);
+
+    m_sqlDb.commit();
+
+    //Delete the zip dir
+    m_archiveBuilder->cleanMirrorDir();
+
+    qInfo("Done !");
+    qInfo("Result :");
+    qInfo(QString("Cluster ID : "+ clusterInfo.clusterId +", Files : "+ QString::number(m_candidates.count()).toUtf8() +", Size : "+ QString::number(clusterInfo.tarFile.size())).toUtf8());
+
+    //The memory of the list is kept for the next cluster
+    m_candidates.clear();
+
+    return clusterInfo;
+}
+
+void DataBase::chunkProcedure(const QString currentDir, ChunkBuilder *chunkBuilder, const quint64 minSize)
+{
+    QSqlQuery               query;
+    QLinkedList<t_IndexTable> list;
+    t_IndexTable            entry;
+    int                     sourceField, hashField, sizeField;
+
+    //Enough chunks are kept to upload several clusters at the same time
+    const quint64 BATCH_SIZE(Config::getClusterSize() * Config::getUploadParallel());
+
+    query = this->execQuery(SQL_QUERY_GET_SRC_TO_CHUNK(QString::number(minSize)));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    sourceField = query.record().indexOf("Source");
+    hashField   = query.record().indexOf("Hash");
+    sizeField   = query.record().indexOf("Size");
+
+    while(query.next())
+    {
+        entry.source = query.value(sourceField).toString();
+        entry.hash   = query.value(hashField).toString();
+        entry.size   = query.value(sizeField).toULongLong();
+
+        list << entry;
+    }
+
+    if(list.isEmpty())
+        return;
+
+    qInfo(QString("Sync : Cutting "+ QString::number(list.count()) +" big files in chunks...").toUtf8());
+
+    //The pending deletes must reach SIA before a cluster with the same name is uploaded again
+    this->flushDeleteQueue();
+
+    foreach(t_IndexTable bigFile, list)
+    {
+        if(!this->chunkFile(chunkBuilder, bigFile))
+            continue;
+
+        //Upload the full clusters as soon as possible to keep the temporary directory small
+        if(this->getChunkBytesInTempTable() >= BATCH_SIZE)
+            this->uploadChunkClusters(currentDir, Config::getClusterSize());
+    }
+
+    //Upload the remaining chunks
+    this->uploadChunkClusters(currentDir, 0);
+
+    //A file with a chunk which never reached a cluster is not recorded, it is chunked again at the next run
+    query = this->execQuery(SQL_QUERY_GET_PENDING_CHUNKED_FILES);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    list.clear();
+    while(query.next())
+    {
+        entry.source = query.value(0).toString();
+        list << entry;
+    }
+
+    m_sqlDb.transaction();
+    foreach(t_IndexTable pending, list)
+    {
+        qWarning(QString("The chunks of "+ pending.source +" are not all in a cluster, it is left to the next run.").toUtf8());
+
+        this->discardChunkedFile(pending.source);
+
+        query = this->execQuery(SQL_QUERY_DELETE_TEMP_SOURCE(pending.source));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+    }
+    m_sqlDb.commit();
+
+    //The chunked files are now in index_table
+    this->syncTables();
+
+    qInfo("Sync : Chunked files done.");
+}
+
+void DataBase::uploadChunkClusters(const QString currentDir, const quint64 keepBytes)
+{
+    t_clusterInfo           clusterInfo;
+    QList<t_clusterInfo>    clusterList;
+    QStringList             srcPaths;
+    QStringList             siaPaths;
+
+    //Build the clusters until only the chunks of an incomplete cluster remain (or none if keepBytes is 0)
+    while((this->getChunkCountInTempTable() > 0) && ((keepBytes == 0) || (this->getChunkBytesInTempTable() >= keepBytes)))
+    {
+        clusterInfo = this->buildChunkCluster(currentDir);
+
+        //No cluster (a chunk can't be archived)
+        if(clusterInfo.clusterId.isEmpty())
+            continue;
+
+        srcPaths << clusterInfo.tarFile.absoluteFilePath();
+        siaPaths << clusterInfo.targetSiaName;
+
+        clusterList << clusterInfo;
+
+        //A dry run only count the clusters
+        if(m_planMode == true)
+        {
+            srcPaths.clear();
+            siaPaths.clear();
+            clusterList.clear();
+        }
+
+        //Each batch is uploaded at the same time
+        if(srcPaths.count() >= Config::getUploadParallel())
+        {
+            //A failed batch stay in the journal (the next run upload again the missing clusters)
+            if(!this->deferUpload() && m_siaCom->uploadFiles(srcPaths, siaPaths))
+            {
+                foreach(t_clusterInfo uploaded, clusterList)
+                    this->releaseJournal(uploaded);
+            }
+
+            srcPaths.clear();
+            siaPaths.clear();
+            clusterList.clear();
+        }
+    }
+
+    if(!srcPaths.isEmpty())
+    {
+        if(!this->deferUpload() && m_siaCom->uploadFiles(srcPaths, siaPaths))
+        {
+            foreach(t_clusterInfo uploaded, clusterList)
+                this->releaseJournal(uploaded);
+        }
+    }
+}
+
+bool DataBase::chunkFile(ChunkBuilder *chunkBuilder, const t_IndexTable entry)
+{
+    QSqlQuery   query;
+    QByteArray  chunk;
+    t_chunkInfo chunkInfo;
+    QString     chunkHash;
+    QFile       chunkFile;
+    quint64     readBytes(0);
+    int         seq(0), newChunks(0);
+    bool        written(true);
+
+    //A dry run cut the file in chunks of the average size without reading it
+    if(m_planMode == true)
+        return this->planChunks(chunkBuilder->getAvgSize(), entry);
+
+    if(!chunkBuilder->open(entry.source))
+    {
+        qWarning(QString("Cannot read "+ entry.source).toUtf8());
+        return false;
+    }
+
+    //The rows of the file wait in the temporary tables until all its chunks are in a journaled cluster
+    m_sqlDb.transaction();
+
+    while(chunkBuilder->next(&chunk, &chunkInfo))
+    {
+        chunkHash  = chunkInfo.hash.toHex();
+        readBytes += chunkInfo.size;
+
+        //Record the position of the chunk in the file
+        query = this->execQuery(SQL_QUERY_INSERT_FILE_CHUNK(entry.source, QString::number(seq++), chunkHash, QString::number(chunkInfo.offset), QString::number(chunkInfo.size)));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+        //The chunk is already on SIA (or about to be) => nothing to upload
+        if(this->isChunkKnown(chunkHash))
+            continue;
+
+        chunkFile.setFileName(m_archiveBuilder->getChunkDir() +"/"+ chunkHash);
+
+        if(!chunkFile.open(QIODevice::WriteOnly) || (chunkFile.write(chunk) != chunk.size()))
+        {
+            chunkFile.close();
+            QFile::remove(chunkFile.fileName());
+            written = false;
+            break;
+        }
+
+        chunkFile.close();
+
+        query = this->execQuery(SQL_QUERY_INSERT_CHUNK_TEMP(chunkHash, QString::number(chunkInfo.size)));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+        newChunks++;
+    }
+
+    chunkBuilder->close();
+
+    //A read error or a file changed since its hash : the chunks don't make the file
+    if(!written || (readBytes != entry.size))
+    {
+        qWarning(QString("Cannot chunk "+ entry.source +", it is left to the next run.").toUtf8());
+
+        this->discardChunkedFile(entry.source);
+        m_sqlDb.commit();
+
+        return false;
+    }
+
+    //The file point to its chunks list (recorded with its last chunk cluster)
+    query = this->execQuery(SQL_QUERY_INSERT_CHUNKED_TEMP(entry.source, entry.hash, QString::number(entry.size)));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    //All its chunks can be known already
+    this->promoteChunkedFiles();
+
+    m_sqlDb.commit();
+
+    qInfo(QString(entry.source +" : "+ QString::number(seq) +" chunks, "+ QString::number(newChunks) +" new").toUtf8());
+
+    return true;
+}
+
+bool DataBase::planChunks(const quint32 chunkSize, const t_IndexTable entry)
+{
+    QSqlQuery   query;
+    QString     chunkHash;
+    quint64     offset(0), size;
+    int         seq(0);
+
+    m_sqlDb.transaction();
+
+    //Every chunk is seen as new (the content is unknown)
+    while(offset < entry.size)
+    {
+        size      = qMin((quint64)chunkSize, entry.size - offset);
+        chunkHash = QCryptographicHash::hash(QString(entry.source +"|"+ QString::number(seq)).toUtf8(), QCryptographicHash::Sha1).toHex();
+
+        query = this->execQuery(SQL_QUERY_INSERT_FILE_CHUNK(entry.source, QString::number(seq++), chunkHash, QString::number(offset), QString::number(size)));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+        query = this->execQuery(SQL_QUERY_INSERT_CHUNK_TEMP(chunkHash, QString::number(size)));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+        offset += size;
+    }
+
+    query = this->execQuery(SQL_QUERY_INSERT_CHUNKED_TEMP(entry.source, entry.hash, QString::number(entry.size)));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    m_sqlDb.commit();
+
+    return true;
+}
+
+void DataBase::promoteChunkedFiles(void)
+{
+    QSqlQuery query;
+
+    //The files whose chunks are all in chunk_table (journaled or uploaded) get their rows
+    query = this->execQuery(SQL_QUERY_PROMOTE_FILE_CHUNKS);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_PROMOTE_CHUNKED_FILES);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_CLEAR_PROMOTED_FILE_CHUNKS);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_CLEAR_PROMOTED_CHUNKED_FILES);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+}
+
+void DataBase::discardChunkedFile(const QString source)
+{
+    QSqlQuery query;
+
+    query = this->execQuery(SQL_QUERY_DISCARD_FILE_CHUNK_TEMP(source));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_DISCARD_CHUNKED_TEMP(source));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+}
+
+bool DataBase::isChunkKnown(const QString hash)
+{
+    QSqlQuery query;
+
+    query = this->execQuery(SQL_QUERY_IS_CHUNK_KNOWN(hash));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+    query.next();
+
+    return (query.value(0).toInt() > 0);
+}
+
+t_clusterInfo DataBase::buildChunkCluster(const QString currentDir)
+{
+    QSqlQuery       query;
+    QStringList     hashList;
+    QStringList     filesToArchive;
+    QList<quint64>  sizeList;
+    t_archiveInfo   archiveInfo;
+    t_clusterInfo   clusterInfo;
+    int             hashField, sizeField;
+    quint64         clusterSize(0), chunkSize(0);
+
+    const quint64   CLUSTER_SIZE(Config::getClusterSize());
+
+    qInfo("Selecting chunks to be in next cluster...");
+
+    query = this->execQuery(SQL_QUERY_GET_CHUNK_ORDER_BY_SIZE_DESC);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    hashField = query.record().indexOf("Hash");
+    sizeField = query.record().indexOf("Size");
+
+    //Same logic than the files list (the chunks are never bigger than a few MB)
+    while((query.next()) && (clusterSize < CLUSTER_SIZE))
+    {
+        chunkSize = query.value(sizeField).toULongLong();
+
+        if(((clusterSize + chunkSize) > CLUSTER_SIZE) && (!hashList.isEmpty()))
+            continue;
+
+        hashList        << query.value(hashField).toString();
+        sizeList        << chunkSize;
+        filesToArchive  << m_archiveBuilder->getChunkDir() +"/"+ hashList.last();
+        clusterSize     += chunkSize;
+    }
+
+    m_archiveBuilder->setWorkingDirectory(m_archiveBuilder->getChunkDir());
+
+    //Each chunk is encrypted with the key of its own hash
+    m_archiveBuilder->clearEncryptionKeys();
+    if(Config::getUseEncryption() == true)
+    {
+        for(int i(0); i < hashList.count(); i++)
+            m_archiveBuilder->setEncryptionKey(filesToArchive[i], hashList[i]);
+    }
+
+    //Archive all the chunks in cluster (a dry run only compute the size of the archive)
+    if(m_planMode == true)
+        archiveInfo = m_archiveBuilder->planTar(&filesToArchive, &sizeList, CLUSTER_SIZE);
+    else
+        archiveInfo = m_archiveBuilder->createTar("archive.tar", &filesToArchive, CLUSTER_SIZE);
+
+    //A chunk can't be archived : it is dropped, its files are chunked again at the next run (incomplete chunked files)
+    if((m_planMode == false) && archiveInfo.archiveFile.filePath().isEmpty())
+    {
+        qWarning(QString("The chunk "+ QFileInfo(m_archiveBuilder->getFailedFile()).fileName() +" is left to the next run.").toUtf8());
+
+        query = this->execQuery(SQL_QUERY_DELETE_CHUNK_TEMP(QFileInfo(m_archiveBuilder->getFailedFile()).fileName()));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+        QFile::remove(m_archiveBuilder->getFailedFile());
+
+        return clusterInfo;
+    }
+
+    //Delete from the list the remains chunks (not puted in archive according to the size limit)
+    while((quint32)filesToArchive.count() > archiveInfo.entryCount)
+    {
+        filesToArchive.takeLast();
+        hashList.takeLast();
+        sizeList.takeLast();
+    }
+
+    if(m_planMode == true)
+    {
+        clusterSize = 0;
+        foreach(quint64 size, sizeList)
+            clusterSize += size;
+
+        clusterInfo.clusterId = this->planClusterId();
+        clusterInfo.tarFile.setFile(QString(m_archiveBuilder->getTempDir() +"/"+ clusterInfo.clusterId));
+        this->planCluster(archiveInfo, clusterSize, true);
+    }
+    else
+    {
+        clusterInfo.tarFile = archiveInfo.archiveFile;
+
+        //Rename the archive with an unique name
+        clusterInfo.clusterId = this->getFileHash(clusterInfo.tarFile.absoluteFilePath()).toHex();
+        QFile::rename(clusterInfo.tarFile.absoluteFilePath(), QString(m_archiveBuilder->getTempDir() +"/"+ clusterInfo.clusterId));
+        clusterInfo.tarFile.setFile(QString(m_archiveBuilder->getTempDir() +"/"+ clusterInfo.clusterId));
+    }
+
+    //Build the target path on SIA
+    clusterInfo.targetSiaName  = m_syncData.rootDstPath;
+    clusterInfo.targetSiaName += currentDir.section(m_syncData.rootSrcPath, 1);
+    clusterInfo.targetSiaName += "/";
+    clusterInfo.targetSiaName += clusterInfo.tarFile.fileName();
+
+    //Record the chunks and remove them from the temporary list
+    m_sqlDb.transaction();
+    for(int i(0); i < hashList.count(); i++)
+    {
+        query = this->execQuery(SQL_QUERY_INSERT_CHUNK_TABLE(hashList[i], clusterInfo.clusterId, clusterInfo.targetSiaName, QString::number(sizeList[i])));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+        if(Config::getUseEncryption() == true)
+        {
+            query = this->execQuery(SQL_QUERY_SET_CHUNK_CIPHER(hashList[i], m_archiveBuilder->getCipher()));
+            qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+        }
+
+        query = this->execQuery(SQL_QUERY_DELETE_CHUNK_TEMP(hashList[i]));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+        QFile::remove(filesToArchive[i]);
+    }
+
+    //Keep the archive until SIA confirm the upload
+    this->journalCluster(&clusterInfo, JOURNAL_KIND_CHUNKS);
+
+    //The files whose last chunk is in this cluster are recorded with its journal entry
+    this->promoteChunkedFiles();
+    m_sqlDb.commit();
+
+    qInfo(QString("Chunk cluster ID : "+ clusterInfo.clusterId +", Chunks : "+ QString::number(hashList.count()) +", Size : "+ QString::number(clusterInfo.tarFile.size())).toUtf8());
+
+    return clusterInfo;
+}
+
+void DataBase::releaseChunkedFile(const QString source)
+{
+    QSqlQuery query;
+
+    query = this->execQuery(SQL_QUERY_RELEASE_FILE_INDEX(source));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_RELEASE_FILE_CHUNK(source));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+}
+
+void DataBase::collectGarbage(void)
+{
+    QSqlQuery   query;
+    QStringList clusterList;
+    QStringList targetList;
+    int         clusterField, targetField;
+
+    qInfo("Sync : Looking for unused chunk clusters...");
+
+    //Chunks list of files which are no more in the index
+    query = this->execQuery(SQL_QUERY_DELETE_ORPHAN_FILE_CHUNK);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    //A chunk cluster is deleted only when none of its chunks is used
+    query = this->execQuery(SQL_QUERY_LOOK_FOR_UNUSED_CHUNK_CLUSTER);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    clusterField = query.record().indexOf("Cluster");
+    targetField  = query.record().indexOf("Target");
+
+    while(query.next())
+    {
+        clusterList << query.value(clusterField).toString();
+        targetList  << query.value(targetField).toString();
+    }
+
+    for(int i(0); i < clusterList.count(); i++)
+    {
+        query = this->execQuery(SQL_QUERY_DELETE_CHUNK_CLUSTER(clusterList[i]));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+        //Delete target on SIA (later, in batch), a cluster still in the journal is not there
+        if(this->dropJournal(clusterList[i]))
+            this->queueDelete(targetList[i]);
+    }
+
+    qInfo(QString("Sync : Result "+ QString::number(clusterList.count()) +" chunk clusters removed from SIA.").toUtf8());
+
+    //The cached hashes of the files which are no more in the index
+    query = this->execQuery(SQL_QUERY_DELETE_ORPHAN_HASH_CACHE);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    //The run is complete, the next one reads every file again (the hashes are only kept for the estimates)
+    query = this->execQuery(SQL_QUERY_CLOSE_HASH_CACHE);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    //At the end of the run the changed files are indexed again, the change frequencies left are the ones of deleted files
+    query = this->execQuery(SQL_QUERY_DELETE_ORPHAN_CHURN);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+}
+
+void DataBase::buildClusterFilesList(const QString currentDir, ClusterCandidates *outCandidates)
+{
+    QSqlQuery       query;
+    int             sourceField(0), sizeField(0), hashField(0), hotField(0), compressionField(0);
+    int             counter(0);
+    quint64         clusterSize(0), fileSize(0);
+    QFileInfo       zipFile;
+    QString         source;
+    QString         compression;
+    QStringList     probedSources, probedCompressions;
+    QString         workingDir;
+    QString         hot("0");
+    bool            hotCluster(false);
+    StageTimer      stageTimer(Stage::PACK);
+
+    //The entry names are absolute when the clusters are shared by several roots
+    m_archiveBuilder->setWorkingDirectory(m_sharedRoots ? QString() : currentDir);
+    workingDir = m_archiveBuilder->workingDirectory();
+
+    //In solid mode the cluster holds the bytes which give a full cluster once compressed
+    const quint64 CLUSTER_SIZE(this->getPackingLimit());
+
+    qInfo("Selecting files to be in nesxt cluster...");
+
+    outCandidates->clear();
+
+    //The files which change often are not mixed with the others (a change upload again only a hot cluster)
+    if(Config::getHotChanges() > 0)
+        hot = SQL_HOT_EXPRESSION(QString::number(Config::getHotChanges()), QString::number(QDateTime::currentDateTime().toMSecsSinceEpoch() / 1000 - Config::getHotDays() * 86400));
+
+    //Order by size the temp list (facilities to build one cluster) or by path (the files of a directory stay together)
+    if(Config::getPackingPolicy() == PackingPolicy::LOCALITY)
+        query = this->execQuery(SQL_QUERY_GET_SRC_ORDER_BY_PATH(hot));
+    else
+        query = this->execQuery(SQL_QUERY_GET_SRC_ORDER_BY_SIZE_DESC(hot));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    sourceField  = query.record().indexOf("Source");
+    sizeField    = query.record().indexOf("Size");
+    hashField    = query.record().indexOf("Hash");
+    hotField     = query.record().indexOf("Hot");
+    compressionField = query.record().indexOf("Compression");
+
+    //In this section I don't unite all the features in one to keep the code readable
+
+    //If compression feature is enabled (a dry run doesn't compress)
+    if((Config::getUseCompression() == true) && (m_planMode == false))
+    {
+        qInfo("Creating mirror directory in compression mode... (can take a will)");
+
+        //Read the file list in packing order, the files which don't fit are skipped to converge to the max cluster size
+        while((query.next()) && (clusterSize < CLUSTER_SIZE))
+        {
+            //The hot files come first, the cluster only holds the files of its first file temperature
+            if(outCandidates->isEmpty())
+                hotCluster = query.value(hotField).toBool();
+            else if(query.value(hotField).toBool() != hotCluster)
+                break;
+
+            //The decision of a file already packed is kept (files of a merged cluster), the others are probed
+            source      = query.value(sourceField).toString();
+            compression = query.value(compressionField).toString();
+
+            if(compression.isEmpty() || (compression == COMPRESSION_NONE))
+            {
+                compression = m_compressionPolicy->decide(source);
+
+                probedSources      << source;
+                probedCompressions << compression;
+            }
+
+            //A file stored as-is has a known size, it is only linked in the mirror if it fits
+            if(compression == COMPRESSION_STORE)
+            {
+                fileSize = query.value(sizeField).toULongLong();
+
+                if(((clusterSize + fileSize) > CLUSTER_SIZE) && (!outCandidates->isEmpty()))
+                    continue;
+
+                zipFile = m_archiveBuilder->createStored(source);
+            }
+            //Create the temporary mirror "ZIP_DIR" and compress the copy files
+            else
+                zipFile = m_archiveBuilder->createZIP(source);
+
+            fileSize = zipFile.size();//Get the size of current pointed file
+
+            //Check if the the file can be puted in the cluster without exceed is max size (expect if the file is alone)
+            if(((clusterSize + fileSize) > CLUSTER_SIZE) && (!outCandidates->isEmpty()))
+            {
+                //If the file is finally not is the list => delete it
+                QFile::remove(zipFile.absoluteFilePath());
+
+                //Record each false positive in this counter
+                counter++;
+
+                //Try again
+                continue;
+            }
+
+            //Compress files take huge amount of time, so the building list is canceled if no significant progress occure
+            if(counter >= MAX_FALSE_POSITIVE_IN_COMPRESION)
+                break;
+
+            //Record the current file in cluster (the archived file is the zipped copy or the link to the stored file)
+            outCandidates->append(source,
+                                  zipFile.absoluteFilePath().section(m_archiveBuilder->getMirrorDir(), 1).mid(1),
+                                  query.value(hashField).toString(),
+                                  fileSize);
+            outCandidates->setStored(outCandidates->count() - 1, (compression == COMPRESSION_STORE));
+            //Update the size of current cluster
+            clusterSize += fileSize;
+        }
+
+        query.finish();
+
+        //A file which doesn't fit is not probed again at the next passes
+        m_sqlDb.transaction();
+
+        for(int i(0); i < probedSources.count(); i++)
+        {
+            query = this->execQuery(SQL_QUERY_SET_TEMP_COMPRESSION(probedSources[i], probedCompressions[i]));
+            qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+        }
+
+        m_sqlDb.commit();
+    }
+    else
+    {
+        //Read the file list in packing order, the files which don't fit are skipped to converge to the max cluster size
+        while((query.next()) && (clusterSize < CLUSTER_SIZE))
+        {
+            //The hot files come first, the cluster only holds the files of its first file temperature
+            if(outCandidates->isEmpty())
+                hotCluster = query.value(hotField).toBool();
+            else if(query.value(hotField).toBool() != hotCluster)
+                break;
+
+            //Get the size of current pointed file
+            fileSize = query.value(sizeField).toULongLong();
+
+            //Check if the the file can be puted in the cluster without exceed is max size (expect if the file is alone)
+            if(((clusterSize + fileSize) > CLUSTER_SIZE) && (!outCandidates->isEmpty()))
+                continue;
+
+            //Record the current file in cluster
+            source = query.value(sourceField).toString();
+
+            //The entry name is the end of the source (relative to the working directory), no string is built for it
+            if((!workingDir.isEmpty()) && (source.length() > workingDir.length() + 1) && source.startsWith(workingDir) && (source.at(workingDir.length()) == '/'))
+                outCandidates->append(source, workingDir.length() + 1, query.value(hashField).toString(), fileSize);
+            else
+                outCandidates->append(source, m_archiveBuilder->getEntryName(source), query.value(hashField).toString(), fileSize);
+            //Update the size of current cluster
+            clusterSize += fileSize;
+        }
+    }
+
+    if(hotCluster == true)
+        qInfo("Result : %d possibles files in next hot cluster", outCandidates->count());
+    else
+        qInfo("Result : %d possibles files in next cluster", outCandidates->count());
+
+    Metrics::add(Stage::PACK, outCandidates->count(), clusterSize);
+}
+
+t_clusterInfo DataBase::makeClusterFile(const QString currentDir, ClusterCandidates *candidates)
+{
+    QSqlQuery       query;
+    int             failedIndex;
+    t_archiveInfo   archiveInfo;
+    t_clusterInfo   clusterInfo;
+    QStringList     filesToArchive;
+    QList<quint64>  sizeList;
+
+    const quint64   CLUSTER_SIZE(Config::getClusterSize());
+
+    m_archiveBuilder->setWorkingDirectory(m_sharedRoots ? QString() : currentDir);
+
+    //In compression mode the zipped file is stored in the temporary mirror "ZIP_DIR" (a dry run doesn't compress)
+    if((Config::getUseCompression() == true) && (m_planMode == false))
+    {
+        m_archiveBuilder->setWorkingDirectory(m_archiveBuilder->getMirrorDir());
+        filesToArchive = candidates->archivePaths(m_archiveBuilder->getMirrorDir());
+    }
+    else
+        filesToArchive = candidates->archivePaths(QString());
+
+    //Each file is encrypted with the key of its own hash
+    m_archiveBuilder->clearEncryptionKeys();
+    if(Config::getUseEncryption() == true)
+    {
+        for(int i(0); i < candidates->count(); i++)
+            m_archiveBuilder->setEncryptionKey(filesToArchive[i], candidates->hash(i));
+    }
+
+    //Archive all the files in cluster
+    if(m_planMode == true)
+    {
+        //A dry run only compute the layout of the archive
+        for(int i(0); i < candidates->count(); i++)
+            sizeList << candidates->size(i);
+
+        archiveInfo = m_archiveBuilder->planTar(&filesToArchive, &sizeList, CLUSTER_SIZE);
+    }
+    else if(Config::getSolidCompression() == true)
+        archiveInfo = this->createSolidTar(&filesToArchive);
+    else
+        archiveInfo = m_archiveBuilder->createTar("archive.tar", &filesToArchive, CLUSTER_SIZE);
+
+    //A file can't be archived (unreadable, changed or not encrypted) : it is left to the next run, no cluster
+    if((m_planMode == false) && archiveInfo.archiveFile.filePath().isEmpty())
+    {
+        failedIndex = qMax(filesToArchive.indexOf(m_archiveBuilder->getFailedFile()), 0);
+
+        qWarning(QString("The file "+ candidates->source(failedIndex) +" is left to the next run.").toUtf8());
+
+        query = this->execQuery(SQL_QUERY_DELETE_TEMP_SOURCE(candidates->source(failedIndex)));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+        return clusterInfo;
+    }
+
+    //Delete from the list the remains files (not puted in archive according to the size limit)
+    while((quint32)candidates->count() > archiveInfo.entryCount)
+        candidates->removeLast();
+
+    //The entries are in the same order than the members of the archive
+    for(int i(0); i < candidates->count(); i++)
+        candidates->setOffsets(i, archiveInfo.memberOffsets.value(i));
+
+    if(m_planMode == true)
+    {
+        clusterInfo.clusterId = this->planClusterId();
+        clusterInfo.tarFile.setFile(QString(m_archiveBuilder->getTempDir() +"/"+ clusterInfo.clusterId));
+        this->planCluster(archiveInfo, candidates->totalSize(), false);
+
+        return clusterInfo;
+    }
+
+    clusterInfo.tarFile = archiveInfo.archiveFile;
+
+    //Rename the archive with an unique name (a solid cluster keep its suffix, the restore uncompress it)
+    clusterInfo.clusterId = this->getFileHash(clusterInfo.tarFile.absoluteFilePath()).toHex();
+
+    if(clusterInfo.tarFile.fileName().endsWith(SOLID_SUFFIX))
+        clusterInfo.clusterId += SOLID_SUFFIX;
+
+    QFile::rename(clusterInfo.tarFile.absoluteFilePath(), QString(m_archiveBuilder->getTempDir() +"/"+ clusterInfo.clusterId));
+    clusterInfo.tarFile.setFile(QString(m_archiveBuilder->getTempDir() +"/"+ clusterInfo.clusterId));
+
+    return clusterInfo;
+}
+
+quint64 DataBase::getPackingLimit(void)
+{
+    double          ratio(SOLID_FIRST_RATIO);
+    quint64         limit;
+
+    const quint64   CLUSTER_SIZE(Config::getClusterSize());
+
+    //A dry run doesn't compress, its clusters are the ones of the tar
+    if((Config::getSolidCompression() == false) || (m_planMode == true))
+        return CLUSTER_SIZE;
+
+    //Compressed bytes for one byte of tar in the clusters of this run
+    if(m_solidInBytes > 0)
+        ratio = (double)m_solidOutBytes / (double)m_solidInBytes;
+
+    limit = (quint64)((double)CLUSTER_SIZE / (qMax(ratio, 0.0001) * SOLID_RATIO_MARGIN));
+
+    return qMin(limit, CLUSTER_SIZE * SOLID_MAX_EXPANSION);
+}
+
+t_archiveInfo DataBase::createSolidTar(const QStringList *srcFiles)
+{
+    t_archiveInfo   archiveInfo;
+    QString         tarPath, solidPath;
+    quint64         limit(this->getPackingLimit());
+    quint64         solidSize(0);
+
+    const quint64   CLUSTER_SIZE(Config::getClusterSize());
+
+    for(int attempt(1); attempt <= SOLID_MAX_ATTEMPTS; attempt++)
+    {
+        archiveInfo = m_archiveBuilder->createTar("archive.tar", srcFiles, limit);
+        tarPath     = archiveInfo.archiveFile.absoluteFilePath();
+
+        if(archiveInfo.archiveFile.filePath().isEmpty())
+            return archiveInfo;
+        solidPath   = tarPath + SOLID_SUFFIX;
+
+        //The cluster is still valid without compression (a tar of the normal size)
+        if(!SolidCompressor::compress(tarPath, solidPath, Config::getZstdLevel(), Config::getZstdWorkers()))
+        {
+            qWarning("Cannot compress the cluster, it is sent without compression.");
+            QFile::remove(tarPath);
+
+            return m_archiveBuilder->createTar("archive.tar", srcFiles, CLUSTER_SIZE);
+        }
+
+        solidSize = QFileInfo(solidPath).size();
+
+        //The ratio of this cluster is used to fill the next ones
+        m_solidInBytes  += archiveInfo.archiveSize;
+        m_solidOutBytes += solidSize;
+
+        //A lone file can't be split, the last attempt is kept even a bit too big
+        if((solidSize <= CLUSTER_SIZE) || (archiveInfo.entryCount <= 1) || (attempt == SOLID_MAX_ATTEMPTS))
+            break;
+
+        //The files of this cluster compress less than the previous ones, the tar is built again with less bytes
+        qInfo(QString("Solid cluster too big ("+ QString::number(solidSize) +" bytes), building it again with less files...").toUtf8());
+
+        QFile::remove(solidPath);
+        limit = (quint64)((double)archiveInfo.archiveSize * CLUSTER_SIZE / solidSize / SOLID_RATIO_MARGIN);
+    }
+
+    QFile::remove(tarPath);
+
+    qInfo(QString("Solid cluster : "+ QString::number(archiveInfo.archiveSize) +" bytes compressed to "+ QString::number(solidSize) +" bytes").toUtf8());
+
+    archiveInfo.archiveFile.setFile(solidPath);
+    archiveInfo.archiveSize = solidSize;
+
+    //The members are only in the compressed stream, they can't be read by ranges
+    for(int i(0); i < archiveInfo.memberOffsets.count(); i++)
+    {
+        archiveInfo.memberOffsets[i].headerOffset = -1;
+        archiveInfo.memberOffsets[i].dataOffset   = -1;
+    }
+
+    return archiveInfo;
+}
+
+void DataBase::resetTemporaryTable(void)
+{
+    QSqlQuery   query;
+
+    query = this->execQuery(SQL_QUERY_DROP_TABLE_TEMP);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+    query = this->execQuery(SQL_QUERY_CREATE_TABLE_TEMP);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+}
+
+QLinkedList<t_IndexTable> DataBase::lookForDeletedFiles(const QString dir)
+{
+    QLinkedList<t_IndexTable> list;
+    t_IndexTable     entry;
+    QSqlQuery        query;
+    int              targetField, clusterField, sourceField, memberField, sizeField;
+
+    if(Config::getBackupMode() == BackupMode::SEPARTE_BY_DIR)
+    {
+        //Search for new file in temp_table point view (not recursive)
+        query = this->execQuery(SQL_QUERY_LOOK_FOR_DELETE(dir));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+    }
+    else if(Config::getBackupMode() == BackupMode::RECURSIVE)
+    {
+        //Search for new file in temp_table point view (recursive)
+        query = this->execQuery(SQL_QUERY_LOOK_FOR_DELETE_RECURSIVE(dir));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+    }
+
+    //Find row number
+    targetField  = query.record().indexOf("Target");
+    clusterField = query.record().indexOf("Cluster");
+    sourceField  = query.record().indexOf("Source");
+    memberField  = query.record().indexOf("Member");
+    sizeField    = query.record().indexOf("Size");
+
+    //Delete from both SIA and database the entry
+    while(query.next())
+    {
+        entry.target  = query.value(targetField).toString();
+        entry.cluster = query.value(clusterField).toString();
+        entry.source  = query.value(sourceField).toString();
+        entry.member  = query.value(memberField).toString();
+        entry.size    = query.value(sizeField).toULongLong();
+
+        list << entry;
+    }
+
+    return list;
+}
+
+bool DataBase::restoreFiles(const QString prefix, const QString outputDir)
+{
+    RestoreEngine restoreEngine(m_siaCom);
+
+    qInfo(QString("Restore : Looking for the files under "+ prefix +"...").toUtf8());
+
+    return restoreEngine.restore(this->lookForRestoreFiles(prefix), prefix, outputDir);
+}
+
+QList<t_restoreEntry> DataBase::lookForRestoreFiles(const QString prefix)
+{
+    QSqlQuery               query;
+    QList<t_restoreEntry>   list;
+    t_restoreEntry          entry;
+    int                     clusterField, targetField, sourceField, memberField, offsetField, sizeField, dataOffsetField, dataLengthField, hashField, cipherField, compressionField;
+
+    //The whole files and the chunks of the big files, ordered by cluster (one indexed query)
+    query = this->execQuery(SQL_QUERY_LOOK_FOR_RESTORE(prefix));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    //Find row number
+    clusterField = query.record().indexOf("Cluster");
+    targetField  = query.record().indexOf("Target");
+    sourceField  = query.record().indexOf("Source");
+    memberField  = query.record().indexOf("Member");
+    offsetField  = query.record().indexOf("Offset");
+    sizeField    = query.record().indexOf("Size");
+    dataOffsetField = query.record().indexOf("DataOffset");
+    dataLengthField = query.record().indexOf("DataLength");
+    hashField    = query.record().indexOf("Hash");
+    cipherField  = query.record().indexOf("Cipher");
+    compressionField = query.record().indexOf("Compression");
+
+    while(query.next())
+    {
+        entry.cluster = query.value(clusterField).toString();
+        entry.target  = query.value(targetField).toString();
+        entry.source  = query.value(sourceField).toString();
+        entry.member  = query.value(memberField).toString();
+        entry.offset  = query.value(offsetField).toLongLong();
+        entry.size    = query.value(sizeField).toULongLong();
+
+        //Index made by an older version => the position of the member is unknown
+        entry.dataOffset = query.value(dataOffsetField).isNull() ? -1 : query.value(dataOffsetField).toLongLong();
+        entry.dataLength = query.value(dataLengthField).toULongLong();
+        entry.hash       = query.value(hashField).toString();
+        entry.cipher     = query.value(cipherField).toString();
+        entry.compression = query.value(compressionField).toString();
+
+        list << entry;
+    }
+
+    return list;
+}
+
+QLinkedList<t_IndexTable> DataBase::lookForChangedFiles(const QString dir)
+{
+    QLinkedList<t_IndexTable> list;
+    t_IndexTable     entry;
+    QSqlQuery        query;
+    int              targetField, clusterField, sourceField, memberField, sizeField;
+
+    if(Config::getBackupMode() == BackupMode::SEPARTE_BY_DIR)
+    {
+        //Search for new file in temp_table point view (not recursive)
+        query = this->execQuery(SQL_QUERY_LOOK_FOR_CHANGE(dir));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+    }
+    else if(Config::getBackupMode() == BackupMode::RECURSIVE)
+    {
+        //Search for new file in temp_table point view (recursive)
+        query = this->execQuery(SQL_QUERY_LOOK_FOR_CHANGE_RECURSIVE(dir));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+    }
+
+    //Find row number
+    targetField  = query.record().indexOf("Target");
+    clusterField = query.record().indexOf("Cluster");
+    sourceField  = query.record().indexOf("Source");
+    memberField  = query.record().indexOf("Member");
+    sizeField    = query.record().indexOf("Size");
+
+    //Delete from both SIA and database the entry
+    while(query.next())
+    {
+        entry.target  = query.value(targetField).toString();
+        entry.cluster = query.value(clusterField).toString();
+        entry.source  = query.value(sourceField).toString();
+        entry.member  = query.value(memberField).toString();
+        entry.size    = query.value(sizeField).toULongLong();
+
+        list << entry;
+    }
+
+    return list;
+}
+
+bool DataBase::deleteCluster(const QString cluster)
+{
+    QSqlQuery query;
+
+    //The live files of a merged cluster are packed again with their change frequency
+    query = this->execQuery(SQL_QUERY_KEEP_CLUSTER_CHURN(cluster));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_DELETE_CLUSTER_DB(cluster));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_DELETE_CLUSTER_TABLE(cluster));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    //A cluster waiting in the journal is never uploaded
+    return this->dropJournal(cluster);
+}
+
+void DataBase::tombstoneFile(const t_IndexTable entry)
+{
+    QSqlQuery query;
+
+    //Remove the file from the index, its member stays in the cluster until it is compacted
+    query = this->execQuery(SQL_QUERY_RELEASE_FILE_INDEX(entry.source));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    //A member referenced by a duplicate is still alive
+    query = this->execQuery(SQL_QUERY_REFRESH_CLUSTER_LIVE_SIZE(entry.cluster));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    query = this->execQuery(SQL_QUERY_GET_CLUSTER_LIVE_SIZE(entry.cluster));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
 
-    qInfo("Selecting files to be in nesxt cluster...");
+    //Nothing alive in the cluster => delete it
+    if(query.next() && (query.value(0).toULongLong() == 0))
+    {
+        if(this->deleteCluster(entry.cluster))
+            this->queueDelete(entry.target);
+    }
+}
+
+void DataBase::compactProcedure(const QString currentDir)
+{
+    QSqlQuery   query;
+    QStringList clusterList;
+    QStringList targetList;
+    int         clusterField, targetField;
+    const QString RATIO(QString::number(Config::getCompactionRatio()));
+
+    qInfo("Sync : Looking for clusters to compact...");
+
+    if(Config::getBackupMode() == BackupMode::SEPARTE_BY_DIR)
+    {
+        //Clusters of this directory (not recursive)
+        query = this->execQuery(SQL_QUERY_LOOK_FOR_COMPACTION(currentDir, RATIO));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+    }
+    else if(Config::getBackupMode() == BackupMode::RECURSIVE)
+    {
+        //Clusters of this directory (recursive)
+        query = this->execQuery(SQL_QUERY_LOOK_FOR_COMPACTION_RECURSIVE(currentDir, RATIO));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+    }
+
+    clusterField = query.record().indexOf("Cluster");
+    targetField  = query.record().indexOf("Target");
+
+    while(query.next())
+    {
+        clusterList << query.value(clusterField).toString();
+        targetList  << query.value(targetField).toString();
+    }
 
-    //Order by size the temp list (facilities to build one cluster)
-    query = m_sqlDb.exec(SQL_QUERY_GET_SRC_ORDER_BY_SIZE_DESC);
+    for(int i(0); i < clusterList.count(); i++)
+        this->evictCluster(clusterList[i], targetList[i]);
+
+    qInfo(QString("Sync : Result "+ QString::number(clusterList.count()) +" clusters to pack again.").toUtf8());
+}
+
+void DataBase::evictCluster(const QString cluster, const QString target)
+{
+    QSqlQuery query;
+
+    //Copy the live files of the cluster to temp_table (they will be in the next clusters)
+    query = this->execQuery(SQL_QUERY_COPY_CLUSTER_TO_TEMP_TABLE(cluster));
     qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
 
-    sourceField  = query.record().indexOf("Source");
-    sizeField    = query.record().indexOf("Size");
-    hashField    = query.record().indexOf("Hash");
+    //Remove the cluster from database, delete on SIA (later, in batch) if it was uploaded
+    if(this->deleteCluster(cluster))
+        this->queueDelete(target);
+}
 
-    //In this section I don't unite all the features in one to keep the code readable
+void DataBase::queueDelete(const QString target)
+{
+    QSqlQuery query;
+
+    //Duplicated targets are ignored (the same cluster can be pointed by several entries)
+    query = this->execQuery(SQL_QUERY_QUEUE_DELETE(target));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+}
+
+void DataBase::flushDeleteQueue(void)
+{
+    QSqlQuery   query;
+    QStringList pendingList;
+    QStringList doneList;
+    int         targetField;
+
+    query = this->execQuery(SQL_QUERY_GET_PENDING_DELETE);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    targetField = query.record().indexOf("Target");
+
+    while(query.next())
+        pendingList << query.value(targetField).toString();
 
-    //If compression feature is enabled
-    if(Config::getUseCompression() == true)
+    if(pendingList.isEmpty())
+        return;
+
+    //A dry run keep the deletes in the queue of the snapshot (counted at the end)
+    if(m_planMode == true)
+        return;
+
+    qInfo(QString("Sync : Deleting "+ QString::number(pendingList.count()) +" clusters from SIA...").toUtf8());
+
+    //Send all the deletes to SIA (several requests in flight)
+    doneList = m_siaCom->deleteFiles(pendingList);
+
+    //Only the confirmed deletes leave the queue, the others will be retried at the next flush
+    m_sqlDb.transaction();
+    foreach(QString target, doneList)
     {
-        qInfo("Creating mirror directory in compression mode... (can take a will)");
+        query = this->execQuery(SQL_QUERY_UNQUEUE_DELETE(target));
+        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+    }
+    m_sqlDb.commit();
 
-        //Read the file list in size order to converge to the max cluster size
-        while((query.next()) && (clusterSize < CLUSTER_SIZE))
-        {
-            //Create the temporary mirror "ZIP_DIR" and compress the copy files
-            zipFile  = m_archiveBuilder->createZIP(query.value(sourceField).toString());
-            fileSize = zipFile.size();//Get the size of current pointed file
+    qInfo(QString("Sync : Result "+ QString::number(doneList.count()) +"/"+ QString::number(pendingList.count()) +" clusters deleted from SIA.").toUtf8());
+}
 
-            //Check if the the file can be puted in the cluster without exceed is max size (expect if the file is alone)
-            if(((clusterSize + fileSize) > CLUSTER_SIZE) && (!outDataList->isEmpty()))
-            {
-                //If the file is finally not is the list => delete it
-                QFile::remove(zipFile.absoluteFilePath());
+void DataBase::journalCluster(t_clusterInfo *clusterInfo, const int kind)
+{
+    QSqlQuery query;
+    QString   journalPath(Config::getJournalPath() +"/"+ clusterInfo->clusterId);
 
-                //Record each false positive in this counter
-                counter++;
+    //A cluster built again with the same content has the same target : a delete still queued for it would remove the new upload
+    query = this->execQuery(SQL_QUERY_UNQUEUE_DELETE(clusterInfo->targetSiaName));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
 
-                //Try again
-                continue;
-            }
+    //No archive in a dry run
+    if(m_planMode == true)
+        return;
 
-            //Compress files take huge amount of time, so the building list is canceled if no significant progress occure
-            if(counter >= MAX_FALSE_POSITIVE_IN_COMPRESION)
-                break;
+    //The work dir is in the journal dir, the rename doesn't copy the archive
+    QFile::remove(journalPath);
+    if(!QFile::rename(clusterInfo->tarFile.absoluteFilePath(), journalPath))
+    {
+        QFile::copy(clusterInfo->tarFile.absoluteFilePath(), journalPath);
+        QFile::remove(clusterInfo->tarFile.absoluteFilePath());
+    }
 
-            //Record the current file in cluster
-            clusterEntry            =  new t_IndexTable;
-            clusterEntry->size      =  fileSize;
-            clusterEntry->source    =  query.value(sourceField).toString();
-            clusterEntry->hash      =  query.value(hashField).toString();
-            (*outDataList)          << clusterEntry;
-            //Update the size of current cluster
-            clusterSize             += fileSize;
-            //Record the file to archive in string list
-            (*outStrList)           << zipFile.absoluteFilePath();
-        }
+    clusterInfo->tarFile.setFile(journalPath);
+
+    query = this->execQuery(SQL_QUERY_INSERT_JOURNAL(clusterInfo->clusterId, clusterInfo->targetSiaName, journalPath, QString::number(kind)));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+}
+
+void DataBase::releaseJournal(const t_clusterInfo clusterInfo)
+{
+    QSqlQuery query;
+
+    if(m_planMode == true)
+        return;
+
+    query = this->execQuery(SQL_QUERY_DELETE_JOURNAL(clusterInfo.clusterId));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    QFile::remove(clusterInfo.tarFile.absoluteFilePath());
+}
+
+bool DataBase::dropJournal(const QString cluster)
+{
+    QSqlQuery   query;
+    QString     path;
+
+    query = this->execQuery(SQL_QUERY_GET_JOURNAL_CLUSTER(cluster));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    //Not in the journal => uploaded
+    if(!query.next())
+        return true;
+
+    path = query.value(query.record().indexOf("Path")).toString();
+
+    query = this->execQuery(SQL_QUERY_DELETE_JOURNAL(cluster));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    //The archive of a dry run is the one of the real journal
+    if(m_planMode == true)
+        return false;
+
+    QFile::remove(path);
+
+    //A failed upload can have left the cluster on SIA (the delete of an unknown file succeeds)
+    return true;
+}
+
+void DataBase::resumeJournal(void)
+{
+    QSqlQuery               query;
+    QList<t_clusterInfo>    clusterList;
+    QList<int>              kindList;
+    t_clusterInfo           clusterInfo;
+    t_UploadStatus          uploadStatus;
+    QStringList             sourceList;
+    int                     clusterField, targetField, pathField, kindField;
+    int                     resumed(0), rollbacked(0), waiting(0);
+
+    //The unfinished work is uploaded by the next real run
+    if(m_planMode == true)
+        return;
+
+    qInfo("Resume : Looking for the unfinished work of the last run...");
+
+    //The deletes queued by the last run
+    this->flushDeleteQueue();
+
+    query = this->execQuery(SQL_QUERY_GET_JOURNAL);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    clusterField = query.record().indexOf("Cluster");
+    targetField  = query.record().indexOf("Target");
+    pathField    = query.record().indexOf("Path");
+    kindField    = query.record().indexOf("Kind");
+
+    while(query.next())
+    {
+        clusterInfo.clusterId     = query.value(clusterField).toString();
+        clusterInfo.targetSiaName = query.value(targetField).toString();
+        clusterInfo.tarFile.setFile(query.value(pathField).toString());
+
+        clusterList << clusterInfo;
+        kindList    << query.value(kindField).toInt();
     }
-    else
+
+    for(int i(0); i < clusterList.count(); i++)
     {
-        //Read the file list in size order to converge to the max cluster size
-        while((query.next()) && (clusterSize < CLUSTER_SIZE))
+        uploadStatus = m_siaCom->uploadFileState(clusterList[i].targetSiaName);
+
+        //The upload was finished by SIA after the stop
+        if((uploadStatus.inUploading == false) && (uploadStatus.isUploaded == true))
         {
-            //Get the size of current pointed file
-            fileSize = query.value(sizeField).toULongLong();
+            this->releaseJournal(clusterList[i]);
+            resumed++;
+        }
+        //Outside of the upload windows the archive keeps waiting (the build of this run goes on)
+        else if(clusterList[i].tarFile.exists() && !m_siaCom->isUploadWindowOpen())
+            waiting++;
+        //The archive is still here, only the upload is done again
+        else if(clusterList[i].tarFile.exists() && m_siaCom->uploadFile(clusterList[i].tarFile.absoluteFilePath(), clusterList[i].targetSiaName))
+        {
+            this->releaseJournal(clusterList[i]);
+            resumed++;
+        }
+        //The archive is lost, its files will be in the clusters of this run
+        else if(!clusterList[i].tarFile.exists())
+        {
+            this->rollbackCluster(clusterList[i].clusterId, clusterList[i].targetSiaName, kindList[i]);
 
-            //Check if the the file can be puted in the cluster without exceed is max size (expect if the file is alone)
-            if(((clusterSize + fileSize) > CLUSTER_SIZE) && (!outDataList->isEmpty()))
-                continue;
+            //A part of the cluster can be on SIA (the delete of an unknown file succeeds)
+            this->queueDelete(clusterList[i].targetSiaName);
 
-            //Record the current file in cluster
-            clusterEntry            =  new t_IndexTable;
-            clusterEntry->size      =  fileSize;
-            clusterEntry->source    =  query.value(sourceField).toString();
-            clusterEntry->hash      =  query.value(hashField).toString();
-            (*outDataList)          << clusterEntry;
-            //Update the size of current cluster
-            clusterSize             += fileSize;
-            //Record the file to archive in string list
-            (*outStrList)           << clusterEntry->source;
+            rollbacked++;
         }
     }
 
-    qInfo("Result : %d possibles files in next cluster", outStrList->count());
+    //The chunked files whose chunks never reached a cluster are chunked again
+    query = this->execQuery(SQL_QUERY_LOOK_FOR_INCOMPLETE_CHUNKED_FILES);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    while(query.next())
+        sourceList << query.value(0).toString();
+
+    m_sqlDb.transaction();
+    foreach(QString source, sourceList)
+        this->releaseChunkedFile(source);
+    m_sqlDb.commit();
+
+    this->cleanJournalDir();
+
+    qInfo(QString("Resume : Result "+ QString::number(resumed) +" clusters uploaded, "+ QString::number(waiting) +" waiting for the upload window, "+ QString::number(rollbacked + sourceList.count()) +" entries to build again.").toUtf8());
 }
 
-t_clusterInfo DataBase::makeClusterFile(const QString currentDir, QLinkedList<t_IndexTable *> *inDataList, QStringList *inStrList)
+void DataBase::drainJournal(void)
 {
-    t_archiveInfo   archiveInfo;
-    t_clusterInfo   clusterInfo;
+    QSqlQuery               query;
+    QList<t_clusterInfo>    clusterList;
+    t_clusterInfo           clusterInfo;
+    QStringList             srcPaths;
+    QStringList             siaPaths;
 
-    const quint64   CLUSTER_SIZE(Config::getClusterSize());
+    if(m_planMode == true)
+        return;
+
+    query = this->execQuery(SQL_QUERY_GET_JOURNAL);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
 
-    m_archiveBuilder->setWorkingDirectory(currentDir);
+    while(query.next())
+    {
+        clusterInfo.clusterId     = query.value(query.record().indexOf("Cluster")).toString();
+        clusterInfo.targetSiaName = query.value(query.record().indexOf("Target")).toString();
+        clusterInfo.tarFile.setFile(query.value(query.record().indexOf("Path")).toString());
 
-    //In compression mode the zipped file is stored in the temporary mirror "ZIP_DIR"
-    if(Config::getUseCompression() == true)
-        m_archiveBuilder->setWorkingDirectory(m_archiveBuilder->getMirrorDir());
+        if(!clusterInfo.tarFile.exists())
+            continue;
 
-    //Archive all the files in cluster
-    archiveInfo = m_archiveBuilder->createTar("archive.tar", inStrList, CLUSTER_SIZE);
+        clusterList << clusterInfo;
+        srcPaths    << clusterInfo.tarFile.absoluteFilePath();
+        siaPaths    << clusterInfo.targetSiaName;
+    }
 
-    //Delete from the list the remains files (not puted in archive according to the size limit)
-    while((quint32)inStrList->count() > archiveInfo.entryCount)
+    if(clusterList.isEmpty())
+        return;
+
+    qInfo(QString("Upload : "+ QString::number(clusterList.count()) +" clusters wait in the journal").toUtf8());
+
+    //The clusters kept while the uploads were paused are sent together (a failed batch stay in the journal for the next run)
+    if(m_siaCom->uploadFiles(srcPaths, siaPaths))
     {
-        inStrList->takeLast();
-        delete inDataList->takeLast();
+        foreach(t_clusterInfo uploaded, clusterList)
+            this->releaseJournal(uploaded);
     }
+}
 
-    clusterInfo.tarFile = archiveInfo.archiveFile;
+void DataBase::restoreUploadRate(void)
+{
+    m_siaCom->restoreUploadRate();
+}
 
-    //Rename the archive with an unique name
-    clusterInfo.clusterId = this->getFileHash(clusterInfo.tarFile.absoluteFilePath()).toHex();
-    QFile::rename(clusterInfo.tarFile.absoluteFilePath(), QString(m_archiveBuilder->getTempDir() +"/"+ clusterInfo.clusterId));
-    clusterInfo.tarFile.setFile(QString(m_archiveBuilder->getTempDir() +"/"+ clusterInfo.clusterId));
+bool DataBase::deferUpload(void)
+{
+    //The build goes on while the waiting clusters fit in the backlog, then the upload waits the next window
+    if(m_siaCom->isUploadWindowOpen() || (this->getJournalBytes() > Config::getUploadBacklog()))
+        return false;
 
-    return clusterInfo;
+    qInfo("Upload window closed : the cluster waits in the journal.");
+
+    return true;
 }
 
-void DataBase::resetTemporaryTable(void)
+quint64 DataBase::getJournalBytes(void)
 {
     QSqlQuery   query;
+    quint64     bytes(0);
 
-    query = m_sqlDb.exec(SQL_QUERY_DROP_TABLE_TEMP);
-    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
-    query = m_sqlDb.exec(SQL_QUERY_CREATE_TABLE_TEMP);
+    query = this->execQuery(SQL_QUERY_GET_JOURNAL);
     qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    while(query.next())
+        bytes += QFileInfo(query.value(query.record().indexOf("Path")).toString()).size();
+
+    return bytes;
 }
 
-QLinkedList<t_IndexTable> DataBase::lookForDeletedFiles(const QString dir)
+void DataBase::rollbackCluster(const QString cluster, const QString target, const int kind)
 {
-    QLinkedList<t_IndexTable> list;
-    t_IndexTable     entry;
-    QSqlQuery        query;
-    int              targetField, clusterField;
+    QSqlQuery   query;
+    QStringList sourceList;
 
-    if(Config::getBackupMode() == BackupMode::SEPARTE_BY_DIR)
+    m_sqlDb.transaction();
+
+    if(kind == JOURNAL_KIND_CHUNKS)
     {
-        //Search for new file in temp_table point view (not recursive)
-        query = m_sqlDb.exec(SQL_QUERY_LOOK_FOR_DELETE(dir));
+        //All the files using a chunk of this cluster are chunked again
+        query = this->execQuery(SQL_QUERY_GET_SOURCES_OF_CHUNK_CLUSTER(cluster));
         qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
-    }
-    else if(Config::getBackupMode() == BackupMode::RECURSIVE)
-    {
-        //Search for new file in temp_table point view (recursive)
-        query = m_sqlDb.exec(SQL_QUERY_LOOK_FOR_DELETE_RECURSIVE(dir));
+
+        while(query.next())
+            sourceList << query.value(0).toString();
+
+        foreach(QString source, sourceList)
+            this->releaseChunkedFile(source);
+
+        query = this->execQuery(SQL_QUERY_DELETE_CHUNK_CLUSTER(cluster));
         qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
     }
+    else
+        this->deleteCluster(cluster);
 
-    //Find row number
-    targetField  = query.record().indexOf("Target");
-    clusterField = query.record().indexOf("Cluster");
+    query = this->execQuery(SQL_QUERY_DELETE_JOURNAL(cluster));
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+
+    m_sqlDb.commit();
+
+    qWarning(QString("The cluster "+ cluster +" ("+ target +") is lost, its files will be uploaded again.").toUtf8());
+}
+
+void DataBase::cleanJournalDir(void)
+{
+    QSqlQuery   query;
+    QStringList journalFiles;
+    QDir        journalDir(Config::getJournalPath());
+    QString     workDir(QFileInfo(m_archiveBuilder->getTempDir()).fileName());
+    QRegExp     clusterName(JOURNAL_FILE_PATTERN);
+
+    query = this->execQuery(SQL_QUERY_GET_JOURNAL);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
 
-    //Delete from both SIA and database the entry
     while(query.next())
-    {
-        entry.target  = query.value(targetField).toString();
-        entry.cluster = query.value(clusterField).toString();
+        journalFiles << QFileInfo(query.value(query.record().indexOf("Path")).toString()).fileName();
 
-        list << entry;
+    //The archives which are not in the journal (stopped during the build), the journal dir can be shared with other files
+    foreach(QString fileName, journalDir.entryList(QDir::Files))
+    {
+        if(clusterName.exactMatch(fileName) && !journalFiles.contains(fileName))
+            QFile::remove(journalDir.absoluteFilePath(fileName));
     }
 
-    return list;
+    //The work dirs of the stopped runs
+    foreach(QString dirName, journalDir.entryList(QStringList() << "work-*", QDir::Dirs | QDir::NoDotAndDotDot))
+    {
+        if(dirName != workDir)
+            QDir(journalDir.absoluteFilePath(dirName)).removeRecursively();
+    }
 }
 
-QLinkedList<t_IndexTable> DataBase::lookForChangedFiles(const QString dir)
+void DataBase::defragProcedure(const QString dir)
 {
-    QLinkedList<t_IndexTable> list;
-    t_IndexTable     entry;
-    QSqlQuery        query;
-    int              targetField, clusterField;
+    QSqlQuery                   query;
+    QList<t_defragCandidate>    candidates;
+    t_defragCandidate           candidate;
+    t_defragPlan                defragPlan;
+    int                         clusterField, targetField, sizeField;
+    quint64                     pendingBytes;
+
+    const quint64 CLUSTER_SIZE(Config::getClusterSize());
+    const quint64 BUDGET(Config::getDefragBudget());
+    DefragPlanner defragPlanner(CLUSTER_SIZE, Config::getDefragUploadCost());
+
+    //The budget is shared by all the syncs of the run
+    if(m_defragBytes >= BUDGET)
+        return;
+
+    qInfo("Sync : Looking for under-filled clusters...");
 
     if(Config::getBackupMode() == BackupMode::SEPARTE_BY_DIR)
     {
-        //Search for new file in temp_table point view (not recursive)
-        query = m_sqlDb.exec(SQL_QUERY_LOOK_FOR_CHANGE(dir));
+        //Get the under-filled clusters in this directory (not recusrive)
+        query = this->execQuery(SQL_QUERY_LOOK_FOR_DEFRAG(dir, QString::number(CLUSTER_SIZE), QString::number(MAX_DEFRAG_CANDIDATES)));
         qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
     }
     else if(Config::getBackupMode() == BackupMode::RECURSIVE)
     {
-        //Search for new file in temp_table point view (recursive)
-        query = m_sqlDb.exec(SQL_QUERY_LOOK_FOR_CHANGE_RECURSIVE(dir));
+        //Get the under-filled clusters in this directory (recusrive)
+        query = this->execQuery(SQL_QUERY_LOOK_FOR_DEFRAG_RECURSIVE(dir, QString::number(CLUSTER_SIZE), QString::number(MAX_DEFRAG_CANDIDATES)));
         qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
     }
 
     //Find row number
-    targetField  = query.record().indexOf("Target");
     clusterField = query.record().indexOf("Cluster");
+    targetField  = query.record().indexOf("Target");
+    sizeField    = query.record().indexOf("LiveSize");
 
-    //Delete from both SIA and database the entry
     while(query.next())
     {
-        entry.target  = query.value(targetField).toString();
-        entry.cluster = query.value(clusterField).toString();
+        candidate.cluster  = query.value(clusterField).toString();
+        candidate.target   = query.value(targetField).toString();
+        candidate.liveSize = query.value(sizeField).toULongLong();
 
-        list << entry;
+        candidates << candidate;
     }
 
-    return list;
+    pendingBytes = this->getFileBytesInTempTable();
+
+    //Compare the bytes to upload again with the padding saved on SIA
+    defragPlan = defragPlanner.plan(pendingBytes, candidates, BUDGET - m_defragBytes);
+
+    foreach(t_defragCandidate merged, defragPlan.clusters)
+        this->evictCluster(merged.cluster, merged.target);
+
+    m_defragBytes += defragPlan.reuploadBytes;
+
+    qInfo(QString("Sync : Result "+ QString::number(defragPlan.clusters.count()) +"/"+ QString::number(candidates.count()) +" under-filled clusters merged ("
+                  + QString::number(defragPlan.reuploadBytes) +" bytes uploaded again, "+ QString::number(defragPlan.paddingSaved) +" bytes of padding saved).").toUtf8());
 }
 
-void DataBase::deleteCluster(const QString cluster)
+void DataBase::syncTables(void)
 {
     QSqlQuery query;
 
-    query = m_sqlDb.exec(SQL_QUERY_DELETE_CLUSTER_DB(cluster));
+    query = this->execQuery(SQL_QUERY_SYNC_TABLES);
     qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
 }
 
-void DataBase::deleteSmallerCluster(const QString dir)
+int DataBase::getFileCountInTempTable(void)
 {
     QSqlQuery query;
-    int       clusterField, clusterTarget;
-    QString   strCluster, strTarget;
-
-    if(Config::getBackupMode() == BackupMode::SEPARTE_BY_DIR)
-    {
-        //Get the smaller cluster name in this directory (not recusrive)
-        query = m_sqlDb.exec(SQL_QUERY_DELETE_SMALLER_CLUSTER(dir));
-        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
-    }
-    else if(Config::getBackupMode() == BackupMode::RECURSIVE)
-    {
-        //Get the smaller cluster name in this directory (recusrive)
-        query = m_sqlDb.exec(SQL_QUERY_DELETE_SMALLER_CLUSTER_RECURSIVE(dir));
-        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
-    }
 
-    //Find row number
-    clusterField    = query.record().indexOf("Cluster");
-    clusterTarget   = query.record().indexOf("Target");
+    query = this->execQuery(SQL_QUERY_COUNT_TEMP_TABLE_ROW);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+    query.next();
 
-    //If the query is a success
-    if(query.next())
-    {
-        strCluster  = query.value(clusterField).toString();
-        strTarget   = query.value(clusterTarget).toString();
+    return query.value(0).toULongLong();
+}
 
-        //Copy the cluster content to temp_table
-        query = m_sqlDb.exec(SQL_QUERY_COPY_CLUSTER_TO_TEMP_TABLE(strCluster));
-        qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+int DataBase::getChunkCountInTempTable(void)
+{
+    QSqlQuery query;
 
-        //Remove the cluster from database
-        this->deleteCluster(strCluster);
+    query = this->execQuery(SQL_QUERY_COUNT_CHUNK_TEMP_TABLE_ROW);
+    qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+    query.next();
 
-        //Delete on SIA
-        m_siaCom->deleteFile(strTarget);
-    }
+    return query.value(0).toInt();
 }
 
-void DataBase::syncTables(void)
+quint64 DataBase::getChunkBytesInTempTable(void)
 {
     QSqlQuery query;
 
-    query = m_sqlDb.exec(SQL_QUERY_SYNC_TABLES);
+    query = this->execQuery(SQL_QUERY_SUM_CHUNK_TEMP_TABLE_SIZE);
     qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
+    query.next();
+
+    return query.value(0).toULongLong();
 }
 
-int DataBase::getFileCountInTempTable(void)
+quint64 DataBase::getFileBytesInTempTable(void)
 {
     QSqlQuery query;
 
-    query = m_sqlDb.exec(SQL_QUERY_COUNT_TEMP_TABLE_ROW);
+    query = this->execQuery(SQL_QUERY_SUM_TEMP_TABLE_SIZE);
     qDebug(QString("Query : "+ query.executedQuery()).toUtf8());
     query.next();
 
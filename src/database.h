@@ -4,33 +4,174 @@
 #include "archivebuilder.h"
 #include "config.h"
 #include "siacom.h"
+#include "chunkbuilder.h"
+#include "defragplanner.h"
+#include "restoreengine.h"
 #include "apptypeutils.h"
+#include "metrics.h"
+#include "clustercandidates.h"
+#include "compressionpolicy.h"
+#include "solidcompressor.h"
 
 #include <QObject>
 #include <QtSql>
 #include <QByteArray>
 #include <QCryptographicHash>
 #include <QLinkedList>
+#include <QDir>
+#include <QDateTime>
+#include <QMap>
+#include <limits>
 
-#define SQL_QUERY_CREATE_TABLE_INDEX                    QString("CREATE TABLE IF NOT EXISTS \"index_table\" ( `Cluster` TEXT NOT NULL, `Source` TEXT NOT NULL UNIQUE, `Target` TEXT NOT NULL, `Hash` TEXT NOT NULL, `Size` UNSIGNED BIG INT );")
-#define SQL_QUERY_CREATE_TABLE_TEMP                     QString("CREATE TEMPORARY TABLE \"temp_table\" ( `Source` TEXT NOT NULL UNIQUE, `Hash` TEXT NOT NULL, `Size` UNSIGNED BIG INT );")
+//The files cut in chunks are recorded in index_table with this prefix as cluster (their data is in chunk_table)
+#define CDC_CLUSTER_PREFIX                              QString("cdc:")
+
+#define SQL_QUERY_CREATE_TABLE_INDEX                    QString("CREATE TABLE IF NOT EXISTS \"index_table\" ( `Cluster` TEXT NOT NULL, `Source` TEXT NOT NULL UNIQUE, `Target` TEXT NOT NULL, `Hash` TEXT NOT NULL, `Size` UNSIGNED BIG INT, `Member` TEXT );")
+#define SQL_QUERY_UPGRADE_TABLE_INDEX_MEMBER            QString("ALTER TABLE index_table ADD COLUMN `Member` TEXT;")
+#define SQL_QUERY_UPGRADE_TABLE_INDEX_HEADER_OFFSET     QString("ALTER TABLE index_table ADD COLUMN `HeaderOffset` BIG INT DEFAULT -1;")
+#define SQL_QUERY_UPGRADE_TABLE_INDEX_DATA_OFFSET       QString("ALTER TABLE index_table ADD COLUMN `DataOffset` BIG INT DEFAULT -1;")
+#define SQL_QUERY_UPGRADE_TABLE_INDEX_DATA_LENGTH       QString("ALTER TABLE index_table ADD COLUMN `DataLength` UNSIGNED BIG INT;")
+#define SQL_QUERY_UPGRADE_TABLE_INDEX_CIPHER            QString("ALTER TABLE index_table ADD COLUMN `Cipher` TEXT;")
+#define SQL_QUERY_UPGRADE_TABLE_INDEX_CHANGES           QString("ALTER TABLE index_table ADD COLUMN `Changes` INTEGER DEFAULT 0;")
+#define SQL_QUERY_UPGRADE_TABLE_INDEX_CHANGED_AT        QString("ALTER TABLE index_table ADD COLUMN `ChangedAt` BIG INT DEFAULT 0;")
+#define SQL_QUERY_UPGRADE_TABLE_INDEX_COMPRESSION       QString("ALTER TABLE index_table ADD COLUMN `Compression` TEXT;")
+#define SQL_QUERY_SET_INDEX_COMPRESSION(SOURCE, COMPRESSION)\
+                                                        QString("UPDATE index_table SET Compression='"+QString(COMPRESSION)+"' WHERE Source='"+QString(SOURCE)+"';")
+#define SQL_QUERY_UPGRADE_TABLE_CHUNK_CIPHER            QString("ALTER TABLE chunk_table ADD COLUMN `Cipher` TEXT;")
+#define SQL_QUERY_SET_INDEX_CIPHER(SOURCE, CIPHER)      QString("UPDATE index_table SET Cipher='"+QString(CIPHER)+"' WHERE Source='"+QString(SOURCE)+"';")
+#define SQL_QUERY_SET_CHUNK_CIPHER(HASH, CIPHER)        QString("UPDATE chunk_table SET Cipher='"+QString(CIPHER)+"' WHERE Hash='"+QString(HASH)+"';")
+#define SQL_QUERY_SET_INDEX_OFFSETS(SOURCE, HEADER, DATA, LENGTH)\
+                                                        QString("UPDATE index_table SET HeaderOffset="+QString(HEADER)+", DataOffset="+QString(DATA)+", DataLength="+QString(LENGTH)+" WHERE Source='"+QString(SOURCE)+"';")
+#define SQL_QUERY_CREATE_INDEX_INDEX_HASH               QString("CREATE INDEX IF NOT EXISTS index_table_hash ON index_table (Hash);")
+#define SQL_QUERY_CREATE_TABLE_TEMP                     QString("CREATE TEMPORARY TABLE \"temp_table\" ( `Source` TEXT NOT NULL UNIQUE, `Hash` TEXT NOT NULL, `Size` UNSIGNED BIG INT, `Compression` TEXT );")
 #define SQL_QUERY_DROP_TABLE_TEMP                       QString("DROP TABLE IF EXISTS temp_table;")
 #define SQL_QUERY_INSERT_TABLE_TEMP(SOURCE, HASH, SIZE) QString("INSERT INTO temp_table (Source, Hash, Size) VALUES ('"+QString(SOURCE)+"', '"+QString(HASH)+"', "+QString(SIZE)+");")
 //#define SQL_QUERY_LOOK_FOR_DELETE(DIR)                  QString("SELECT Cluster, Target FROM index_table WHERE Source REGEXP '"+QString(DIR)+"/(?!.*/).*' AND Source NOT IN (SELECT Source FROM temp_table WHERE Source REGEXP '"+QString(DIR)+"/(?!.*/).*');")
-#define SQL_QUERY_LOOK_FOR_DELETE(DIR)                  QString("SELECT Cluster,Target FROM index_table WHERE Source LIKE '"+QString(DIR)+"/%' AND Source NOT LIKE '"+QString(DIR)+"/%/%' AND Source NOT IN (SELECT Source FROM temp_table WHERE Source LIKE '"+QString(DIR)+"/%' AND Source NOT LIKE '"+QString(DIR)+"/%/%');")
+#define SQL_QUERY_LOOK_FOR_DELETE(DIR)                  QString("SELECT Cluster,Source,Target,Member,Size FROM index_table WHERE Source LIKE '"+QString(DIR)+"/%' AND Source NOT LIKE '"+QString(DIR)+"/%/%' AND Source NOT IN (SELECT Source FROM temp_table WHERE Source LIKE '"+QString(DIR)+"/%' AND Source NOT LIKE '"+QString(DIR)+"/%/%');")
 #define SQL_QUERY_DELETE_CLUSTER_DB(CLUSTER)            QString("DELETE FROM index_table WHERE Cluster='"+QString(CLUSTER)+"';")
 //#define SQL_QUERY_LOOK_FOR_DELETE(DIR)                  QString("SELECT Cluster, Target FROM index_table WHERE Source REGEXP '"+QString(DIR)+"/(?!.*/).*' AND Source IN (SELECT Source FROM temp_table) AND Hash NOT IN (SELECT Hash FROM temp_table);")
-#define SQL_QUERY_LOOK_FOR_CHANGE(DIR)                  QString("SELECT Cluster,Target FROM index_table WHERE Source LIKE '"+QString(DIR)+"/%' AND Source NOT LIKE '"+QString(DIR)+"/%/%' AND Source IN (SELECT Source FROM temp_table) AND Hash NOT IN (SELECT Hash FROM temp_table);")
+#define SQL_QUERY_LOOK_FOR_CHANGE(DIR)                  QString("SELECT Cluster,Source,Target,Member,Size FROM index_table WHERE Source LIKE '"+QString(DIR)+"/%' AND Source NOT LIKE '"+QString(DIR)+"/%/%' AND Source IN (SELECT Source FROM temp_table) AND Hash NOT IN (SELECT Hash FROM temp_table);")
+#define SQL_QUERY_SET_TEMP_COMPRESSION(SOURCE, COMPRESSION)\
+                                                        QString("UPDATE temp_table SET Compression='"+QString(COMPRESSION)+"' WHERE Source='"+QString(SOURCE)+"';")
+#define SQL_QUERY_DELETE_TEMP_SOURCE(SOURCE)            QString("DELETE FROM temp_table WHERE Source='"+QString(SOURCE)+"';")
 #define SQL_QUERY_SYNC_TABLES                           QString("DELETE FROM temp_table WHERE Source IN (SELECT Source FROM index_table);")
-#define SQL_QUERY_GET_SRC_ORDER_BY_SIZE_DESC            QString("SELECT Source,Hash,Size FROM temp_table ORDER BY Size DESC;")
+//The hot files (HOT is an expression on the churn_table "c") come first, they are packed apart from the cold ones
+#define SQL_QUERY_GET_SRC_ORDER_BY_SIZE_DESC(HOT)       QString("SELECT t.Source AS Source,t.Hash AS Hash,t.Size AS Size,t.Compression AS Compression,"+QString(HOT)+" AS Hot FROM temp_table t LEFT JOIN churn_table c ON c.Source=t.Source ORDER BY Hot DESC, t.Size DESC;")
+//rtrim of all the characters except '/' give the directory of the file (with its last '/'), so a subtree is contiguous and its direct files come first
+#define SQL_QUERY_GET_SRC_ORDER_BY_PATH(HOT)            QString("SELECT t.Source AS Source,t.Hash AS Hash,t.Size AS Size,t.Compression AS Compression,"+QString(HOT)+" AS Hot FROM temp_table t LEFT JOIN churn_table c ON c.Source=t.Source ORDER BY Hot DESC, rtrim(t.Source, replace(t.Source, '/', '')), t.Source;")
+#define SQL_HOT_EXPRESSION(CHANGES, SINCE)              QString("(IFNULL(c.Changes,0) >= "+QString(CHANGES)+" AND IFNULL(c.ChangedAt,0) >= "+QString(SINCE)+")")
+//Change frequency of the files out of the index (changed files and files of the merged clusters), kept on disk until the file is indexed again (a stopped run doesn't lose it)
+//The count restart at 1 when the last change is older than the hot window
+#define SQL_QUERY_CREATE_TABLE_CHURN                    QString("CREATE TABLE IF NOT EXISTS \"churn_table\" ( `Source` TEXT NOT NULL UNIQUE, `Changes` INTEGER, `ChangedAt` BIG INT );")
+#define SQL_QUERY_RECORD_CHANGE(SOURCE, NOW, SINCE)     QString("INSERT OR REPLACE INTO churn_table (Source, Changes, ChangedAt) SELECT Source, CASE WHEN IFNULL(ChangedAt,0) >= "+QString(SINCE)+" THEN IFNULL(Changes,0) + 1 ELSE 1 END, "+QString(NOW)+" FROM index_table WHERE Source='"+QString(SOURCE)+"';")
+#define SQL_QUERY_KEEP_CLUSTER_CHURN(CLUSTER)           QString("INSERT OR IGNORE INTO churn_table (Source, Changes, ChangedAt) SELECT Source, Changes, ChangedAt FROM index_table WHERE Cluster='"+QString(CLUSTER)+"' AND Changes > 0;")
+#define SQL_QUERY_RESTORE_CHURN                         QString("UPDATE index_table SET Changes=(SELECT Changes FROM churn_table WHERE churn_table.Source=index_table.Source), ChangedAt=(SELECT ChangedAt FROM churn_table WHERE churn_table.Source=index_table.Source) WHERE Source IN (SELECT Source FROM churn_table);")
+#define SQL_QUERY_CLEAR_RESTORED_CHURN                  QString("DELETE FROM churn_table WHERE Source IN (SELECT Source FROM index_table);")
+#define SQL_QUERY_DELETE_ORPHAN_CHURN                   QString("DELETE FROM churn_table WHERE Source NOT IN (SELECT Source FROM index_table);")
+#define SQL_QUERY_GET_CLUSTERS_PER_DIR                  QString("SELECT count(*), IFNULL(AVG(Clusters),0), IFNULL(MAX(Clusters),0) FROM (SELECT COUNT(DISTINCT Cluster) AS Clusters FROM index_table WHERE Cluster NOT LIKE '"+CDC_CLUSTER_PREFIX+"%' GROUP BY rtrim(Source, replace(Source, '/', '')));")
 #define SQL_QUERY_COUNT_TEMP_TABLE_ROW                  QString("SELECT count(*) FROM temp_table;")
-#define SQL_QUERY_DELETE_SMALLER_CLUSTER(DIR)           QString("SELECT Cluster,SUM(Size) AS CSize FROM index_table WHERE Source LIKE '"+QString(DIR)+"/%' AND Source NOT LIKE '"+QString(DIR)+"/%/%' GROUP BY Cluster ORDER BY CSize ASC LIMIT 1;")
-#define SQL_QUERY_COPY_CLUSTER_TO_TEMP_TABLE(CLUSTER)   QString("INSERT INTO temp_table (Source, Hash, Size) SELECT Source, Hash, Size FROM index_table WHERE Cluster='"+QString(CLUSTER)+"';")
-#define SQL_QUERY_INSERT_INDEX_TABLE(CLUSTER, SOURCE, TARGET, HASH, SIZE)\
-                                                        QString("INSERT INTO index_table (Cluster, Source, Target, Hash, Size) VALUES ('"+QString(CLUSTER)+"', '"+QString(SOURCE)+"', '"+QString(TARGET)+"', '"+QString(HASH)+"', "+QString(SIZE)+");")
-#define SQL_QUERY_LOOK_FOR_DELETE_RECURSIVE(DIR)        QString("SELECT Cluster,Target FROM index_table WHERE Source LIKE '"+QString(DIR)+"/%' AND Source NOT IN (SELECT Source FROM temp_table WHERE Source LIKE '"+QString(DIR)+"/%';")
-#define SQL_QUERY_LOOK_FOR_CHANGE_RECURSIVE(DIR)        QString("SELECT Cluster,Target FROM index_table WHERE Source LIKE '"+QString(DIR)+"/%' AND Source IN (SELECT Source FROM temp_table) AND Hash NOT IN (SELECT Hash FROM temp_table);")
-#define SQL_QUERY_DELETE_SMALLER_CLUSTER_RECURSIVE(DIR) QString("SELECT Cluster,SUM(Size) AS CSize FROM index_table WHERE Source LIKE '"+QString(DIR)+"/%' GROUP BY Cluster ORDER BY CSize ASC LIMIT 1;")
+#define SQL_QUERY_SUM_TEMP_TABLE_SIZE                   QString("SELECT IFNULL(SUM(Size),0) FROM temp_table;")
+#define SQL_QUERY_LOOK_FOR_DEFRAG(DIR, SIZE, LIMIT)     QString("SELECT Cluster,Target,LiveSize FROM cluster_table WHERE LiveSize < "+QString(SIZE)+" AND Cluster IN (SELECT Cluster FROM index_table WHERE Source LIKE '"+QString(DIR)+"/%' AND Source NOT LIKE '"+QString(DIR)+"/%/%') ORDER BY LiveSize ASC LIMIT "+QString(LIMIT)+";")
+#define SQL_QUERY_LOOK_FOR_DEFRAG_RECURSIVE(DIR, SIZE, LIMIT)\
+                                                        QString("SELECT Cluster,Target,LiveSize FROM cluster_table WHERE LiveSize < "+QString(SIZE)+" AND Cluster IN (SELECT Cluster FROM index_table WHERE Source LIKE '"+QString(DIR)+"/%') ORDER BY LiveSize ASC LIMIT "+QString(LIMIT)+";")
+#define SQL_QUERY_COPY_CLUSTER_TO_TEMP_TABLE(CLUSTER)   QString("INSERT OR IGNORE INTO temp_table (Source, Hash, Size, Compression) SELECT Source, Hash, Size, Compression FROM index_table WHERE Cluster='"+QString(CLUSTER)+"';")
+#define SQL_QUERY_INSERT_INDEX_TABLE(CLUSTER, SOURCE, TARGET, HASH, SIZE, MEMBER)\
+                                                        QString("INSERT INTO index_table (Cluster, Source, Target, Hash, Size, Member) VALUES ('"+QString(CLUSTER)+"', '"+QString(SOURCE)+"', '"+QString(TARGET)+"', '"+QString(HASH)+"', "+QString(SIZE)+", '"+QString(MEMBER)+"');")
+#define SQL_QUERY_CREATE_TABLE_DELETE                   QString("CREATE TABLE IF NOT EXISTS \"delete_table\" ( `Target` TEXT NOT NULL UNIQUE );")
+#define SQL_QUERY_QUEUE_DELETE(TARGET)                  QString("INSERT OR IGNORE INTO delete_table (Target) VALUES ('"+QString(TARGET)+"');")
+#define SQL_QUERY_GET_PENDING_DELETE                    QString("SELECT Target FROM delete_table;")
+#define SQL_QUERY_COUNT_PENDING_DELETE                  QString("SELECT count(*) FROM delete_table;")
+#define SQL_QUERY_UNQUEUE_DELETE(TARGET)                QString("DELETE FROM delete_table WHERE Target='"+QString(TARGET)+"';")
+#define SQL_QUERY_CREATE_TABLE_CHUNK                    QString("CREATE TABLE IF NOT EXISTS \"chunk_table\" ( `Hash` TEXT NOT NULL UNIQUE, `Cluster` TEXT NOT NULL, `Target` TEXT NOT NULL, `Size` UNSIGNED BIG INT );")
+#define SQL_QUERY_CREATE_TABLE_FILE_CHUNK               QString("CREATE TABLE IF NOT EXISTS \"file_chunk_table\" ( `Source` TEXT NOT NULL, `Seq` INTEGER NOT NULL, `Hash` TEXT NOT NULL, `Offset` UNSIGNED BIG INT, `Size` UNSIGNED BIG INT );")
+#define SQL_QUERY_CREATE_INDEX_FILE_CHUNK_SOURCE        QString("CREATE INDEX IF NOT EXISTS file_chunk_source ON file_chunk_table (Source);")
+#define SQL_QUERY_CREATE_INDEX_FILE_CHUNK_HASH          QString("CREATE INDEX IF NOT EXISTS file_chunk_hash ON file_chunk_table (Hash);")
+#define SQL_QUERY_CREATE_TABLE_CHUNK_TEMP               QString("CREATE TEMPORARY TABLE IF NOT EXISTS \"chunk_temp_table\" ( `Hash` TEXT NOT NULL UNIQUE, `Size` UNSIGNED BIG INT );")
+#define SQL_QUERY_GET_SRC_TO_CHUNK(SIZE)                QString("SELECT Source,Hash,Size FROM temp_table WHERE Size >= "+QString(SIZE)+";")
+#define SQL_QUERY_IS_CHUNK_KNOWN(HASH)                  QString("SELECT (SELECT count(*) FROM chunk_table WHERE Hash='"+QString(HASH)+"') + (SELECT count(*) FROM chunk_temp_table WHERE Hash='"+QString(HASH)+"');")
+#define SQL_QUERY_INSERT_CHUNK_TEMP(HASH, SIZE)         QString("INSERT INTO chunk_temp_table (Hash, Size) VALUES ('"+QString(HASH)+"', "+QString(SIZE)+");")
+#define SQL_QUERY_CREATE_TABLE_FILE_CHUNK_TEMP          QString("CREATE TEMPORARY TABLE IF NOT EXISTS \"file_chunk_temp_table\" ( `Source` TEXT NOT NULL, `Seq` INTEGER NOT NULL, `Hash` TEXT NOT NULL, `Offset` UNSIGNED BIG INT, `Size` UNSIGNED BIG INT );")
+#define SQL_QUERY_CREATE_TABLE_CHUNKED_TEMP             QString("CREATE TEMPORARY TABLE IF NOT EXISTS \"chunked_temp_table\" ( `Source` TEXT NOT NULL UNIQUE, `Hash` TEXT NOT NULL, `Size` UNSIGNED BIG INT );")
+#define SQL_QUERY_INSERT_CHUNKED_TEMP(SOURCE, HASH, SIZE)\
+                                                        QString("INSERT OR REPLACE INTO chunked_temp_table (Source, Hash, Size) VALUES ('"+QString(SOURCE)+"', '"+QString(HASH)+"', "+QString(SIZE)+");")
+#define SQL_QUERY_DISCARD_CHUNKED_TEMP(SOURCE)          QString("DELETE FROM chunked_temp_table WHERE Source='"+QString(SOURCE)+"';")
+#define SQL_QUERY_DISCARD_FILE_CHUNK_TEMP(SOURCE)       QString("DELETE FROM file_chunk_temp_table WHERE Source='"+QString(SOURCE)+"';")
+//A chunked file is recorded when all its chunks are in a journaled (or uploaded) cluster
+#define SQL_PENDING_CHUNKED_FILES                       QString("SELECT Source FROM file_chunk_temp_table WHERE Hash NOT IN (SELECT Hash FROM chunk_table)")
+#define SQL_QUERY_PROMOTE_FILE_CHUNKS                   QString("INSERT INTO file_chunk_table (Source, Seq, Hash, Offset, Size) SELECT Source, Seq, Hash, Offset, Size FROM file_chunk_temp_table WHERE Source NOT IN ("+SQL_PENDING_CHUNKED_FILES+");")
+#define SQL_QUERY_PROMOTE_CHUNKED_FILES                 QString("INSERT INTO index_table (Cluster, Source, Target, Hash, Size, Member) SELECT '"+CDC_CLUSTER_PREFIX+"'||Hash, Source, '', Hash, Size, '' FROM chunked_temp_table WHERE Source NOT IN ("+SQL_PENDING_CHUNKED_FILES+");")
+#define SQL_QUERY_CLEAR_PROMOTED_FILE_CHUNKS            QString("DELETE FROM file_chunk_temp_table WHERE Source IN (SELECT Source FROM index_table);")
+#define SQL_QUERY_CLEAR_PROMOTED_CHUNKED_FILES          QString("DELETE FROM chunked_temp_table WHERE Source IN (SELECT Source FROM index_table);")
+#define SQL_QUERY_GET_PENDING_CHUNKED_FILES             QString("SELECT Source FROM chunked_temp_table;")
+#define SQL_QUERY_INSERT_FILE_CHUNK(SOURCE, SEQ, HASH, OFFSET, SIZE)\
+                                                        QString("INSERT INTO file_chunk_temp_table (Source, Seq, Hash, Offset, Size) VALUES ('"+QString(SOURCE)+"', "+QString(SEQ)+", '"+QString(HASH)+"', "+QString(OFFSET)+", "+QString(SIZE)+");")
+#define SQL_QUERY_GET_CHUNK_ORDER_BY_SIZE_DESC          QString("SELECT Hash,Size FROM chunk_temp_table ORDER BY Size DESC;")
+#define SQL_QUERY_COUNT_CHUNK_TEMP_TABLE_ROW            QString("SELECT count(*) FROM chunk_temp_table;")
+#define SQL_QUERY_SUM_CHUNK_TEMP_TABLE_SIZE             QString("SELECT IFNULL(SUM(Size),0) FROM chunk_temp_table;")
+#define SQL_QUERY_INSERT_CHUNK_TABLE(HASH, CLUSTER, TARGET, SIZE)\
+                                                        QString("INSERT OR REPLACE INTO chunk_table (Hash, Cluster, Target, Size) VALUES ('"+QString(HASH)+"', '"+QString(CLUSTER)+"', '"+QString(TARGET)+"', "+QString(SIZE)+");")
+#define SQL_QUERY_DELETE_CHUNK_TEMP(HASH)               QString("DELETE FROM chunk_temp_table WHERE Hash='"+QString(HASH)+"';")
+#define SQL_QUERY_RELEASE_FILE_INDEX(SOURCE)            QString("DELETE FROM index_table WHERE Source='"+QString(SOURCE)+"';")
+#define SQL_QUERY_RELEASE_FILE_CHUNK(SOURCE)            QString("DELETE FROM file_chunk_table WHERE Source='"+QString(SOURCE)+"';")
+#define SQL_QUERY_DELETE_ORPHAN_FILE_CHUNK              QString("DELETE FROM file_chunk_table WHERE Source NOT IN (SELECT Source FROM index_table);")
+#define SQL_QUERY_LOOK_FOR_UNUSED_CHUNK_CLUSTER         QString("SELECT DISTINCT Cluster,Target FROM chunk_table WHERE Cluster NOT IN (SELECT DISTINCT chunk_table.Cluster FROM chunk_table INNER JOIN file_chunk_table ON chunk_table.Hash=file_chunk_table.Hash);")
+#define SQL_QUERY_DELETE_CHUNK_CLUSTER(CLUSTER)         QString("DELETE FROM chunk_table WHERE Cluster='"+QString(CLUSTER)+"';")
+#define SQL_QUERY_CREATE_TABLE_DEDUP_TEMP               QString("CREATE TEMPORARY TABLE IF NOT EXISTS \"dedup_temp_table\" ( `Source` TEXT NOT NULL UNIQUE, `Hash` TEXT NOT NULL, `Size` UNSIGNED BIG INT );")
+#define SQL_QUERY_DEDUP_FROM_INDEX(TABLE, SCOPE, MAXSIZE)\
+                                                        QString("INSERT INTO index_table (Cluster, Source, Target, Hash, Size, Member, HeaderOffset, DataOffset, DataLength, Cipher, Compression) SELECT i.Cluster, t.Source, i.Target, t.Hash, t.Size, i.Member, i.HeaderOffset, i.DataOffset, i.DataLength, i.Cipher, i.Compression FROM "+QString(TABLE)+" t INNER JOIN index_table i ON i.Hash=t.Hash WHERE i.Member IS NOT NULL AND i.Member<>'' AND i.Cluster NOT LIKE '"+CDC_CLUSTER_PREFIX+"%' AND t.Hash<>'' AND i.Hash<>'' AND t.Size < "+QString(MAXSIZE)+" AND "+QString(SCOPE)+" GROUP BY t.Source;")
+#define SQL_QUERY_GET_INDEX_HASH(SOURCE)                QString("SELECT Hash FROM index_table WHERE Source='"+QString(SOURCE)+"';")
+#define SQL_QUERY_DEDUP_SCOPE(DIR)                      QString("i.Source LIKE '"+QString(DIR)+"/%' AND i.Source NOT LIKE '"+QString(DIR)+"/%/%'")
+#define SQL_QUERY_DEDUP_SCOPE_RECURSIVE(DIR)            QString("i.Source LIKE '"+QString(DIR)+"/%'")
+#define SQL_QUERY_MOVE_PENDING_DUPLICATES(MAXSIZE)      QString("INSERT INTO dedup_temp_table (Source, Hash, Size) SELECT Source, Hash, Size FROM temp_table WHERE Hash<>'' AND Size < "+QString(MAXSIZE)+" AND rowid NOT IN (SELECT MIN(rowid) FROM temp_table GROUP BY Hash);")
+#define SQL_QUERY_REMOVE_PENDING_DUPLICATES             QString("DELETE FROM temp_table WHERE Source IN (SELECT Source FROM dedup_temp_table);")
+#define SQL_QUERY_RESOLVE_PENDING_DUPLICATES            QString("DELETE FROM dedup_temp_table WHERE Source IN (SELECT Source FROM index_table);")
+#define SQL_QUERY_RESTORE_PENDING_DUPLICATES            QString("INSERT OR IGNORE INTO temp_table (Source, Hash, Size) SELECT Source, Hash, Size FROM dedup_temp_table;")
+#define SQL_QUERY_CLEAR_DEDUP_TEMP                      QString("DELETE FROM dedup_temp_table;")
+#define SQL_QUERY_COUNT_DEDUP_TEMP_TABLE_ROW            QString("SELECT count(*) FROM dedup_temp_table;")
+#define SQL_QUERY_CREATE_TABLE_CLUSTER                  QString("CREATE TABLE IF NOT EXISTS \"cluster_table\" ( `Cluster` TEXT NOT NULL UNIQUE, `Target` TEXT NOT NULL, `TotalSize` UNSIGNED BIG INT, `LiveSize` UNSIGNED BIG INT );")
+#define SQL_QUERY_UPGRADE_TABLE_CLUSTER                 QString("INSERT INTO cluster_table (Cluster, Target, TotalSize, LiveSize) SELECT Cluster, Target, SUM(Size), SUM(Size) FROM (SELECT DISTINCT Cluster, Target, IFNULL(Member, Source) AS M, Size FROM index_table WHERE Cluster NOT LIKE '"+CDC_CLUSTER_PREFIX+"%' AND Cluster NOT IN (SELECT Cluster FROM cluster_table)) GROUP BY Cluster;")
+#define SQL_QUERY_DROP_TABLE_TOMBSTONE                  QString("DROP TABLE IF EXISTS tombstone_table;")
+#define SQL_QUERY_INSERT_CLUSTER_TABLE(CLUSTER, TARGET, SIZE)\
+                                                        QString("INSERT OR REPLACE INTO cluster_table (Cluster, Target, TotalSize, LiveSize) VALUES ('"+QString(CLUSTER)+"', '"+QString(TARGET)+"', "+QString(SIZE)+", "+QString(SIZE)+");")
+#define SQL_QUERY_REFRESH_CLUSTER_LIVE_SIZE(CLUSTER)    QString("UPDATE cluster_table SET LiveSize=(SELECT IFNULL(SUM(Size),0) FROM (SELECT DISTINCT IFNULL(Member, Source) AS M, Size FROM index_table WHERE Cluster='"+QString(CLUSTER)+"')) WHERE Cluster='"+QString(CLUSTER)+"';")
+#define SQL_QUERY_GET_CLUSTER_LIVE_SIZE(CLUSTER)        QString("SELECT LiveSize FROM cluster_table WHERE Cluster='"+QString(CLUSTER)+"';")
+#define SQL_QUERY_DELETE_CLUSTER_TABLE(CLUSTER)         QString("DELETE FROM cluster_table WHERE Cluster='"+QString(CLUSTER)+"';")
+#define SQL_QUERY_LOOK_FOR_COMPACTION(DIR, RATIO)       QString("SELECT Cluster,Target,TotalSize,LiveSize FROM cluster_table WHERE LiveSize < TotalSize * "+QString(RATIO)+" AND Cluster IN (SELECT Cluster FROM index_table WHERE Source LIKE '"+QString(DIR)+"/%' AND Source NOT LIKE '"+QString(DIR)+"/%/%');")
+#define SQL_QUERY_LOOK_FOR_COMPACTION_RECURSIVE(DIR, RATIO)\
+                                                        QString("SELECT Cluster,Target,TotalSize,LiveSize FROM cluster_table WHERE LiveSize < TotalSize * "+QString(RATIO)+" AND Cluster IN (SELECT Cluster FROM index_table WHERE Source LIKE '"+QString(DIR)+"/%');")
+#define SQL_QUERY_LOOK_FOR_RESTORE(PATH)                QString("SELECT Cluster,Target,Source,Member,-1 AS Offset,Size,DataOffset,DataLength,Hash,Cipher,Compression FROM index_table WHERE (Source='"+QString(PATH)+"' OR (Source >= '"+QString(PATH)+"/' AND Source < '"+QString(PATH)+"0')) AND Cluster NOT LIKE '"+CDC_CLUSTER_PREFIX+"%'"\
+                                                                " UNION ALL SELECT c.Cluster,c.Target,f.Source,f.Hash,f.Offset,f.Size,-1,f.Size,f.Hash,c.Cipher,NULL FROM file_chunk_table f INNER JOIN chunk_table c ON f.Hash=c.Hash WHERE (f.Source='"+QString(PATH)+"' OR (f.Source >= '"+QString(PATH)+"/' AND f.Source < '"+QString(PATH)+"0')) ORDER BY 1;")
+#define SQL_QUERY_LOOK_FOR_DELETE_RECURSIVE(DIR)        QString("SELECT Cluster,Source,Target,Member,Size FROM index_table WHERE Source LIKE '"+QString(DIR)+"/%' AND Source NOT IN (SELECT Source FROM temp_table WHERE Source LIKE '"+QString(DIR)+"/%');")
+#define SQL_QUERY_LOOK_FOR_CHANGE_RECURSIVE(DIR)        QString("SELECT Cluster,Source,Target,Member,Size FROM index_table WHERE Source LIKE '"+QString(DIR)+"/%' AND Source IN (SELECT Source FROM temp_table) AND Hash NOT IN (SELECT Hash FROM temp_table);")
+
+#define SQL_QUERY_CREATE_TABLE_HASH_CACHE               QString("CREATE TABLE IF NOT EXISTS \"hash_cache_table\" ( `Source` TEXT NOT NULL UNIQUE, `Size` UNSIGNED BIG INT, `MTime` BIG INT, `Hash` TEXT NOT NULL, `Pending` INTEGER DEFAULT 0 );")
+#define SQL_QUERY_UPGRADE_TABLE_HASH_CACHE_PENDING      QString("ALTER TABLE hash_cache_table ADD COLUMN `Pending` INTEGER DEFAULT 0;")
+#define SQL_QUERY_GET_CACHED_HASH(SOURCE, SIZE, MTIME, PENDING)\
+                                                        QString("SELECT Hash FROM hash_cache_table WHERE Source='"+QString(SOURCE)+"' AND Size="+QString(SIZE)+" AND MTime="+QString(MTIME)+" AND Pending>="+QString(PENDING)+";")
+#define SQL_QUERY_CACHE_HASH(SOURCE, SIZE, MTIME, HASH) QString("INSERT OR REPLACE INTO hash_cache_table (Source, Size, MTime, Hash, Pending) VALUES ('"+QString(SOURCE)+"', "+QString(SIZE)+", "+QString(MTIME)+", '"+QString(HASH)+"', 1);")
+#define SQL_QUERY_CLOSE_HASH_CACHE                      QString("UPDATE hash_cache_table SET Pending=0 WHERE Pending<>0;")
+#define SQL_QUERY_DELETE_ORPHAN_HASH_CACHE              QString("DELETE FROM hash_cache_table WHERE Source NOT IN (SELECT Source FROM index_table);")
+#define SQL_QUERY_CREATE_TABLE_JOURNAL                  QString("CREATE TABLE IF NOT EXISTS \"journal_table\" ( `Cluster` TEXT NOT NULL UNIQUE, `Target` TEXT NOT NULL, `Path` TEXT NOT NULL, `Kind` INTEGER NOT NULL );")
+#define SQL_QUERY_INSERT_JOURNAL(CLUSTER, TARGET, PATH, KIND)\
+                                                        QString("INSERT OR REPLACE INTO journal_table (Cluster, Target, Path, Kind) VALUES ('"+QString(CLUSTER)+"', '"+QString(TARGET)+"', '"+QString(PATH)+"', "+QString(KIND)+");")
+#define SQL_QUERY_GET_JOURNAL                           QString("SELECT Cluster,Target,Path,Kind FROM journal_table;")
+#define SQL_QUERY_GET_JOURNAL_CLUSTER(CLUSTER)          QString("SELECT Cluster,Target,Path,Kind FROM journal_table WHERE Cluster='"+QString(CLUSTER)+"';")
+#define SQL_QUERY_DELETE_JOURNAL(CLUSTER)               QString("DELETE FROM journal_table WHERE Cluster='"+QString(CLUSTER)+"';")
+#define SQL_QUERY_GET_SOURCES_OF_CHUNK_CLUSTER(CLUSTER) QString("SELECT DISTINCT f.Source FROM file_chunk_table f INNER JOIN chunk_table c ON f.Hash=c.Hash WHERE c.Cluster='"+QString(CLUSTER)+"';")
+#define SQL_QUERY_LOOK_FOR_INCOMPLETE_CHUNKED_FILES     QString("SELECT DISTINCT Source FROM file_chunk_table WHERE Hash NOT IN (SELECT Hash FROM chunk_table);")
+
+//Kind of the clusters in the journal
+#define JOURNAL_KIND_FILES  0
+#define JOURNAL_KIND_CHUNKS 1
+
+//Name of a cluster archive in the journal dir (SHA1 of the tar, solid suffix), the other files of the dir are never removed
+#define JOURNAL_FILE_PATTERN QString("[0-9a-f]{40}(\\.zst)?")
+
+//Copy of the database used by a dry run (in the journal directory)
+#define PLAN_SNAPSHOT_NAME QString("plan_snapshot.db")
+
+//Max under-filled clusters looked by the defrag planner in one sync
+#define MAX_DEFRAG_CANDIDATES 256
 
 //In test, unix system is >30x faster than windows to make an cluster
 #ifndef _WIN32//On unix platform
@@ -53,6 +194,10 @@ struct t_IndexTable
     QString     target;
     QString     hash;
     quint64     size;
+    QString     member;
+    qint64      headerOffset;
+    qint64      dataOffset;
+    quint64     dataLength;
 };
 
 struct t_clusterInfo
@@ -62,6 +207,18 @@ struct t_clusterInfo
     QString   targetSiaName;
 };
 
+//Prediction of a dry run (--plan)
+struct t_planReport
+{
+    int     clusters;
+    int     chunkClusters;
+    quint64 files;
+    quint64 chunks;
+    quint64 payloadBytes;   //Data of the members
+    quint64 uploadBytes;    //Size of the archives
+    quint64 paddingBytes;   //Padding of the last SIA chunk of each archive
+};
+
 class DataBase : public QObject
 {
     Q_OBJECT
@@ -72,30 +229,92 @@ public:
     void unload(void);
     bool setupDataBase(void);
     void getDirList(QStringList *dirList);
-    void buildTemporaryTable(const QString currentDir, const QStringList *fileList);
+    void getFileList(const QString dir, QFileInfoList *fileList);
+    void planProgress(const QStringList *dirList);
+    quint64 getDirSize(const QFileInfoList *fileList);
+    void buildTemporaryTable(const QString currentDir, const QFileInfoList *fileList);
     void syncDataBase(const QString currentDir);
+    void syncDirPool(const QString poolDir, const QMap<QString, QFileInfoList> pooledDirs);
     QByteArray getFileHash(const QString str_file);
     void setSyncData(const t_SyncData *syncData);
     t_SyncData getSyncData(void) const;
+    void setSharedRoots(const bool sharedRoots);
+    void setCarryTail(const bool carryTail);
+    void setPlanMode(const bool planMode);
+    void printPlan(void);
+    void printLocality(void);
+    void flushDeleteQueue(void);
+    void collectGarbage(void);
+    bool restoreFiles(const QString prefix, const QString outputDir);
+    void resumeJournal(void);
+    void drainJournal(void);
+    void restoreUploadRate(void);
+protected:
+    //Engines timed one by one by the micro-benchmarks (tools/microbench)
+    QSqlQuery execQuery(const QString sql);
+    void resetTemporaryTable(void);
+    void syncTables(void);
+    QLinkedList<t_IndexTable> lookForDeletedFiles(const QString dir);
+    QLinkedList<t_IndexTable> lookForChangedFiles(const QString dir);
+    void buildClusterFilesList(const QString currentDir, ClusterCandidates *outCandidates);
 private:
+    void fillTemporaryTable(const QString currentDir, const QFileInfoList *fileList);
     void deleteProcedure(const QString currentDir);
     void changeProcedure(const QString currentDir);
     void appendProcedure(const QString currentDir);
     t_clusterInfo buildCluster(const QString currentDir);
-    void resetTemporaryTable(void);
-    QLinkedList<t_IndexTable> lookForDeletedFiles(const QString dir);
-    QLinkedList<t_IndexTable> lookForChangedFiles(const QString dir);
-    void deleteCluster(const QString cluster);
-    void deleteSmallerCluster(const QString dir);
-    void syncTables(void);
+    void dedupProcedure(const QString currentDir);
+    void resolveDuplicates(const QString currentDir);
+    int dedupFromIndex(const QString table, const QString currentDir);
+    QString getDedupMaxSize(void);
+    void chunkProcedure(const QString currentDir, ChunkBuilder *chunkBuilder, const quint64 minSize);
+    void uploadChunkClusters(const QString currentDir, const quint64 keepBytes);
+    bool chunkFile(ChunkBuilder *chunkBuilder, const t_IndexTable entry);
+    bool planChunks(const quint32 chunkSize, const t_IndexTable entry);
+    void promoteChunkedFiles(void);
+    void discardChunkedFile(const QString source);
+    bool isChunkKnown(const QString hash);
+    t_clusterInfo buildChunkCluster(const QString currentDir);
+    void releaseChunkedFile(const QString source);
+    QString planClusterId(void);
+    void planCluster(const t_archiveInfo archiveInfo, const quint64 payloadBytes, const bool chunkCluster);
+    QList<t_restoreEntry> lookForRestoreFiles(const QString prefix);
+    bool deleteCluster(const QString cluster);
+    void tombstoneFile(const t_IndexTable entry);
+    void compactProcedure(const QString currentDir);
+    void evictCluster(const QString cluster, const QString target);
+    void queueDelete(const QString target);
+    void journalCluster(t_clusterInfo *clusterInfo, const int kind);
+    void releaseJournal(const t_clusterInfo clusterInfo);
+    bool dropJournal(const QString cluster);
+    void rollbackCluster(const QString cluster, const QString target, const int kind);
+    void cleanJournalDir(void);
+    bool deferUpload(void);
+    quint64 getJournalBytes(void);
+    QString getCachedHash(const QFileInfo file, const bool thisRunOnly);
+    void defragProcedure(const QString dir);
     int getFileCountInTempTable(void);
-    void buildClusterFilesList(const QString currentDir, QLinkedList<t_IndexTable*> *outDataList, QStringList *outStrList);
-    t_clusterInfo makeClusterFile(const QString currentDir, QLinkedList<t_IndexTable*> *inDataList, QStringList *inStrList);
+    quint64 getFileBytesInTempTable(void);
+    int getChunkCountInTempTable(void);
+    quint64 getChunkBytesInTempTable(void);
+    quint64 getPackingLimit(void);
+    t_archiveInfo createSolidTar(const QStringList *srcFiles);
+    t_clusterInfo makeClusterFile(const QString currentDir, ClusterCandidates *candidates);
 
     SIACom         *m_siaCom;
     QSqlDatabase    m_sqlDb;
     t_SyncData      m_syncData;
     ArchiveBuilder *m_archiveBuilder;
+    CompressionPolicy *m_compressionPolicy;
+    quint64         m_defragBytes;
+    bool            m_sharedRoots;  //The clusters can hold the files of several source roots
+    bool            m_carryTail;    //The last partial cluster is left to the next source root
+    quint64         m_solidInBytes; //Solid mode : tar bytes and compressed bytes of the clusters already built (observed ratio)
+    quint64         m_solidOutBytes;
+    bool            m_planMode;     //Dry run : no archive, no upload, no delete, the database is a snapshot
+    t_planReport    m_planReport;
+    QStringList     m_dedupDirs;    //Pooled directorys : the directorys whose clusters can be referenced by the deduplication
+    ClusterCandidates m_candidates;//Reused for each cluster
 };
 
 #endif // DATABASE_H
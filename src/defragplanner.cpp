@@ -0,0 +1,64 @@
+#include "defragplanner.h"
+
+DefragPlanner::DefragPlanner(const quint64 clusterSize, const double uploadCost, QObject *parent) : QObject(parent)
+{
+    m_clusterSize = clusterSize;
+    m_uploadCost  = uploadCost;
+}
+
+quint64 DefragPlanner::storedSize(const quint64 bytes) const
+{
+    //Size really used on SIA (rounded up to the cluster size)
+    if(bytes == 0)
+        return 0;
+
+    return ((bytes + m_clusterSize - 1) / m_clusterSize) * m_clusterSize;
+}
+
+qint64 DefragPlanner::gain(const quint64 pendingBytes, const quint64 mergedBytes, const int mergedCount) const
+{
+    qint64 paddingSaved;
+
+    //Before : the pending clusters + one padded cluster per candidate, after : everything packed together
+    paddingSaved = (qint64)(this->storedSize(pendingBytes) + mergedCount * m_clusterSize) - (qint64)this->storedSize(pendingBytes + mergedBytes);
+
+    return paddingSaved - (qint64)(m_uploadCost * mergedBytes);
+}
+
+t_defragPlan DefragPlanner::plan(const quint64 pendingBytes, const QList<t_defragCandidate> candidates, const quint64 budget) const
+{
+    t_defragPlan    defragPlan;
+    quint64         mergedBytes(0);
+    qint64          bestGain(0), newGain;
+    int             mergedCount(0);
+
+    defragPlan.reuploadBytes = 0;
+    defragPlan.paddingSaved  = 0;
+
+    //The candidates are ordered by live size (the smallest cluster waste the most padding per byte uploaded again)
+    foreach(t_defragCandidate candidate, candidates)
+    {
+        if(candidate.liveSize >= m_clusterSize)
+            continue;
+
+        if((mergedBytes + candidate.liveSize) > budget)
+            break;
+
+        newGain = this->gain(pendingBytes, mergedBytes + candidate.liveSize, mergedCount + 1);
+
+        //Keep the candidate only if the whole plan is better with it
+        if(newGain <= bestGain)
+            continue;
+
+        bestGain    =  newGain;
+        mergedBytes += candidate.liveSize;
+        mergedCount++;
+
+        defragPlan.clusters << candidate;
+    }
+
+    defragPlan.reuploadBytes = mergedBytes;
+    defragPlan.paddingSaved  = (quint64)(bestGain + (qint64)(m_uploadCost * mergedBytes));
+
+    return defragPlan;
+}
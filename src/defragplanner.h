@@ -0,0 +1,37 @@
+#ifndef DEFRAGPLANNER_H
+#define DEFRAGPLANNER_H
+
+#include <QObject>
+#include <QList>
+#include <QString>
+
+struct t_defragCandidate
+{
+    QString cluster;
+    QString target;
+    quint64 liveSize;
+};
+
+struct t_defragPlan
+{
+    QList<t_defragCandidate> clusters;  //Clusters to merge in the new ones
+    quint64                  reuploadBytes;
+    quint64                  paddingSaved;
+};
+
+//SIA pad each cluster to a multiple of the cluster size, so an under-filled cluster waste the remaining space
+//The planner only merge the under-filled clusters when the padding saved is worth the bytes uploaded again
+class DefragPlanner : public QObject
+{
+public:
+    DefragPlanner(const quint64 clusterSize, const double uploadCost, QObject *parent = 0);
+    t_defragPlan plan(const quint64 pendingBytes, const QList<t_defragCandidate> candidates, const quint64 budget) const;
+    quint64 storedSize(const quint64 bytes) const;
+private:
+    qint64 gain(const quint64 pendingBytes, const quint64 mergedBytes, const int mergedCount) const;
+
+    quint64 m_clusterSize;
+    double  m_uploadCost;
+};
+
+#endif // DEFRAGPLANNER_H
@@ -0,0 +1,212 @@
+#include "metrics.h"
+
+t_stageCounters Metrics::m_stages[(int)Stage::COUNT];
+QElapsedTimer   Metrics::m_runTimer;
+QElapsedTimer   Metrics::m_writeTimer;
+QAtomicInt      Metrics::m_writing;
+
+void Metrics::add(const Stage stage, const quint64 files, const quint64 bytes)
+{
+    m_stages[(int)stage].files.fetchAndAddRelaxed(files);
+    m_stages[(int)stage].bytes.fetchAndAddRelaxed(bytes);
+}
+
+void Metrics::addTime(const Stage stage, const quint64 wallUs, const quint64 cpuUs)
+{
+    m_stages[(int)stage].calls.fetchAndAddRelaxed(1);
+    m_stages[(int)stage].wallUs.fetchAndAddRelaxed(wallUs);
+    m_stages[(int)stage].cpuUs.fetchAndAddRelaxed(cpuUs);
+}
+
+void Metrics::setQueueDepth(const Stage stage, const quint64 depth)
+{
+    quint64 maxDepth(m_stages[(int)stage].maxQueueDepth.load());
+
+    m_stages[(int)stage].queueDepth.store(depth);
+
+    //Another thread can raise the max at the same time
+    while((depth > maxDepth) && (!m_stages[(int)stage].maxQueueDepth.testAndSetRelaxed(maxDepth, depth)))
+        maxDepth = m_stages[(int)stage].maxQueueDepth.load();
+}
+
+void Metrics::addTotal(const Stage stage, const quint64 files, const quint64 bytes)
+{
+    m_stages[(int)stage].totalFiles.fetchAndAddRelaxed(files);
+    m_stages[(int)stage].totalBytes.fetchAndAddRelaxed(bytes);
+}
+
+void Metrics::removeTotal(const Stage stage, const quint64 files, const quint64 bytes)
+{
+    //Work planned but not needed (ex : the hash is in the cache)
+    m_stages[(int)stage].totalFiles.fetchAndAddRelaxed(0 - files);
+    m_stages[(int)stage].totalBytes.fetchAndAddRelaxed(0 - bytes);
+}
+
+void Metrics::setActiveBytes(const Stage stage, const quint64 bytes)
+{
+    m_stages[(int)stage].activeBytes.store(bytes);
+}
+
+t_stageSample Metrics::sample(const Stage stage)
+{
+    t_stageSample stageSample;
+
+    stageSample.files      = m_stages[(int)stage].files.load();
+    stageSample.bytes      = m_stages[(int)stage].bytes.load() + m_stages[(int)stage].activeBytes.load();
+    stageSample.totalFiles = m_stages[(int)stage].totalFiles.load();
+    stageSample.totalBytes = m_stages[(int)stage].totalBytes.load();
+
+    return stageSample;
+}
+
+QString Metrics::stageName(const Stage stage)
+{
+    switch(stage)
+    {
+    case Stage::SCAN:   return QString("scan");
+    case Stage::HASH:   return QString("hash");
+    case Stage::SQL:    return QString("sql");
+    case Stage::PACK:   return QString("pack");
+    case Stage::TAR:    return QString("tar");
+    case Stage::ZIP:    return QString("zip");
+    case Stage::UPLOAD: return QString("upload");
+    default:            return QString("unknown");
+    }
+}
+
+QJsonObject Metrics::toJson(void)
+{
+    QJsonObject root;
+    QJsonObject stages;
+    QJsonObject stageObj;
+    Stage       stage;
+
+    for(int i(0); i < (int)Stage::COUNT; i++)
+    {
+        stage = (Stage)i;
+
+        stageObj = QJsonObject();
+        stageObj.insert("files", (qint64)m_stages[i].files.load());
+        stageObj.insert("bytes", (qint64)m_stages[i].bytes.load());
+        stageObj.insert("calls", (qint64)m_stages[i].calls.load());
+        stageObj.insert("wall_seconds", m_stages[i].wallUs.load() / 1000000.0);
+        stageObj.insert("cpu_seconds", m_stages[i].cpuUs.load() / 1000000.0);
+        stageObj.insert("queue_depth", (qint64)m_stages[i].queueDepth.load());
+        stageObj.insert("max_queue_depth", (qint64)m_stages[i].maxQueueDepth.load());
+        stageObj.insert("total_files", (qint64)m_stages[i].totalFiles.load());
+        stageObj.insert("total_bytes", (qint64)m_stages[i].totalBytes.load());
+
+        stages.insert(Metrics::stageName(stage), stageObj);
+    }
+
+    root.insert("run_seconds", m_runTimer.isValid() ? (m_runTimer.elapsed() / 1000.0) : 0.0);
+    root.insert("stages", stages);
+
+    return root;
+}
+
+QString Metrics::toPrometheus(void)
+{
+    QString text;
+
+    //Textfile collector format (node_exporter)
+    text += "# HELP "+ METRICS_PREFIX +"run_seconds Wall time of the current run.\n";
+    text += "# TYPE "+ METRICS_PREFIX +"run_seconds gauge\n";
+    text += METRICS_PREFIX +"run_seconds "+ QString::number(m_runTimer.isValid() ? (m_runTimer.elapsed() / 1000.0) : 0.0) +"\n";
+
+    Metrics::appendFamily(&text, "stage_files_total", "Files handled by the stage.", "counter", &t_stageCounters::files, 1.0);
+    Metrics::appendFamily(&text, "stage_bytes_total", "Bytes handled by the stage.", "counter", &t_stageCounters::bytes, 1.0);
+    Metrics::appendFamily(&text, "stage_calls_total", "Timed calls of the stage.", "counter", &t_stageCounters::calls, 1.0);
+    Metrics::appendFamily(&text, "stage_wall_seconds_total", "Wall time spent in the stage.", "counter", &t_stageCounters::wallUs, 1000000.0);
+    Metrics::appendFamily(&text, "stage_cpu_seconds_total", "CPU time of the process while in the stage.", "counter", &t_stageCounters::cpuUs, 1000000.0);
+    Metrics::appendFamily(&text, "stage_queue_depth", "Items waiting in the stage.", "gauge", &t_stageCounters::queueDepth, 1.0);
+    Metrics::appendFamily(&text, "stage_max_queue_depth", "Most items waiting in the stage during the run.", "gauge", &t_stageCounters::maxQueueDepth, 1.0);
+    Metrics::appendFamily(&text, "stage_planned_files", "Files planned for the stage (0 if unknown).", "gauge", &t_stageCounters::totalFiles, 1.0);
+    Metrics::appendFamily(&text, "stage_planned_bytes", "Bytes planned for the stage (0 if unknown).", "gauge", &t_stageCounters::totalBytes, 1.0);
+
+    return text;
+}
+
+void Metrics::appendFamily(QString *text, const QString name, const QString help, const QString type, QAtomicInteger<quint64> t_stageCounters::*counter, const double divisor)
+{
+    (*text) += "# HELP "+ METRICS_PREFIX + name +" "+ help +"\n";
+    (*text) += "# TYPE "+ METRICS_PREFIX + name +" "+ type +"\n";
+
+    //One sample by stage
+    for(int i(0); i < (int)Stage::COUNT; i++)
+        (*text) += METRICS_PREFIX + name +"{stage=\""+ Metrics::stageName((Stage)i) +"\"} "+ QString::number((m_stages[i].*counter).load() / divisor, 'f', (divisor > 1.0) ? 6 : 0) +"\n";
+}
+
+bool Metrics::write(void)
+{
+    QSaveFile   jsonFile(Config::getMetricsPath() +"/"+ METRICS_JSON_FILE);
+    QSaveFile   promFile(Config::getMetricsPath() +"/"+ METRICS_PROM_FILE);
+    bool        result(true);
+
+    //Disabled
+    if(Config::getMetricsPath().isEmpty())
+        return true;
+
+    QDir().mkpath(Config::getMetricsPath());
+
+    //The files are replaced at once (a reader never see an half written file)
+    if(jsonFile.open(QIODevice::WriteOnly))
+    {
+        jsonFile.write(QJsonDocument(Metrics::toJson()).toJson());
+        result &= jsonFile.commit();
+    }
+    else
+        result = false;
+
+    if(promFile.open(QIODevice::WriteOnly))
+    {
+        promFile.write(Metrics::toPrometheus().toUtf8());
+        result &= promFile.commit();
+    }
+    else
+        result = false;
+
+    if(!result)
+        qWarning("Cannot write the metrics files !");
+
+    return result;
+}
+
+void Metrics::tick(void)
+{
+    //Only one thread write the files
+    if(!m_writing.testAndSetOrdered(0, 1))
+        return;
+
+    if(!m_runTimer.isValid())
+    {
+        m_runTimer.start();
+        m_writeTimer.start();
+    }
+    else if(m_writeTimer.elapsed() >= (qint64)Config::getMetricsInterval() * 1000)
+    {
+        Metrics::write();
+        m_writeTimer.restart();
+    }
+
+    m_writing.store(0);
+}
+
+StageTimer::StageTimer(const Stage stage)
+{
+    m_stage     = stage;
+    m_cpuStart  = std::clock();
+    m_wallTimer.start();
+}
+
+StageTimer::~StageTimer(void)
+{
+    quint64 cpuUs(0);
+    std::clock_t cpuEnd(std::clock());
+
+    //The CPU time is the one of the whole process (the other threads are counted too)
+    if((m_cpuStart != (std::clock_t)-1) && (cpuEnd >= m_cpuStart))
+        cpuUs = (quint64)((cpuEnd - m_cpuStart) * (1000000.0 / CLOCKS_PER_SEC));
+
+    Metrics::addTime(m_stage, m_wallTimer.nsecsElapsed() / 1000, cpuUs);
+}
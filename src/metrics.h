@@ -0,0 +1,93 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include "config.h"
+#include <QObject>
+#include <QAtomicInteger>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QDir>
+#include <ctime>
+
+#define METRICS_JSON_FILE   QString("sia_chunk_backup.json")
+#define METRICS_PROM_FILE   QString("sia_chunk_backup.prom")
+#define METRICS_PREFIX      QString("sia_chunk_backup_")
+
+enum class Stage : int
+{
+    SCAN,
+    HASH,
+    SQL,
+    PACK,
+    TAR,
+    ZIP,
+    UPLOAD,
+    COUNT
+};
+
+//Totals of one stage (updated from any thread without lock)
+struct t_stageCounters
+{
+    QAtomicInteger<quint64> files;
+    QAtomicInteger<quint64> bytes;
+    QAtomicInteger<quint64> calls;
+    QAtomicInteger<quint64> wallUs;
+    QAtomicInteger<quint64> cpuUs;
+    QAtomicInteger<quint64> queueDepth;
+    QAtomicInteger<quint64> maxQueueDepth;
+    QAtomicInteger<quint64> totalFiles;//Known after the planning (0 => unknown)
+    QAtomicInteger<quint64> totalBytes;
+    QAtomicInteger<quint64> activeBytes;//Bytes of the work in progress (not counted in bytes yet)
+};
+
+//Copy of the counters of one stage at a given time
+struct t_stageSample
+{
+    quint64 files;
+    quint64 bytes;
+    quint64 totalFiles;
+    quint64 totalBytes;
+};
+
+//Time and counters spent in each stage of a run
+//The stages can be nested (the SQL queries of the packing are counted in both), the wall times are not meant to be summed
+class Metrics
+{
+public:
+    static void add(const Stage stage, const quint64 files, const quint64 bytes);
+    static void addTime(const Stage stage, const quint64 wallUs, const quint64 cpuUs);
+    static void setQueueDepth(const Stage stage, const quint64 depth);
+    static void addTotal(const Stage stage, const quint64 files, const quint64 bytes);
+    static void removeTotal(const Stage stage, const quint64 files, const quint64 bytes);
+    static void setActiveBytes(const Stage stage, const quint64 bytes);
+    static t_stageSample sample(const Stage stage);
+    static QString stageName(const Stage stage);
+    static QJsonObject toJson(void);
+    static QString toPrometheus(void);
+    static bool write(void);
+    static void tick(void);
+private:
+    static void appendFamily(QString *text, const QString name, const QString help, const QString type, QAtomicInteger<quint64> t_stageCounters::*counter, const double divisor);
+
+    static t_stageCounters  m_stages[(int)Stage::COUNT];
+    static QElapsedTimer    m_runTimer;
+    static QElapsedTimer    m_writeTimer;
+    static QAtomicInt       m_writing;
+};
+
+//Time one call of a stage (wall and CPU time) from its creation to its destruction
+class StageTimer
+{
+public:
+    StageTimer(const Stage stage);
+    ~StageTimer(void);
+private:
+    Stage           m_stage;
+    QElapsedTimer   m_wallTimer;
+    std::clock_t    m_cpuStart;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,127 @@
+#include "progressreporter.h"
+
+ProgressReporter::ProgressReporter(const int intervalSec, QObject *parent) : QThread(parent)
+{
+    m_intervalMs = intervalSec * 1000;
+
+    for(int i(0); i < (int)Stage::COUNT; i++)
+    {
+        m_progress[i].lastBytes   = 0;
+        m_progress[i].bytesPerSec = 0.0;
+    }
+}
+
+void ProgressReporter::stop(void)
+{
+    this->requestInterruption();
+    this->wait();
+}
+
+void ProgressReporter::run(void)
+{
+    QElapsedTimer   intervalTimer;
+    QStringList     lines;
+    QString         line;
+    const Stage     STAGES[] = {Stage::SCAN, Stage::HASH, Stage::UPLOAD};
+    const int       STAGE_COUNT(sizeof(STAGES) / sizeof(Stage));
+
+    intervalTimer.start();
+
+    while(!this->isInterruptionRequested())
+    {
+        //Short sleeps to stop quickly at the end of the run
+        QThread::msleep(PROGRESS_SLEEP_MS);
+
+        //The metrics files are written even while no stage is timed (e.g. a long upload)
+        Metrics::tick();
+
+        //No progress log
+        if((m_intervalMs <= 0) || (intervalTimer.elapsed() < m_intervalMs))
+            continue;
+
+        lines.clear();
+
+        for(int i(0); i < STAGE_COUNT; i++)
+        {
+            line = this->report(STAGES[i], intervalTimer.elapsed() / 1000.0);
+
+            if(!line.isEmpty())
+                lines << line;
+        }
+
+        intervalTimer.restart();
+
+        if(!lines.isEmpty())
+            qInfo(QString("Progress : "+ lines.join(" | ")).toUtf8());
+    }
+}
+
+QString ProgressReporter::report(const Stage stage, const double elapsedSec)
+{
+    t_stageSample   sample(Metrics::sample(stage));
+    t_stageProgress *progress(&m_progress[(int)stage]);
+    double          intervalRate(0.0);
+    double          remaining(0.0);
+    QString         line;
+
+    //Nothing planned and nothing done
+    if((sample.totalFiles == 0) && (sample.totalBytes == 0) && (sample.files == 0))
+        return QString();
+
+    if((elapsedSec > 0.0) && (sample.bytes >= progress->lastBytes))
+        intervalRate = (sample.bytes - progress->lastBytes) / elapsedSec;
+
+    //Smoothed to keep a stable remaining time (the uploads progress by steps)
+    if(progress->lastBytes == 0)
+        progress->bytesPerSec = intervalRate;
+    else
+        progress->bytesPerSec = (PROGRESS_RATE_SMOOTHING * intervalRate) + ((1.0 - PROGRESS_RATE_SMOOTHING) * progress->bytesPerSec);
+
+    progress->lastBytes = sample.bytes;
+
+    line = Metrics::stageName(stage) +" "+ QString::number(sample.files);
+
+    if(sample.totalFiles > 0)
+        line += "/"+ QString::number(sample.totalFiles);
+
+    line += " files";
+
+    //Without the planned bytes only the throughput is known
+    if(sample.totalBytes == 0)
+        return line +" "+ ProgressReporter::formatBytes(progress->bytesPerSec) +"/s";
+
+    if(sample.bytes < sample.totalBytes)
+        remaining = sample.totalBytes - sample.bytes;
+
+    line += " "+ ProgressReporter::formatBytes(sample.bytes) +"/"+ ProgressReporter::formatBytes(sample.totalBytes);
+    line += QString(" (%1%)").arg(qMin(100.0, (100.0 * sample.bytes) / sample.totalBytes), 0, 'f', 1);
+    line += " "+ ProgressReporter::formatBytes(progress->bytesPerSec) +"/s";
+    line += " ETA "+ ((progress->bytesPerSec > 0.0) ? ProgressReporter::formatEta(remaining / progress->bytesPerSec) : QString("--:--:--"));
+
+    return line;
+}
+
+QString ProgressReporter::formatBytes(const double bytes)
+{
+    if(bytes >= 1e9)
+        return QString::number(bytes / 1e9, 'f', 2) +" GB";
+
+    if(bytes >= 1e6)
+        return QString::number(bytes / 1e6, 'f', 1) +" MB";
+
+    if(bytes >= 1e3)
+        return QString::number(bytes / 1e3, 'f', 1) +" kB";
+
+    return QString::number(bytes, 'f', 0) +" B";
+}
+
+QString ProgressReporter::formatEta(const double seconds)
+{
+    quint64 total((quint64)seconds);
+
+    //More than the next nightly window anyway
+    if(seconds >= 360000.0)
+        return QString(">100h");
+
+    return QString("%1:%2:%3").arg(total / 3600, 2, 10, QChar('0')).arg((total / 60) % 60, 2, 10, QChar('0')).arg(total % 60, 2, 10, QChar('0'));
+}
@@ -0,0 +1,39 @@
+#ifndef PROGRESSREPORTER_H
+#define PROGRESSREPORTER_H
+
+#include "metrics.h"
+#include <QThread>
+#include <QElapsedTimer>
+#include <QStringList>
+
+//Weight of the last interval in the smoothed throughput
+#define PROGRESS_RATE_SMOOTHING 0.3
+
+#define PROGRESS_SLEEP_MS 200
+
+//Throughput and remaining time of a stage since the last report
+struct t_stageProgress
+{
+    quint64 lastBytes;
+    double  bytesPerSec;
+};
+
+//Log at a fixed interval the progress of the stages which have a planned total, and write the metrics files at their interval
+//The counters are only read (atomics of Metrics), the backup never wait for this thread
+class ProgressReporter : public QThread
+{
+public:
+    explicit ProgressReporter(const int intervalSec, QObject *parent = 0);
+    void stop(void);
+    static QString formatBytes(const double bytes);
+    static QString formatEta(const double seconds);
+protected:
+    void run(void);
+private:
+    QString report(const Stage stage, const double elapsedSec);
+
+    int             m_intervalMs;
+    t_stageProgress m_progress[(int)Stage::COUNT];
+};
+
+#endif // PROGRESSREPORTER_H
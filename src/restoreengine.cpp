@@ -0,0 +1,469 @@
+#include "restoreengine.h"
+
+ExtractTask::ExtractTask(const t_restoreCluster cluster, t_restoreStats *stats)
+{
+    m_cluster = cluster;
+    m_stats   = stats;
+}
+
+void ExtractTask::run(void)
+{
+    struct archive          *archiveTar;
+    struct archive_entry    *entry;
+    QString                 member;
+    QList<t_restoreEntry>   entries;
+    QString                 tarPath(m_cluster.archivePath);
+    quint32                 restored(0), failed(0);
+    bool                    opened(true);
+    const quint32           TOTAL(m_cluster.members.count());
+
+    //A solid cluster is the whole tar compressed at once, it is uncompressed before the extraction
+    if(m_cluster.target.endsWith(SOLID_SUFFIX))
+    {
+        tarPath = m_cluster.archivePath +".tar";
+        opened  = SolidCompressor::uncompress(m_cluster.archivePath, tarPath);
+    }
+
+    archiveTar = archive_read_new();
+    archive_read_support_format_tar(archiveTar);
+
+    if(!opened || (archive_read_open_filename(archiveTar, tarPath.toUtf8().data(), RESTORE_BUFF_BYTE) != ARCHIVE_OK))
+    {
+        qWarning(QString("Cannot open the cluster "+ m_cluster.target).toUtf8());
+        failed = TOTAL;
+    }
+    else
+    {
+        //The tar is read once, only the requested members are written
+        while(archive_read_next_header(archiveTar, &entry) == ARCHIVE_OK)
+        {
+            member  = QString::fromUtf8(archive_entry_pathname(entry));
+            entries = m_cluster.members.values(member);
+
+            //Index made by an older version : no member name, the entry name is the end of the source path
+            if(entries.isEmpty())
+            {
+                foreach(t_restoreEntry legacy, m_cluster.members.values(QString()))
+                {
+                    if(legacy.source.endsWith("/"+ member))
+                        entries << legacy;
+                }
+            }
+
+            if(entries.isEmpty())
+            {
+                archive_read_data_skip(archiveTar);
+                continue;
+            }
+
+            //The first destination is extracted, the other ones (duplicates) are copied from it
+            if(this->writeMember(archiveTar, entries.first(), m_cluster.archivePath +"."+ QString::number(restored + failed)))
+                restored++;
+            else
+                failed++;
+
+            for(int i(1); i < entries.count(); i++)
+            {
+                if(entries[i].offset >= 0)
+                {
+                    if(this->copyChunk(entries.first(), entries[i]))
+                        restored++;
+                    else
+                        failed++;
+
+                    continue;
+                }
+
+                QFile::remove(entries[i].destination);
+
+                if(QFile::copy(entries.first().destination, entries[i].destination))
+                    restored++;
+                else
+                    failed++;
+            }
+        }
+
+        //The remaining members are not in the cluster (should never happen)
+        failed = TOTAL - restored;
+    }
+
+    archive_read_free(archiveTar);
+
+    QFile::remove(m_cluster.archivePath);
+
+    if(tarPath != m_cluster.archivePath)
+        QFile::remove(tarPath);
+
+    m_stats->mutex.lock();
+    m_stats->restoredMembers   += restored;
+    m_stats->failedMembers     += failed;
+    m_stats->extractedClusters++;
+    m_stats->mutex.unlock();
+}
+
+bool ExtractTask::writeMember(struct archive *archiveTar, const t_restoreEntry entry, const QString packedPath)
+{
+    QFile   file;
+    CryptoStream    cryptoStream;
+    QByteArray      plain;
+    char            *buff;
+    t_restoreEntry  plainEntry;
+    int             len;
+    bool            packed, encrypted;
+    bool            decrypted(true);
+
+    packed    = ExtractTask::isPacked(entry);
+    encrypted = !entry.cipher.isEmpty();
+
+    //The member is decrypted while it is read (no extra pass)
+    if(encrypted)
+        cryptoStream.beginDecrypt(entry.cipher, CryptoStream::deriveKey(entry.hash));
+
+    //The plaintext of an encrypted member is only trusted after the check of its tag, it is written in a temporary file until then
+    if(packed || encrypted)
+    {
+        file.setFileName(packedPath);
+        file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+    //A chunk is written at its place in the file (the file is shared by the chunks of several clusters)
+    else if(entry.offset >= 0)
+    {
+        file.setFileName(entry.destination);
+        file.open(QIODevice::ReadWrite);
+        file.seek(entry.offset);
+    }
+    else
+    {
+        file.setFileName(entry.destination);
+        file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+    }
+
+    if(!file.isOpen())
+    {
+        qWarning(QString("Cannot write "+ file.fileName()).toUtf8());
+        archive_read_data_skip(archiveTar);
+        return false;
+    }
+
+    buff = new char[RESTORE_BUFF_BYTE];
+
+    len = archive_read_data(archiveTar, buff, RESTORE_BUFF_BYTE);
+    while(len > 0)
+    {
+        if(entry.cipher.isEmpty())
+            file.write(buff, len);
+        else if(decrypted && cryptoStream.update(buff, len, &plain))
+            file.write(plain);
+        else
+            decrypted = false;
+
+        len = archive_read_data(archiveTar, buff, RESTORE_BUFF_BYTE);
+    }
+
+    if(!entry.cipher.isEmpty() && decrypted)
+        decrypted = cryptoStream.finish(&plain);
+
+    delete[] buff;
+    file.close();
+
+    if(len < 0)
+    {
+        qWarning(QString("Cannot read "+ entry.member +" in "+ m_cluster.target +" : "+ QString(archive_error_string(archiveTar))).toUtf8());
+
+        if(packed || encrypted)
+            QFile::remove(packedPath);
+
+        return false;
+    }
+
+    if(!decrypted)
+    {
+        qWarning(QString("Cannot decrypt "+ entry.member +" in "+ m_cluster.target +" (wrong key or altered data)").toUtf8());
+        QFile::remove(packedPath);
+        return false;
+    }
+
+    if(packed)
+    {
+        len = this->unpackMember(packedPath, entry.destination);
+        QFile::remove(packedPath);
+
+        return (len != 0);
+    }
+
+    if(!encrypted)
+        return true;
+
+    //A chunk is copied at its place in the shared file, a whole file replace the destination
+    if(entry.offset >= 0)
+    {
+        plainEntry             = entry;
+        plainEntry.destination = packedPath;
+        plainEntry.offset      = 0;
+
+        decrypted = this->copyChunk(plainEntry, entry);
+    }
+    else
+    {
+        QFile::remove(entry.destination);
+        decrypted = QFile::rename(packedPath, entry.destination);
+    }
+
+    QFile::remove(packedPath);
+
+    return decrypted;
+}
+
+bool ExtractTask::isPacked(const t_restoreEntry entry)
+{
+    //The decision recorded with the member (a file named *.zip is not packed without compression mode)
+    if(entry.compression == COMPRESSION_DEFLATE)
+        return true;
+
+    if(!entry.compression.isEmpty())
+        return false;
+
+    //Index made by an older version : in compression mode the member is a zip (gzip on windows) of the file
+    return (entry.offset < 0) && (entry.member.endsWith(".zip") || entry.member.endsWith(".gz"));
+}
+
+bool ExtractTask::unpackMember(const QString packedPath, const QString dstPath)
+{
+    struct archive          *archivePacked;
+    struct archive_entry    *entry;
+    QFile                   file;
+    char                    *buff;
+    int                     len(-1);
+
+    archivePacked = archive_read_new();
+    archive_read_support_filter_all(archivePacked);
+    archive_read_support_format_zip(archivePacked);
+    archive_read_support_format_raw(archivePacked);//A gzip file is a raw stream after the filter
+
+    if((archive_read_open_filename(archivePacked, packedPath.toUtf8().data(), RESTORE_BUFF_BYTE) == ARCHIVE_OK) &&
+       (archive_read_next_header(archivePacked, &entry) == ARCHIVE_OK))
+    {
+        file.setFileName(dstPath);
+        file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+
+        buff = new char[RESTORE_BUFF_BYTE];
+
+        len = archive_read_data(archivePacked, buff, RESTORE_BUFF_BYTE);
+        while(len > 0)
+        {
+            file.write(buff, len);
+            len = archive_read_data(archivePacked, buff, RESTORE_BUFF_BYTE);
+        }
+
+        delete[] buff;
+        file.close();
+    }
+
+    if(len < 0)
+        qWarning(QString("Cannot uncompress "+ dstPath +" : "+ QString(archive_error_string(archivePacked))).toUtf8());
+
+    archive_read_free(archivePacked);
+
+    return (len == 0);
+}
+
+bool ExtractTask::copyChunk(const t_restoreEntry from, const t_restoreEntry to)
+{
+    QFile       srcFile(from.destination);
+    QFile       dstFile(to.destination);
+    QByteArray  chunk;
+
+    //The same chunk can be at several places (in the same file or in another one)
+    if(!srcFile.open(QIODevice::ReadOnly) || !srcFile.seek(from.offset))
+        return false;
+
+    chunk = srcFile.read(from.size);
+    srcFile.close();
+
+    if(!dstFile.open(QIODevice::ReadWrite) || !dstFile.seek(to.offset))
+        return false;
+
+    dstFile.write(chunk);
+    dstFile.close();
+
+    return ((quint64)chunk.size() == to.size);
+}
+
+RestoreEngine::RestoreEngine(SIACom *siaCom, QObject *parent) : QObject(parent)
+{
+    m_siaCom      = siaCom;
+    m_downloadDir = new QTemporaryDir();
+    m_downloadDir->setAutoRemove(true);
+    m_threadPool  = new QThreadPool(this);
+
+    m_stats.restoredMembers   = 0;
+    m_stats.failedMembers     = 0;
+    m_stats.extractedClusters = 0;
+
+    QObject::connect(m_siaCom, SIGNAL(downloaded(QString,QString)), this, SLOT(downloaded(QString,QString)));
+}
+
+RestoreEngine::~RestoreEngine(void)
+{
+    m_threadPool->waitForDone();
+    delete m_downloadDir;
+}
+
+bool RestoreEngine::restore(const QList<t_restoreEntry> entries, const QString prefix, const QString outputDir)
+{
+    t_restoreEntry  restoreEntry;
+    QStringList     siaPaths;
+    QStringList     dstPaths;
+    QStringList     done;
+    QFile           file;
+    int             rangedClusters(0);
+
+    if(entries.isEmpty())
+    {
+        qWarning(QString("No file to restore under "+ prefix).toUtf8());
+        return false;
+    }
+
+    //Group the members by cluster, so each cluster is downloaded once
+    foreach(t_restoreEntry entry, entries)
+    {
+        restoreEntry             = entry;
+        restoreEntry.destination = this->getDestination(entry.source, prefix, outputDir);
+
+        if(!m_clusters.contains(entry.target))
+        {
+            m_clusters[entry.target].target      = entry.target;
+            m_clusters[entry.target].archivePath = m_downloadDir->path() +"/"+ entry.cluster;
+
+            siaPaths << entry.target;
+            dstPaths << m_clusters[entry.target].archivePath;
+        }
+
+        m_clusters[entry.target].members.insert(entry.member, restoreEntry);
+
+        //The directories and the files made of chunks are created before the extraction threads start
+        QDir().mkpath(QFileInfo(restoreEntry.destination).absolutePath());
+
+        if((entry.offset == 0) || ((entry.offset < 0) && (entry.size == 0)))
+        {
+            file.setFileName(restoreEntry.destination);
+            file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+            file.close();
+        }
+    }
+
+    qInfo(QString("Restore : "+ QString::number(entries.count()) +" members in "+ QString::number(m_clusters.count()) +" clusters to "+ outputDir).toUtf8());
+
+    //The clusters with a few requested members are not downloaded, only the bytes of the members are read
+    foreach(t_restoreCluster cluster, m_clusters)
+    {
+        if(!this->isRangeReadable(cluster))
+            continue;
+
+        this->restoreRanges(cluster);
+
+        dstPaths.removeAt(siaPaths.indexOf(cluster.target));
+        siaPaths.removeOne(cluster.target);
+        rangedClusters++;
+    }
+
+    //Each downloaded cluster is extracted in the thread pool while the next ones are downloading
+    done = m_siaCom->downloadFiles(siaPaths, dstPaths);
+
+    m_threadPool->waitForDone();
+
+    qInfo(QString("Restore : Result "+ QString::number(done.count()) +"/"+ QString::number(siaPaths.count()) +" clusters downloaded, "+ QString::number(rangedClusters) +" read by ranges, "
+                  + QString::number(m_stats.restoredMembers) +" members restored, "+ QString::number(m_stats.failedMembers) +" failed.").toUtf8());
+
+    return (done.count() == siaPaths.count()) && (m_stats.failedMembers == 0);
+}
+
+void RestoreEngine::downloaded(const QString siaPath, const QString dstPath)
+{
+    Q_UNUSED(dstPath);
+
+    if(!m_clusters.contains(siaPath))
+        return;
+
+    m_threadPool->start(new ExtractTask(m_clusters.value(siaPath), &m_stats));
+}
+
+bool RestoreEngine::isRangeReadable(const t_restoreCluster cluster)
+{
+    if(cluster.members.count() >= RESTORE_MAX_RANGED_MEMBERS)
+        return false;
+
+    //The members of a solid cluster are only in the compressed stream
+    if(cluster.target.endsWith(SOLID_SUFFIX))
+        return false;
+
+    //Only the whole files with a known position (a lone oversized file is better downloaded)
+    foreach(t_restoreEntry entry, cluster.members)
+    {
+        if((entry.offset >= 0) || (entry.dataOffset < 0) || (entry.dataLength >= Config::getClusterSize()))
+            return false;
+    }
+
+    return true;
+}
+
+void RestoreEngine::restoreRanges(const t_restoreCluster cluster)
+{
+    QByteArray      data;
+    QByteArray      plain, tail;
+    QFile           file;
+    QString         dstPath;
+    CryptoStream    cryptoStream;
+    bool            restored, readable;
+
+    foreach(t_restoreEntry entry, cluster.members)
+    {
+        restored = false;
+        dstPath  = ExtractTask::isPacked(entry) ? entry.destination +".packed" : entry.destination;
+
+        //One ranged read per member instead of the whole cluster
+        readable = m_siaCom->readRange(entry.target, entry.dataOffset, entry.dataLength, &data);
+
+        //The whole member is in memory, it is decrypted at once
+        if(readable && !entry.cipher.isEmpty())
+        {
+            cryptoStream.beginDecrypt(entry.cipher, CryptoStream::deriveKey(entry.hash));
+
+            readable = cryptoStream.update(data.constData(), data.size(), &plain) && cryptoStream.finish(&tail);
+            data     = plain;
+
+            if(!readable)
+                qWarning(QString("Cannot decrypt "+ entry.member +" in "+ entry.target +" (wrong key or altered data)").toUtf8());
+        }
+
+        if(readable)
+        {
+            file.setFileName(dstPath);
+
+            if(file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+            {
+                restored = (file.write(data) == data.size());
+                file.close();
+            }
+        }
+
+        if(restored && ExtractTask::isPacked(entry))
+        {
+            restored = ExtractTask::unpackMember(dstPath, entry.destination);
+            QFile::remove(dstPath);
+        }
+
+        m_stats.mutex.lock();
+        if(restored)
+            m_stats.restoredMembers++;
+        else
+            m_stats.failedMembers++;
+        m_stats.mutex.unlock();
+    }
+}
+
+QString RestoreEngine::getDestination(const QString source, const QString prefix, const QString outputDir)
+{
+    //The last part of the prefix is kept ("/data/photos" restore "/data/photos/a.jpg" in "<output>/photos/a.jpg")
+    return outputDir +"/"+ source.mid(prefix.section('/', 0, -2).length() + 1);
+}
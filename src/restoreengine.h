@@ -0,0 +1,97 @@
+#ifndef RESTOREENGINE_H
+#define RESTOREENGINE_H
+
+#include "libarchive/archive.h"
+#include "libarchive/archive_entry.h"
+
+#include "config.h"
+#include "siacom.h"
+#include "cryptostream.h"
+#include "compressionpolicy.h"
+#include "solidcompressor.h"
+#include <QObject>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QMutex>
+#include <QMultiHash>
+#include <QTemporaryDir>
+#include <QFileInfo>
+#include <QFile>
+#include <QDir>
+
+#define RESTORE_BUFF_BYTE 65536
+
+//A cluster with less requested members than this is not downloaded, each member is read alone (ranged read)
+#define RESTORE_MAX_RANGED_MEMBERS 8
+
+struct t_restoreEntry
+{
+    QString cluster;
+    QString target;
+    QString source;
+    QString member;
+    qint64  offset;     //Position in the source of a chunk (-1 => the member is the whole file)
+    quint64 size;
+    qint64  dataOffset; //Position of the member data in the cluster (-1 => unknown)
+    quint64 dataLength;
+    QString hash;       //The key of an encrypted member is made from it
+    QString cipher;     //Empty => not encrypted
+    QString compression;//Decision of the compression policy (empty => older index or no compression)
+    QString destination;
+};
+
+struct t_restoreCluster
+{
+    QString                             target;
+    QString                             archivePath;
+    QMultiHash<QString, t_restoreEntry> members;//A member can be restored at several places (deduplicated files)
+};
+
+struct t_restoreStats
+{
+    QMutex  mutex;
+    quint32 restoredMembers;
+    quint32 failedMembers;
+    quint32 extractedClusters;
+};
+
+//Extract the requested members of one downloaded cluster (run in the thread pool)
+class ExtractTask : public QRunnable
+{
+public:
+    ExtractTask(const t_restoreCluster cluster, t_restoreStats *stats);
+    void run(void);
+    static bool isPacked(const t_restoreEntry entry);
+    static bool unpackMember(const QString packedPath, const QString dstPath);
+private:
+    bool writeMember(struct archive *archiveTar, const t_restoreEntry entry, const QString packedPath);
+    bool copyChunk(const t_restoreEntry from, const t_restoreEntry to);
+
+    t_restoreCluster    m_cluster;
+    t_restoreStats      *m_stats;
+};
+
+//Restore the files under a path prefix : each needed cluster is downloaded once (several at the same time)
+//and extracted as soon as it is on the disk, while the other clusters are still downloading
+class RestoreEngine : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RestoreEngine(SIACom *siaCom, QObject *parent = 0);
+    ~RestoreEngine(void);
+    bool restore(const QList<t_restoreEntry> entries, const QString prefix, const QString outputDir);
+private slots:
+    void downloaded(const QString siaPath, const QString dstPath);
+private:
+    QString getDestination(const QString source, const QString prefix, const QString outputDir);
+    bool isRangeReadable(const t_restoreCluster cluster);
+    void restoreRanges(const t_restoreCluster cluster);
+
+    SIACom                              *m_siaCom;
+    QTemporaryDir                       *m_downloadDir;
+    QThreadPool                         *m_threadPool;
+    QHash<QString, t_restoreCluster>    m_clusters;//Key : target on SIA
+    t_restoreStats                      m_stats;
+};
+
+#endif // RESTOREENGINE_H
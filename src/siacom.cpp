@@ -6,6 +6,11 @@ SIACom::SIACom(QObject *parent) : QObject(parent)
     m_netRequest = new QNetworkRequest();
     m_netRequest->setRawHeader("User-Agent", "Sia-Agent");
     m_netRequest->setRawHeader("content-type", "application/x-www-form-urlencoded");
+    m_scheduler    = new UploadScheduler(this);
+    m_appliedRate  = UPLOAD_RATE_UNLIMITED;
+    m_rateApplied  = false;
+    m_previousRate = 0;
+    m_clock.start();
 
     QObject::connect(m_netManager, SIGNAL(finished(QNetworkReply*)), this, SLOT(finished(QNetworkReply*)));
 }
@@ -14,6 +19,10 @@ SIACom::~SIACom(void)
 {
     delete m_netManager;
     delete m_netRequest;
+
+    //The callbacks of the requests not done are never called
+    qDeleteAll(m_requestQueue);
+    qDeleteAll(m_requestInFlight);
 }
 
 void SIACom::finished(QNetworkReply *reply)
@@ -21,30 +30,192 @@ void SIACom::finished(QNetworkReply *reply)
     reply->deleteLater();
 }
 
-bool SIACom::test(void)
+void SIACom::sendAsync(const QUrl url, const bool isPost, t_SiaCallback callback)
 {
-    QNetworkReply *reply;
-    QEventLoop loop;
+    QNetworkRequest request(*m_netRequest);
 
-    m_netRequest->setUrl(SIA_CONSENSUS);
-    reply = m_netManager->get(*m_netRequest);
+    request.setUrl(url);
 
-    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
-    loop.exec();
+    this->sendRequest(request, isPost, Config::getRequestTimeout(), callback);
+}
 
-    if(reply->error() != QNetworkReply::NoError)
-        return false;
+void SIACom::sendRequest(const QNetworkRequest request, const bool isPost, const int timeout, t_SiaCallback callback)
+{
+    t_SiaRequest    *siaRequest;
 
-    return true;
+    siaRequest              = new t_SiaRequest;
+    siaRequest->request     = request;
+    siaRequest->isPost      = isPost;
+    siaRequest->callback    = callback;
+    siaRequest->attempt     = 0;
+    siaRequest->readyAt     = 0;
+    siaRequest->timeout     = timeout;
+
+    m_requestQueue << siaRequest;
+
+    this->dispatchRequests();
 }
 
-bool SIACom::uploadFile(const QString srcPath, const QString siaPath)
+void SIACom::dispatchRequests(void)
+{
+    QNetworkReply   *reply;
+    QTimer          *timeout;
+    t_SiaRequest    *request;
+    int             i(0);
+    const int       MAX_IN_FLIGHT(Config::getRequestParallel());
+
+    //Post the queued requests while a slot is free
+    while((m_requestInFlight.count() < MAX_IN_FLIGHT) && (i < m_requestQueue.count()))
+    {
+        //A retried request waits the end of its backoff
+        if(m_requestQueue[i]->readyAt > m_clock.elapsed())
+        {
+            i++;
+            continue;
+        }
+
+        request = m_requestQueue.takeAt(i);
+        request->attempt++;
+
+        if(request->isPost)
+            reply = m_netManager->post(request->request, QByteArray());
+        else
+            reply = m_netManager->get(request->request);
+
+        m_requestInFlight.insert(reply, request);
+
+        QObject::connect(reply, SIGNAL(finished()), this, SLOT(requestFinished()));
+
+        //At the deadline the reply is aborted (it finish with OperationCanceledError)
+        if(request->timeout > 0)
+        {
+            timeout = new QTimer(reply);
+            timeout->setSingleShot(true);
+            QObject::connect(timeout, SIGNAL(timeout()), reply, SLOT(abort()));
+            timeout->start(request->timeout * 1000);
+        }
+    }
+}
+
+void SIACom::requestFinished(void)
 {
     QNetworkReply   *reply;
+    t_SiaRequest    *request;
+    t_SiaReply      siaReply;
+    int             backoff;
+
+    reply   = qobject_cast<QNetworkReply*>(this->sender());
+    request = m_requestInFlight.take(reply);
+
+    if(request == 0)
+        return;
+
+    siaReply.success    = (reply->error() == QNetworkReply::NoError);
+    siaReply.httpStatus = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    siaReply.body       = reply->readAll();
+    siaReply.message    = QJsonDocument::fromJson(siaReply.body).object().value("message").toString();
+    siaReply.attempts   = request->attempt;
+
+    if((!siaReply.success) && siaReply.message.isEmpty())
+        siaReply.message = (reply->error() == QNetworkReply::OperationCanceledError) ? QString("timeout") : reply->errorString();
+
+    //Only the transient failures are retried (no reply, timeout, server error), not the errors reported by the deamon
+    if((!siaReply.success) && ((siaReply.httpStatus == 0) || (siaReply.httpStatus >= 500)) && (request->attempt <= Config::getRequestRetries()))
+    {
+        //Exponential backoff with jitter : the retries of the parallel requests don't hit the deamon at the same time
+        backoff = Config::getRetryBackoff() << qMin(request->attempt - 1, 10);
+        backoff = (backoff / 2) + (qrand() % (backoff / 2 + 1));
+
+        qWarning(QString(request->request.url().path() +" : "+ siaReply.message +", retry in "+ QString::number(backoff) +" ms").toUtf8());
+
+        request->readyAt = m_clock.elapsed() + backoff;
+        m_requestQueue << request;
+
+        QTimer::singleShot(backoff, this, SLOT(dispatchRequests()));
+    }
+    else
+    {
+        //The reply of a previous attempt of a POST can be lost after the deamon did the work : the upload is already
+        //known (the cluster names are content hashes, the same name is the same content) or the file is already deleted
+        if((!siaReply.success) && request->isPost && (request->attempt > 1) &&
+                (siaReply.message.contains(SIA_MSG_FILE_EXISTS) || siaReply.message.contains(SIA_MSG_UNKNOWN_FILE)))
+        {
+            qInfo(QString(request->request.url().path() +" : "+ siaReply.message +" after a retry, done by a previous attempt").toUtf8());
+            siaReply.success = true;
+        }
+
+        request->callback(siaReply);
+        delete request;
+    }
+
+    this->dispatchRequests();
+}
+
+void SIACom::testAsync(std::function<void(const bool success)> callback)
+{
+    this->sendAsync(SIA_CONSENSUS, false, [callback](const t_SiaReply &reply)
+    {
+        callback(reply.success);
+    });
+}
+
+void SIACom::postUploadAsync(const QString srcPath, const QString siaPath, std::function<void(const bool success)> callback)
+{
+    this->sendAsync(SIA_UPLOAD_FILE(srcPath, siaPath), true, [callback](const t_SiaReply &reply)
+    {
+        if(!reply.success)
+            qInfo(reply.message.toUtf8());
+
+        callback(reply.success);
+    });
+}
+
+void SIACom::uploadFileStatesAsync(const QStringList siaPaths, std::function<void(const QHash<QString, t_UploadStatus> states)> callback)
+{
+    //One list of the renter files for all the paths
+    this->sendAsync(SIA_RENTER_FILES, false, [this, siaPaths, callback](const t_SiaReply &reply)
+    {
+        callback(this->parseUploadStates(reply, siaPaths));
+    });
+}
+
+void SIACom::deleteFileAsync(const QString siaPath, std::function<void(const bool success)> callback)
+{
+    this->sendAsync(SIA_DELETE_FILE(siaPath), true, [callback](const t_SiaReply &reply)
+    {
+        callback(reply.success);
+    });
+}
+
+bool SIACom::test(void)
+{
+    QEventLoop  loop;
+    bool        done(false), result(false);
+
+    this->testAsync([&](const bool success)
+    {
+        result = success;
+        done   = true;
+        loop.quit();
+    });
+
+    if(!done)
+        loop.exec();
+
+    return result;
+}
+
+bool SIACom::uploadFile(const QString srcPath, const QString siaPath)
+{
     QEventLoop      loop;
-    QJsonObject     jsonObj;
     t_UploadStatus  uploadStatus;
     double          oldValue(100.0);
+    StageTimer      stageTimer(Stage::UPLOAD);
+
+    Metrics::setQueueDepth(Stage::UPLOAD, 1);
+
+    //Nothing is sent outside of the upload windows
+    this->waitUploadWindow();
 
     //Get the file status
     uploadStatus = this->uploadFileState(siaPath);
@@ -52,17 +223,9 @@ bool SIACom::uploadFile(const QString srcPath, const QString siaPath)
     //Check is the file is currently in uload state
     if(uploadStatus.inUploading == false)
     {
-        m_netRequest->setUrl(SIA_UPLOAD_FILE(srcPath, siaPath));
-        reply = m_netManager->post(*m_netRequest, QByteArray());
-
-        QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
-        loop.exec();
-
-        jsonObj = QJsonDocument::fromJson(reply->readAll()).object();
-
-        if(reply->error() != QNetworkReply::NoError)
+        if(!this->postUpload(srcPath, siaPath))
         {
-            qInfo(jsonObj.value("message").toString().toUtf8());
+            Metrics::setQueueDepth(Stage::UPLOAD, 0);
             return false;
         }
     }
@@ -80,11 +243,20 @@ bool SIACom::uploadFile(const QString srcPath, const QString siaPath)
         QTimer::singleShot(5000, &loop, SLOT(quit()));
         loop.exec();
 
+        //The upload in progress is paused or slowed down at the boundaries of the windows
+        this->applyUploadRate();
+
         uploadStatus = this->uploadFileState(siaPath);
 
+        //The deamon did not answer, the upload goes on
+        if(uploadStatus.stateUnknown == true)
+            continue;
+
         if(uploadStatus.fileNotFound == true)
         {
             qWarning("Cannot found the uploading file !");
+            Metrics::setQueueDepth(Stage::UPLOAD, 0);
+            Metrics::setActiveBytes(Stage::UPLOAD, 0);
             return false;
         }
 
@@ -92,84 +264,532 @@ bool SIACom::uploadFile(const QString srcPath, const QString siaPath)
         {
             qInfo("Upload progress : %.2f%%", uploadStatus.uploadProgress);
             oldValue = uploadStatus.uploadProgress;
+
+            //Part of the file already sent (for the live throughput)
+            Metrics::setActiveBytes(Stage::UPLOAD, (quint64)((QFileInfo(srcPath).size() * qMin(uploadStatus.uploadProgress, 100.0)) / 100.0));
         }
     }while(!uploadStatus.isUploaded);
 
     qInfo("The file was uploaded !");
 
+    Metrics::setActiveBytes(Stage::UPLOAD, 0);
+    Metrics::add(Stage::UPLOAD, 1, QFileInfo(srcPath).size());
+    Metrics::setQueueDepth(Stage::UPLOAD, 0);
+
     return true;
 }
 
+bool SIACom::uploadFiles(const QStringList srcPaths, const QStringList siaPaths)
+{
+    QEventLoop          loop, postLoop;
+    QStringList         inFlight, toStart;
+    QHash<QString, int> lastProgress;
+    QHash<QString, t_UploadStatus> uploadStates;
+    t_UploadStatus      uploadStatus;
+    int                 next(0), uploaded(0), pendingPosts(0);
+    quint64             activeBytes(0);
+    bool                result(true);
+    const int           MAX_IN_FLIGHT(Config::getUploadParallel());
+
+    if(srcPaths.count() == 1)
+        return this->uploadFile(srcPaths.first(), siaPaths.first());
+
+    //Timed here (a single file is timed by uploadFile)
+    StageTimer stageTimer(Stage::UPLOAD);
+
+    qInfo(QString("Uploading "+ QString::number(siaPaths.count()) +" files ("+ QString::number(MAX_IN_FLIGHT) +" at the same time)").toUtf8());
+
+    //Nothing is sent outside of the upload windows
+    this->waitUploadWindow();
+
+    do
+    {
+        //Keep several uploads in progress on the SIA deamon, a finished upload start the next one
+        toStart = siaPaths.mid(next, MAX_IN_FLIGHT - inFlight.count());
+        next   += toStart.count();
+
+        //The states of the free slots are read at once and their uploads are posted together
+        uploadStates = this->uploadFileStates(toStart);
+
+        foreach(QString siaPath, toStart)
+        {
+            uploadStatus = uploadStates.value(siaPath);
+
+            if((uploadStatus.inUploading == false) && (uploadStatus.isUploaded == true))
+            {
+                qWarning("The file is already uploaded !");
+                qWarning("It isn't normal ! (Database corruption ? SHA1 collision ?)");
+                uploaded++;
+            }
+            else if(uploadStatus.inUploading == true)
+                inFlight << siaPath;
+            else
+            {
+                pendingPosts++;
+
+                this->postUploadAsync(srcPaths[siaPaths.indexOf(siaPath)], siaPath, [&, siaPath](const bool success)
+                {
+                    if(success)
+                        inFlight << siaPath;
+                    else
+                        result = false;
+
+                    if(--pendingPosts == 0)
+                        postLoop.quit();
+                });
+            }
+        }
+
+        if(pendingPosts > 0)
+            postLoop.exec();
+
+        //Nothing in progress : start the next files (or stop if all are done)
+        if(inFlight.isEmpty())
+            continue;
+
+        QTimer::singleShot(5000, &loop, SLOT(quit()));
+        loop.exec();
+
+        //The uploads in progress are paused or slowed down at the boundaries of the windows
+        this->applyUploadRate();
+
+        //One request for the states of all the uploads in progress
+        uploadStates = this->uploadFileStates(inFlight);
+
+        foreach(QString siaPath, inFlight)
+        {
+            uploadStatus = uploadStates.value(siaPath);
+
+            //The deamon did not answer, the upload goes on
+            if(uploadStatus.stateUnknown == true)
+                continue;
+
+            if(uploadStatus.fileNotFound == true)
+            {
+                qWarning(QString("Cannot found the uploading file "+ siaPath +" !").toUtf8());
+                inFlight.removeOne(siaPath);
+                result = false;
+                continue;
+            }
+
+            if((int)uploadStatus.uploadProgress != lastProgress.value(siaPath, -1))
+            {
+                qInfo(QString("Upload progress : "+ siaPath +" %1%").arg(uploadStatus.uploadProgress, 0, 'f', 2).toUtf8());
+                lastProgress.insert(siaPath, (int)uploadStatus.uploadProgress);
+            }
+
+            if(uploadStatus.isUploaded)
+            {
+                inFlight.removeOne(siaPath);
+                uploaded++;
+
+                Metrics::add(Stage::UPLOAD, 1, QFileInfo(srcPaths[siaPaths.indexOf(siaPath)]).size());
+            }
+        }
+
+        //The uploads in progress and the ones not started yet
+        Metrics::setQueueDepth(Stage::UPLOAD, inFlight.count() + (siaPaths.count() - next));
+
+        //Part of the files in progress already sent (for the live throughput)
+        activeBytes = 0;
+        foreach(QString siaPath, inFlight)
+            activeBytes += (QFileInfo(srcPaths[siaPaths.indexOf(siaPath)]).size() * qMin(lastProgress.value(siaPath, 0), 100)) / 100;
+
+        Metrics::setActiveBytes(Stage::UPLOAD, activeBytes);
+    }while(!inFlight.isEmpty() || (next < siaPaths.count()));
+
+    qInfo(QString(QString::number(uploaded) +"/"+ QString::number(siaPaths.count()) +" files were uploaded !").toUtf8());
+
+    Metrics::setQueueDepth(Stage::UPLOAD, 0);
+    Metrics::setActiveBytes(Stage::UPLOAD, 0);
+
+    return result;
+}
+
+bool SIACom::postUpload(const QString srcPath, const QString siaPath)
+{
+    QEventLoop  loop;
+    bool        done(false), result(false);
+
+    this->postUploadAsync(srcPath, siaPath, [&](const bool success)
+    {
+        result = success;
+        done   = true;
+        loop.quit();
+    });
+
+    if(!done)
+        loop.exec();
+
+    return result;
+}
+
 bool SIACom::deleteFile(const QString siaPath)
 {
-    QNetworkReply   *reply;
+    QEventLoop  loop;
+    bool        done(false), result(false);
+
+    this->deleteFileAsync(siaPath, [&](const bool success)
+    {
+        result = success;
+        done   = true;
+        loop.quit();
+    });
+
+    if(!done)
+        loop.exec();
+
+    return result;
+}
+
+QStringList SIACom::deleteFiles(const QStringList siaPaths)
+{
+    QEventLoop                  loop;
+    QStringList                 deleteQueue(siaPaths);
+    QStringList                 deleteDone;
+    int                         inFlight(0);
+    std::function<void(void)>   postNextDelete;
+    const int                   MAX_IN_FLIGHT(Config::getDeleteParallel());
+
+    //Each target is deleted only once
+    deleteQueue.removeDuplicates();
+
+    //Keep several deletes in flight (the dispatcher limits all the requests), each finished delete post the next one
+    postNextDelete = [&](void)
+    {
+        const QString siaPath(deleteQueue.takeFirst());
+
+        inFlight++;
+
+        this->sendAsync(SIA_DELETE_FILE(siaPath), true, [&, siaPath](const t_SiaReply &reply)
+        {
+            inFlight--;
+
+            //The target is already gone (e.g. deleted before a crash), nothing else to do
+            if(reply.success || reply.message.contains(SIA_MSG_UNKNOWN_FILE))
+                deleteDone << siaPath;
+            else
+                qWarning(QString("Cannot delete "+ siaPath +" : "+ reply.message).toUtf8());
+
+            if(!deleteQueue.isEmpty())
+                postNextDelete();
+            else if(inFlight == 0)
+                loop.quit();
+        });
+    };
+
+    while((inFlight < MAX_IN_FLIGHT) && (!deleteQueue.isEmpty()))
+        postNextDelete();
+
+    if(inFlight > 0)
+        loop.exec();
+
+    return deleteDone;
+}
+
+bool SIACom::readRange(const QString siaPath, const quint64 offset, const quint64 length, QByteArray *data)
+{
+    QNetworkRequest request(*m_netRequest);
     QEventLoop      loop;
+    bool            done(false), result(false);
 
-    m_netRequest->setUrl(SIA_DELETE_FILE(siaPath));
-    reply = m_netManager->post(*m_netRequest, QByteArray());
+    data->clear();
 
-    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
-    loop.exec();
+    if(length == 0)
+        return true;
 
-    if(reply->error() != QNetworkReply::NoError)
-        return false;
+    //The stream call of the deamon support the HTTP ranges
+    request.setUrl(SIA_STREAM_FILE(siaPath));
+    request.setRawHeader("Range", QString("bytes="+ QString::number(offset) +"-"+ QString::number(offset + length - 1)).toUtf8());
 
-    return true;
+    this->sendRequest(request, false, Config::getRequestTimeout(), [&](const t_SiaReply &reply)
+    {
+        if(!reply.success)
+            qWarning(QString("Cannot read "+ siaPath +" : "+ reply.message).toUtf8());
+        else
+        {
+            *data = reply.body;
+
+            //A server without range support send the whole file
+            if(reply.httpStatus != 206)
+                *data = data->mid(offset, length);
+
+            result = ((quint64)data->size() == length);
+        }
+
+        done = true;
+        loop.quit();
+    });
+
+    if(!done)
+        loop.exec();
+
+    return result;
+}
+
+QStringList SIACom::downloadFiles(const QStringList siaPaths, const QStringList dstPaths)
+{
+    QEventLoop                  loop;
+    QStringList                 downloadQueue(siaPaths);
+    QStringList                 downloadDstQueue(dstPaths);
+    QStringList                 downloadDone;
+    int                         inFlight(0);
+    std::function<void(void)>   postNextDownload;
+    const int                   MAX_IN_FLIGHT(Config::getDownloadParallel());
+
+    //The deamon reply when the file is fully downloaded, so several requests are kept in flight (without timeout)
+    postNextDownload = [&](void)
+    {
+        QNetworkRequest request(*m_netRequest);
+        const QString   siaPath(downloadQueue.takeFirst());
+        const QString   dstPath(downloadDstQueue.takeFirst());
+
+        inFlight++;
+
+        request.setUrl(SIA_DOWNLOAD_FILE(siaPath, dstPath));
+
+        this->sendRequest(request, false, 0, [&, siaPath, dstPath](const t_SiaReply &reply)
+        {
+            inFlight--;
+
+            if(reply.success)
+            {
+                downloadDone << siaPath;
+                emit this->downloaded(siaPath, dstPath);
+            }
+            else
+                qWarning(QString("Cannot download "+ siaPath +" : "+ reply.message).toUtf8());
+
+            if(!downloadQueue.isEmpty())
+                postNextDownload();
+            else if(inFlight == 0)
+                loop.quit();
+        });
+    };
+
+    while((inFlight < MAX_IN_FLIGHT) && (!downloadQueue.isEmpty()))
+        postNextDownload();
+
+    if(inFlight > 0)
+        loop.exec();
+
+    return downloadDone;
+}
+
+void SIACom::setUploadSchedule(const QStringList schedule)
+{
+    //The schedule is checked by the config
+    m_scheduler->setSchedule(schedule);
+    m_rateApplied = false;
+}
+
+bool SIACom::isUploadWindowOpen(void)
+{
+    this->applyUploadRate();
+
+    return (m_scheduler->currentRate() != UPLOAD_RATE_PAUSED);
+}
+
+void SIACom::waitUploadWindow(void)
+{
+    QEventLoop  loop;
+
+    if(this->isUploadWindowOpen())
+        return;
+
+    qInfo(QString("Upload window closed until "+ QTime::currentTime().addSecs(m_scheduler->secondsToOpen()).toString("HH:mm")).toUtf8());
+
+    //Check again every minute at most (the clock of the system can change)
+    do
+    {
+        QTimer::singleShot(qBound(1, m_scheduler->secondsToOpen(), 60) * 1000, &loop, SLOT(quit()));
+        loop.exec();
+    }while(!this->isUploadWindowOpen());
+
+    qInfo("Upload window open");
+}
+
+void SIACom::applyUploadRate(void)
+{
+    qint64      rate;
+    int         change;
+    QString     until;
+    auto        logFailure = [](const t_SiaReply &reply)
+    {
+        if(!reply.success)
+            qWarning(QString("Cannot apply the upload window : "+ reply.message).toUtf8());
+    };
+
+    //Without schedule the settings of the deamon are never changed
+    if(m_scheduler->isEmpty())
+        return;
+
+    rate = m_scheduler->currentRate();
+
+    if(m_rateApplied && (rate == m_appliedRate))
+        return;
+
+    //The setting of the deamon is read before the first change
+    if(!m_rateApplied)
+    {
+        QEventLoop  loop;
+        bool        done(false), read(false);
+
+        this->sendAsync(SIA_RENTER, false, [&](const t_SiaReply &reply)
+        {
+            if(reply.success)
+                m_previousRate = (qint64)QJsonDocument::fromJson(reply.body).object().value("settings").toObject().value("maxuploadspeed").toDouble();
+            else
+                qWarning(QString("Cannot read the upload settings of the deamon : "+ reply.message).toUtf8());
+
+            read = reply.success;
+            done = true;
+            loop.quit();
+        });
+
+        if(!done)
+            loop.exec();
+
+        //Nothing is changed until the setting to restore is known (tried again at the next check)
+        if(!read)
+            return;
+    }
+
+    change = m_scheduler->secondsToChange();
+
+    if(change >= 0)
+        until = " until "+ QTime::currentTime().addSecs(change).toString("HH:mm");
+
+    //The deamon keeps the uploads in progress paused until the next window (it resumes them by itself at the end)
+    if(rate == UPLOAD_RATE_PAUSED)
+    {
+        this->sendAsync(SIA_PAUSE_UPLOADS(QString::number(qMax(m_scheduler->secondsToOpen(), 1))), true, logFailure);
+        qInfo(QString("Upload window : paused"+ until).toUtf8());
+    }
+    else
+    {
+        if(m_rateApplied && (m_appliedRate == UPLOAD_RATE_PAUSED))
+            this->sendAsync(SIA_RESUME_UPLOADS, true, logFailure);
+
+        //Outside of the limited windows the deamon gets back its own limit
+        this->sendAsync(SIA_RENTER_SETTINGS(QString::number((rate == UPLOAD_RATE_UNLIMITED) ? m_previousRate : rate)), true, logFailure);
+
+        if(rate == UPLOAD_RATE_UNLIMITED)
+            qInfo(QString("Upload window : limit of the deamon"+ until).toUtf8());
+        else
+            qInfo(QString("Upload window : "+ QString::number(rate) +" Bytes/s"+ until).toUtf8());
+    }
+
+    m_appliedRate = rate;
+    m_rateApplied = true;
+}
+
+void SIACom::restoreUploadRate(void)
+{
+    QEventLoop  loop;
+    int         pending(0);
+    auto        restored = [&](const t_SiaReply &reply)
+    {
+        if(!reply.success)
+            qWarning(QString("Cannot restore the upload settings of the deamon : "+ reply.message).toUtf8());
+
+        if(--pending == 0)
+            loop.quit();
+    };
+
+    //Nothing was changed
+    if(!m_rateApplied)
+        return;
+
+    if(m_appliedRate == UPLOAD_RATE_PAUSED)
+    {
+        pending++;
+        this->sendAsync(SIA_RESUME_UPLOADS, true, restored);
+    }
+
+    pending++;
+    this->sendAsync(SIA_RENTER_SETTINGS(QString::number(m_previousRate)), true, restored);
+
+    if(pending > 0)
+        loop.exec();
+
+    m_rateApplied = false;
+
+    qInfo("Upload window : settings of the deamon restored");
 }
 
 t_UploadStatus SIACom::uploadFileState(const QString siaPath)
 {
-    QNetworkReply   *reply;
-    QEventLoop      loop;
-    QJsonObject     jsonObj;
-    QJsonArray      jsonArray;
-    t_UploadStatus  uploadStatus;
+    return this->uploadFileStates(QStringList() << siaPath).value(siaPath);
+}
+
+QHash<QString, t_UploadStatus> SIACom::uploadFileStates(const QStringList siaPaths)
+{
+    QEventLoop                      loop;
+    QHash<QString, t_UploadStatus>  uploadStates;
+    bool                            done(false);
+
+    this->uploadFileStatesAsync(siaPaths, [&](const QHash<QString, t_UploadStatus> states)
+    {
+        uploadStates = states;
+        done         = true;
+        loop.quit();
+    });
+
+    if(!done)
+        loop.exec();
 
-    uploadStatus.fileNotFound   = true;
+    return uploadStates;
+}
+
+QHash<QString, t_UploadStatus> SIACom::parseUploadStates(const t_SiaReply &reply, const QStringList siaPaths)
+{
+    QJsonArray                      jsonArray;
+    QJsonObject                     jsonObj;
+    QHash<QString, t_UploadStatus>  uploadStates;
+    t_UploadStatus                  uploadStatus;
+
+    uploadStatus.fileNotFound   = reply.success;
+    uploadStatus.stateUnknown   = !reply.success;
     uploadStatus.inUploading    = false;
     uploadStatus.isUploaded     = false;
     uploadStatus.uploadProgress = 0.0;
 
-    m_netRequest->setUrl(SIA_RENTER_FILES);
-    reply = m_netManager->get(*m_netRequest);
-
-    QObject::connect(reply, SIGNAL(finished()), &loop, SLOT(quit()));
-    loop.exec();
+    //Each asked path has a state (not found by default, unknown if the deamon did not answer)
+    foreach(QString siaPath, siaPaths)
+        uploadStates.insert(siaPath, uploadStatus);
 
-    jsonObj = QJsonDocument::fromJson(reply->readAll()).object();
-
-    if(reply->error() != QNetworkReply::NoError)
+    if(!reply.success)
     {
-        qInfo(jsonObj.value("message").toString().toUtf8());
-        return uploadStatus;
+        qInfo(reply.message.toUtf8());
+        return uploadStates;
     }
 
-    jsonArray = jsonObj.value("files").toArray();
+    jsonArray = QJsonDocument::fromJson(reply.body).object().value("files").toArray();
 
     foreach(QJsonValue tmp, jsonArray)
     {
         jsonObj = tmp.toObject();
 
-        if(jsonObj.value("siapath").toString() == siaPath)
-        {
-            uploadStatus.fileNotFound   = false;
-
-            uploadStatus.uploadProgress = jsonObj.value("uploadprogress").toDouble();
+        if(!uploadStates.contains(jsonObj.value("siapath").toString()))
+            continue;
 
-            if(uploadStatus.uploadProgress < 100.0)
-            {
-                uploadStatus.inUploading = true;
-                uploadStatus.isUploaded  = false;
-            }
-            else
-            {
-                uploadStatus.inUploading = false;
-                uploadStatus.isUploaded  = true;
-            }
+        uploadStatus.fileNotFound   = false;
+        uploadStatus.uploadProgress = jsonObj.value("uploadprogress").toDouble();
 
-            break;
+        if(uploadStatus.uploadProgress < 100.0)
+        {
+            uploadStatus.inUploading = true;
+            uploadStatus.isUploaded  = false;
+        }
+        else
+        {
+            uploadStatus.inUploading = false;
+            uploadStatus.isUploaded  = true;
         }
+
+        uploadStates.insert(jsonObj.value("siapath").toString(), uploadStatus);
     }
 
-    return uploadStatus;
+    return uploadStates;
 }
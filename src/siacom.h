@@ -2,6 +2,8 @@
 #define SIACOM_H
 
 #include "config.h"
+#include "metrics.h"
+#include "uploadscheduler.h"
 #include <QObject>
 #include <QNetworkAccessManager>
 #include <QNetworkRequest>
@@ -11,21 +13,59 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QTimer>
+#include <QHash>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QtGlobal>
+#include <functional>
 
 #define SIA_BASE_URL                QString("http://"+Config::getSiaIpAdrress()+":"+Config::getSiaPort())
 #define SIA_CONSENSUS               QUrl(SIA_BASE_URL+"/consensus")
 #define SIA_RENTER_FILES            QUrl(SIA_BASE_URL+"/renter/files")
 #define SIA_UPLOAD_FILE(SRC, DST)   QUrl(SIA_BASE_URL+"/renter/upload/"+DST+"?source="+SRC)
 #define SIA_DELETE_FILE(DST)        QUrl(SIA_BASE_URL+"/renter/delete/"+DST)
+#define SIA_DOWNLOAD_FILE(SRC, DST) QUrl(SIA_BASE_URL+"/renter/download/"+SRC+"?destination="+DST)
+#define SIA_STREAM_FILE(SRC)        QUrl(SIA_BASE_URL+"/renter/stream/"+SRC)
+#define SIA_RENTER                  QUrl(SIA_BASE_URL+"/renter")
+#define SIA_RENTER_SETTINGS(RATE)   QUrl(SIA_BASE_URL+"/renter?maxuploadspeed="+RATE)
+#define SIA_PAUSE_UPLOADS(SECONDS)  QUrl(SIA_BASE_URL+"/renter/uploads/pause?duration="+SECONDS+"s")
+#define SIA_RESUME_UPLOADS          QUrl(SIA_BASE_URL+"/renter/uploads/resume")
+
+#define SIA_MSG_UNKNOWN_FILE        QString("no file known")
+#define SIA_MSG_FILE_EXISTS         QString("already exists")
 
 struct t_UploadStatus
 {
     bool    fileNotFound;
+    bool    stateUnknown;   //The deamon did not answer (network error or timeout), ask again later
     bool    inUploading;
     bool    isUploaded;
     double  uploadProgress;
 };
 
+//Result of one request to the deamon (after the retries)
+struct t_SiaReply
+{
+    bool        success;
+    int         httpStatus;     //0 if no reply (network error or timeout)
+    QByteArray  body;
+    QString     message;        //Error message of the deamon or of the network
+    int         attempts;
+};
+
+typedef std::function<void(const t_SiaReply &reply)> t_SiaCallback;
+
+//A request waiting for a free slot or for the end of its backoff
+struct t_SiaRequest
+{
+    QNetworkRequest request;
+    bool            isPost;
+    t_SiaCallback   callback;
+    int             attempt;
+    qint64          readyAt;
+    int             timeout;        //Seconds before the abort of an attempt (0 = none)
+};
+
 class SIACom : public QObject
 {
     Q_OBJECT
@@ -34,13 +74,45 @@ public:
     ~SIACom(void);
     bool test(void);
     bool uploadFile(const QString srcPath, const QString siaPath);
+    bool uploadFiles(const QStringList srcPaths, const QStringList siaPaths);
     t_UploadStatus uploadFileState(const QString siaPath);
+    QHash<QString, t_UploadStatus> uploadFileStates(const QStringList siaPaths);
     bool deleteFile(const QString siaPath);
+    //Non blocking API : the callback is called from the event loop when the request is done
+    void sendAsync(const QUrl url, const bool isPost, t_SiaCallback callback);
+    void testAsync(std::function<void(const bool success)> callback);
+    void postUploadAsync(const QString srcPath, const QString siaPath, std::function<void(const bool success)> callback);
+    void uploadFileStatesAsync(const QStringList siaPaths, std::function<void(const QHash<QString, t_UploadStatus> states)> callback);
+    void deleteFileAsync(const QString siaPath, std::function<void(const bool success)> callback);
+    QStringList deleteFiles(const QStringList siaPaths);
+    QStringList downloadFiles(const QStringList siaPaths, const QStringList dstPaths);
+    bool readRange(const QString siaPath, const quint64 offset, const quint64 length, QByteArray *data);
+    //Upload rate by time of day (applied to the deamon by the uploads)
+    void setUploadSchedule(const QStringList schedule);
+    bool isUploadWindowOpen(void);
+    void waitUploadWindow(void);
+    void restoreUploadRate(void);
+signals:
+    void downloaded(const QString siaPath, const QString dstPath);
 private slots:
     void finished(QNetworkReply *reply);
+    void requestFinished(void);
+    void dispatchRequests(void);
 private:
-    QNetworkAccessManager *m_netManager;
-    QNetworkRequest       *m_netRequest;
+    bool postUpload(const QString srcPath, const QString siaPath);
+    QHash<QString, t_UploadStatus> parseUploadStates(const t_SiaReply &reply, const QStringList siaPaths);
+    void sendRequest(const QNetworkRequest request, const bool isPost, const int timeout, t_SiaCallback callback);
+    void applyUploadRate(void);
+
+    QNetworkAccessManager           *m_netManager;
+    QNetworkRequest                 *m_netRequest;
+    QList<t_SiaRequest*>                    m_requestQueue;
+    QHash<QNetworkReply*, t_SiaRequest*>    m_requestInFlight;
+    QElapsedTimer                           m_clock;
+    UploadScheduler                         *m_scheduler;
+    qint64                                  m_appliedRate;
+    bool                                    m_rateApplied;
+    qint64                                  m_previousRate;//Setting of the deamon before the first window (restored at the end of the run)
 };
 
 #endif // SIACOM_H
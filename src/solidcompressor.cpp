@@ -0,0 +1,172 @@
+#include "solidcompressor.h"
+
+SolidCompressor::SolidCompressor(QObject *parent) : QObject(parent)
+{
+}
+
+bool SolidCompressor::compress(const QString srcPath, const QString dstPath, const int level, const int workers)
+{
+    QFile           srcFile(srcPath);
+    QFile           dstFile(dstPath);
+    ZSTD_CCtx       *cctx;
+    ZSTD_inBuffer   input;
+    ZSTD_outBuffer  output;
+    QByteArray      inBuff(ZSTD_CStreamInSize(), 0);
+    QByteArray      outBuff(ZSTD_CStreamOutSize(), 0);
+    size_t          remaining;
+    qint64          len;
+    bool            last(false), result(true);
+    StageTimer      stageTimer(Stage::ZIP);
+
+    if(!srcFile.open(QIODevice::ReadOnly) || !dstFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    cctx = ZSTD_createCCtx();
+    ZSTD_CCtx_setParameter(cctx, ZSTD_c_compressionLevel, level);
+    ZSTD_CCtx_setPledgedSrcSize(cctx, srcFile.size());
+
+    //The workers compress the parts of the frame at the same time (a zstd without thread support refuses it and stay in one thread)
+    if(workers > 1)
+        ZSTD_CCtx_setParameter(cctx, ZSTD_c_nbWorkers, workers);
+
+    //One frame for the whole tar
+    while(!last && result)
+    {
+        len  = srcFile.read(inBuff.data(), inBuff.size());
+
+        //A read error would end a valid frame on a truncated tar
+        if(len < 0)
+        {
+            qWarning(QString("Cannot read "+ srcPath +" : "+ srcFile.errorString()).toUtf8());
+            result = false;
+            break;
+        }
+
+        last = (len < inBuff.size());
+
+        input.src  = inBuff.constData();
+        input.size = (size_t)qMax(len, (qint64)0);
+        input.pos  = 0;
+
+        do
+        {
+            output.dst  = outBuff.data();
+            output.size = outBuff.size();
+            output.pos  = 0;
+
+            remaining = ZSTD_compressStream2(cctx, &output, &input, last ? ZSTD_e_end : ZSTD_e_continue);
+
+            if(ZSTD_isError(remaining))
+            {
+                qWarning(QString("Cannot compress "+ srcPath +" : "+ QString(ZSTD_getErrorName(remaining))).toUtf8());
+                result = false;
+                break;
+            }
+
+            if(dstFile.write(outBuff.constData(), output.pos) != (qint64)output.pos)
+            {
+                qWarning(QString("Cannot write "+ dstPath +" : "+ dstFile.errorString()).toUtf8());
+                result = false;
+                break;
+            }
+        }while(last ? (remaining != 0) : (input.pos != input.size));
+    }
+
+    //The buffered end of the frame must reach the disk too
+    if(result && !dstFile.flush())
+    {
+        qWarning(QString("Cannot write "+ dstPath +" : "+ dstFile.errorString()).toUtf8());
+        result = false;
+    }
+
+    ZSTD_freeCCtx(cctx);
+    srcFile.close();
+    dstFile.close();
+
+    if(result == false)
+        QFile::remove(dstPath);
+    else
+        Metrics::add(Stage::ZIP, 1, QFileInfo(srcPath).size());
+
+    return result;
+}
+
+bool SolidCompressor::uncompress(const QString srcPath, const QString dstPath)
+{
+    QFile           srcFile(srcPath);
+    QFile           dstFile(dstPath);
+    ZSTD_DCtx       *dctx;
+    ZSTD_inBuffer   input;
+    ZSTD_outBuffer  output;
+    QByteArray      inBuff(ZSTD_DStreamInSize(), 0);
+    QByteArray      outBuff(ZSTD_DStreamOutSize(), 0);
+    size_t          ret(1);
+    qint64          len;
+    bool            result(true);
+
+    if(!srcFile.open(QIODevice::ReadOnly) || !dstFile.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    dctx = ZSTD_createDCtx();
+
+    len = srcFile.read(inBuff.data(), inBuff.size());
+    while((len > 0) && result)
+    {
+        input.src  = inBuff.constData();
+        input.size = (size_t)len;
+        input.pos  = 0;
+
+        while(input.pos < input.size)
+        {
+            output.dst  = outBuff.data();
+            output.size = outBuff.size();
+            output.pos  = 0;
+
+            ret = ZSTD_decompressStream(dctx, &output, &input);
+
+            if(ZSTD_isError(ret))
+            {
+                qWarning(QString("Cannot uncompress "+ srcPath +" : "+ QString(ZSTD_getErrorName(ret))).toUtf8());
+                result = false;
+                break;
+            }
+
+            if(dstFile.write(outBuff.constData(), output.pos) != (qint64)output.pos)
+            {
+                qWarning(QString("Cannot write "+ dstPath +" : "+ dstFile.errorString()).toUtf8());
+                result = false;
+                break;
+            }
+        }
+
+        len = srcFile.read(inBuff.data(), inBuff.size());
+    }
+
+    if(result && (len < 0))
+    {
+        qWarning(QString("Cannot read "+ srcPath +" : "+ srcFile.errorString()).toUtf8());
+        result = false;
+    }
+
+    if(result && !dstFile.flush())
+    {
+        qWarning(QString("Cannot write "+ dstPath +" : "+ dstFile.errorString()).toUtf8());
+        result = false;
+    }
+
+    ZSTD_freeDCtx(dctx);
+    srcFile.close();
+    dstFile.close();
+
+    //0 => the end of the frame was reached (the file is not truncated)
+    if(result && (ret != 0))
+    {
+        qWarning(QString("Cannot uncompress "+ srcPath +" : truncated cluster").toUtf8());
+        result = false;
+    }
+
+    if(result == false)
+        QFile::remove(dstPath);
+
+    return result;
+}
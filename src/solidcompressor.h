@@ -0,0 +1,35 @@
+#ifndef SOLIDCOMPRESSOR_H
+#define SOLIDCOMPRESSOR_H
+
+#include <zstd.h>
+
+#include "metrics.h"
+#include <QObject>
+#include <QFile>
+#include <QFileInfo>
+#include <QByteArray>
+#include <QString>
+
+//Suffix of a solid cluster (the whole tar compressed at once), the restore uncompress it before the extraction
+#define SOLID_SUFFIX            QString(".zst")
+
+//Bytes of the compressed cluster for each byte of tar before the first cluster of the run
+#define SOLID_FIRST_RATIO       1.0
+//The target of the packing is a bit under the cluster size (the ratio of the next cluster is not the same)
+#define SOLID_RATIO_MARGIN      1.05
+//Max bytes of tar for one cluster (very compressible data)
+#define SOLID_MAX_EXPANSION     20
+//A cluster bigger than the SIA cluster is built again with less files
+#define SOLID_MAX_ATTEMPTS      3
+
+//Compression of a whole cluster in one zstd frame (solid mode)
+//The small files of a cluster share the same dictionary, the ratio is far better than the compression of each file
+class SolidCompressor : public QObject
+{
+public:
+    SolidCompressor(QObject *parent = 0);
+    static bool compress(const QString srcPath, const QString dstPath, const int level, const int workers);
+    static bool uncompress(const QString srcPath, const QString dstPath);
+};
+
+#endif // SOLIDCOMPRESSOR_H
@@ -0,0 +1,123 @@
+#include "uploadscheduler.h"
+
+UploadScheduler::UploadScheduler(QObject *parent) : QObject(parent)
+{
+}
+
+bool UploadScheduler::parse(const QStringList schedule, QList<t_uploadWindow> *windows)
+{
+    t_uploadWindow  window;
+    QStringList     parts, bounds;
+    QTime           start, end;
+    bool            ok(false), open(false);
+
+    windows->clear();
+
+    foreach(QString entry, schedule)
+    {
+        entry = entry.trimmed();
+
+        if(entry.isEmpty())
+            continue;
+
+        //"HH:MM-HH:MM=rate"
+        parts = entry.split('=');
+        if(parts.count() != 2)
+            return false;
+
+        bounds = parts[0].trimmed().split('-');
+        if(bounds.count() != 2)
+            return false;
+
+        start = QTime::fromString(bounds[0].trimmed(), "HH:mm");
+        end   = QTime::fromString(bounds[1].trimmed(), "HH:mm");
+
+        if(!start.isValid() || !end.isValid() || (start == end))
+            return false;
+
+        window.startMinute = start.hour() * 60 + start.minute();
+        window.endMinute   = end.hour() * 60 + end.minute();
+        window.rate        = parts[1].trimmed().toLongLong(&ok);
+
+        if(!ok || (window.rate < 0))
+            return false;
+
+        *windows << window;
+    }
+
+    //A schedule closed all the day would never upload
+    for(int minute(0); (minute < MINUTES_PER_DAY) && !open; minute++)
+        open = (UploadScheduler::windowRate(*windows, minute) != UPLOAD_RATE_PAUSED);
+
+    return open;
+}
+
+bool UploadScheduler::setSchedule(const QStringList schedule)
+{
+    return UploadScheduler::parse(schedule, &m_windows);
+}
+
+bool UploadScheduler::isEmpty(void) const
+{
+    return m_windows.isEmpty();
+}
+
+qint64 UploadScheduler::windowRate(const QList<t_uploadWindow> &windows, const int minute)
+{
+    foreach(t_uploadWindow window, windows)
+    {
+        //The window [start, end[ can cross midnight
+        if(window.startMinute < window.endMinute)
+        {
+            if((minute >= window.startMinute) && (minute < window.endMinute))
+                return window.rate;
+        }
+        else if((minute >= window.startMinute) || (minute < window.endMinute))
+            return window.rate;
+    }
+
+    return UPLOAD_RATE_UNLIMITED;
+}
+
+qint64 UploadScheduler::rateAt(const QTime time) const
+{
+    return UploadScheduler::windowRate(m_windows, time.hour() * 60 + time.minute());
+}
+
+qint64 UploadScheduler::currentRate(void) const
+{
+    return this->rateAt(QTime::currentTime());
+}
+
+int UploadScheduler::secondsToChange(void) const
+{
+    QTime   now(QTime::currentTime());
+    int     minute(now.hour() * 60 + now.minute());
+    qint64  rate(UploadScheduler::windowRate(m_windows, minute));
+
+    //The rate only change at the start of a minute
+    for(int i(1); i <= MINUTES_PER_DAY; i++)
+    {
+        if(UploadScheduler::windowRate(m_windows, (minute + i) % MINUTES_PER_DAY) != rate)
+            return i * 60 - now.second();
+    }
+
+    return -1;
+}
+
+int UploadScheduler::secondsToOpen(void) const
+{
+    QTime   now(QTime::currentTime());
+    int     minute(now.hour() * 60 + now.minute());
+
+    if(UploadScheduler::windowRate(m_windows, minute) != UPLOAD_RATE_PAUSED)
+        return 0;
+
+    for(int i(1); i <= MINUTES_PER_DAY; i++)
+    {
+        if(UploadScheduler::windowRate(m_windows, (minute + i) % MINUTES_PER_DAY) != UPLOAD_RATE_PAUSED)
+            return i * 60 - now.second();
+    }
+
+    return -1;
+}
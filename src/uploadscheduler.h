@@ -0,0 +1,44 @@
+#ifndef UPLOADSCHEDULER_H
+#define UPLOADSCHEDULER_H
+
+#include <QObject>
+#include <QStringList>
+#include <QDateTime>
+#include <QTime>
+#include <QList>
+
+//Rate of the time not covered by a window
+#define UPLOAD_RATE_UNLIMITED   Q_INT64_C(-1)
+//Rate of a closed window (nothing is sent)
+#define UPLOAD_RATE_PAUSED      Q_INT64_C(0)
+
+#define MINUTES_PER_DAY         1440
+
+//One window of the upload schedule "HH:MM-HH:MM=rate" (a window ending before its start cross midnight)
+struct t_uploadWindow
+{
+    int     startMinute;
+    int     endMinute;
+    qint64  rate;       //Bytes/s (0 => closed)
+};
+
+//Upload rate allowed by time of day
+//The first window which contains the time give the rate, outside of the windows the upload is not limited
+class UploadScheduler : public QObject
+{
+public:
+    UploadScheduler(QObject *parent = 0);
+    static bool parse(const QStringList schedule, QList<t_uploadWindow> *windows);
+    bool setSchedule(const QStringList schedule);
+    bool isEmpty(void) const;
+    qint64 rateAt(const QTime time) const;
+    qint64 currentRate(void) const;
+    int secondsToChange(void) const;
+    int secondsToOpen(void) const;
+private:
+    static qint64 windowRate(const QList<t_uploadWindow> &windows, const int minute);
+
+    QList<t_uploadWindow>   m_windows;
+};
+
+#endif // UPLOADSCHEDULER_H
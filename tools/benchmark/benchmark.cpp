@@ -0,0 +1,257 @@
+#include "benchmark.h"
+#include <QCoreApplication>
+#include <QEventLoop>
+#include <QTextStream>
+
+ChunkBackupBenchmark::ChunkBackupBenchmark(const t_BenchConfig config, QObject *parent) : QObject(parent)
+{
+    m_config    = config;
+    m_mock      = 0;
+    m_app       = 0;
+    m_generator = 0;
+    m_treeBytes = 0;
+    m_treeFiles = 0;
+    m_totalMs   = 0;
+    m_exitCode  = -1;
+}
+
+ChunkBackupBenchmark::~ChunkBackupBenchmark(void)
+{
+    delete m_generator;
+}
+
+bool ChunkBackupBenchmark::run(void)
+{
+    qInfo("Generating the synthetic tree...");
+    if(!this->generateTree())
+        return false;
+    qInfo("Done (%d files, %llu bytes)", m_treeFiles, m_treeBytes);
+
+    //Mock on a free port
+    m_config.mock.port = 0;
+    m_mock = new SiaMockServer(m_config.mock, this);
+
+    if(!m_mock->start())
+        return false;
+
+    if(!this->prepareApp(m_mock->port()))
+        return false;
+
+    //The log of the runs is kept in the work directory, the stages are read from the metrics of the app
+    m_app = new QProcess(this);
+    m_app->setProcessChannelMode(QProcess::MergedChannels);
+    m_app->setStandardOutputFile(m_config.workDir +"/app.log", QIODevice::Append);
+
+    QObject::connect(m_app, SIGNAL(finished(int)), this, SLOT(appFinished(int)));
+
+    for(int run(0); run < qMax(m_config.runs, 1); run++)
+    {
+        //The next runs backup the changes of the tree (same database, same SIA mock)
+        if(run > 0)
+        {
+            qInfo("Mutating the synthetic tree (step %d)...", run);
+
+            if(!m_generator->mutate(m_config.workDir +"/source", m_config.mutation, run))
+                return false;
+
+            qInfo("Done (%d edited, %d appended, %d deleted, %d renamed, %d created)", m_generator->stats().edited, m_generator->stats().appended,
+                  m_generator->stats().deleted, m_generator->stats().renamed, m_generator->stats().created);
+        }
+
+        if(!this->runApp())
+            return false;
+
+        this->report(run);
+
+        if(m_exitCode != 0)
+            return false;
+    }
+
+    this->writeJson();
+
+    return true;
+}
+
+bool ChunkBackupBenchmark::runApp(void)
+{
+    QEventLoop loop;
+
+    QObject::connect(m_app, SIGNAL(finished(int)), &loop, SLOT(quit()));
+
+    qInfo("Running SIA Chunk Backup...");
+
+    m_metrics   = QJsonObject();
+    m_exitCode  = -1;
+    m_statsAtStart = m_mock->stats();
+
+    //The app writes its metrics at the end of the run
+    QFile::remove(m_config.workDir +"/metrics/"+ METRICS_JSON_FILE);
+
+    m_runClock.start();
+
+    m_app->start(m_config.workDir +"/bin/"+ QFileInfo(m_config.appPath).fileName(),
+                 QStringList() << m_config.workDir +"/source" << "bench");
+
+    if(!m_app->waitForStarted(-1))
+    {
+        qCritical("Cannot start SIA Chunk Backup !");
+        return false;
+    }
+
+    //The mock is served by this event loop while the app is running
+    loop.exec();
+
+    this->readMetrics();
+
+    return true;
+}
+
+bool ChunkBackupBenchmark::generateTree(void)
+{
+    m_generator = new DatasetGenerator(m_config.dataset);
+
+    if(!m_generator->generate(m_config.workDir +"/source"))
+        return false;
+
+    m_treeFiles = m_generator->stats().files;
+    m_treeBytes = m_generator->stats().bytes;
+
+    return true;
+}
+
+bool ChunkBackupBenchmark::prepareApp(const quint16 port)
+{
+    QString binDir(m_config.workDir +"/bin");
+    QString dbDir(m_config.workDir +"/db");
+    QString journalDir(m_config.workDir +"/journal");
+    QString appCopy(binDir +"/"+ QFileInfo(m_config.appPath).fileName());
+    QFile   ini(binDir +"/SIACBackup.ini");
+
+    QDir(binDir).removeRecursively();
+    QDir(dbDir).removeRecursively();
+    QDir(journalDir).removeRecursively();
+    QDir().mkpath(binDir);
+    QDir().mkpath(dbDir);
+
+    //The app read its config next to its executable
+    if(!QFile::copy(m_config.appPath, appCopy))
+    {
+        qCritical("Cannot copy the SIA Chunk Backup executable !");
+        return false;
+    }
+
+    QFile(appCopy).setPermissions(QFile(m_config.appPath).permissions());
+
+    if(!ini.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QTextStream stream(&ini);
+    stream << "[general]\n";
+    stream << "backup_mode=" << m_config.backupMode << "\n";
+    stream << "use_compression=" << (m_config.useCompression ? "true" : "false") << "\n";
+    stream << "use_encryption=false\n";
+    stream << "cluster_size=" << QString::number(m_config.clusterSize) << "\n";
+    stream << "avoid_frag=true\n";
+    stream << "database_name=bench.db\n";
+    stream << "database_dir=" << dbDir << "\n";
+    stream << "journal_dir=" << journalDir << "\n";
+    stream << "metrics_dir=" << m_config.workDir +"/metrics" << "\n";
+    stream << "[sia]\n";
+    stream << "ip_address=127.0.0.1\n";
+    stream << "port=" << QString::number(port) << "\n";
+    stream.flush();
+
+    return true;
+}
+
+void ChunkBackupBenchmark::appFinished(int exitCode)
+{
+    m_exitCode = exitCode;
+    m_totalMs = m_runClock.elapsed();
+}
+
+void ChunkBackupBenchmark::readMetrics(void)
+{
+    QFile file(m_config.workDir +"/metrics/"+ METRICS_JSON_FILE);
+
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        qWarning("Cannot read the metrics of SIA Chunk Backup, no time per stage !");
+        return;
+    }
+
+    m_metrics = QJsonDocument::fromJson(file.readAll()).object().value("stages").toObject();
+}
+
+void ChunkBackupBenchmark::report(const int run)
+{
+    QJsonObject jsonObj;
+    QJsonObject jsonStages;
+    QJsonObject stageObj;
+    t_MockStats mockStats(m_mock->stats());
+    double      seconds(qMax(m_totalMs, (qint64)1) / 1000.0);
+
+    //Only the requests of this run
+    mockStats.requests      -= m_statsAtStart.requests;
+    mockStats.uploads       -= m_statsAtStart.uploads;
+    mockStats.uploadedBytes -= m_statsAtStart.uploadedBytes;
+    mockStats.deletes       -= m_statsAtStart.deletes;
+
+    qInfo("=== Benchmark result (run %d) ===", run);
+    qInfo("Exit code      : %d", m_exitCode);
+    qInfo("Wall time      : %.3f s", seconds);
+    qInfo("Files          : %d (%.1f files/s)", m_treeFiles, m_treeFiles / seconds);
+    qInfo("Source bytes   : %llu (%.2f MB/s)", m_treeBytes, (m_treeBytes / 1000000.0) / seconds);
+    qInfo("Uploaded bytes : %llu in %llu clusters", mockStats.uploadedBytes, mockStats.uploads);
+    qInfo("Remote deletes : %llu", mockStats.deletes);
+    qInfo("API requests   : %llu", mockStats.requests);
+
+    //Time measured by the app in each stage (the stages can be nested, their times are not meant to be summed)
+    foreach(QString stage, m_metrics.keys())
+    {
+        stageObj = m_metrics.value(stage).toObject();
+
+        qInfo("Stage %-8s : %.3f s (%.1f%%), CPU %.3f s", stage.toUtf8().data(), stageObj.value("wall_seconds").toDouble(),
+              100.0 * stageObj.value("wall_seconds").toDouble() / seconds, stageObj.value("cpu_seconds").toDouble());
+        jsonStages.insert(stage, stageObj.value("wall_seconds").toDouble());
+    }
+
+    jsonObj.insert("run", run);
+    jsonObj.insert("backup_mode", m_config.backupMode);
+    jsonObj.insert("exit_code", m_exitCode);
+    jsonObj.insert("wall_seconds", seconds);
+    jsonObj.insert("files", m_treeFiles);
+    jsonObj.insert("source_bytes", (double)m_treeBytes);
+    jsonObj.insert("files_per_second", m_treeFiles / seconds);
+    jsonObj.insert("mb_per_second", (m_treeBytes / 1000000.0) / seconds);
+    jsonObj.insert("uploaded_bytes", (double)mockStats.uploadedBytes);
+    jsonObj.insert("clusters", (double)mockStats.uploads);
+    jsonObj.insert("remote_deletes", (double)mockStats.deletes);
+    jsonObj.insert("api_requests", (double)mockStats.requests);
+    jsonObj.insert("stages", jsonStages);
+    jsonObj.insert("dataset", m_generator->statsToJson());
+
+    m_runReports.append(jsonObj);
+}
+
+void ChunkBackupBenchmark::writeJson(void)
+{
+    QJsonObject jsonObj;
+    QFile       file;
+
+    if(m_config.jsonOut.isEmpty())
+        return;
+
+    file.setFileName(m_config.jsonOut);
+    if(!file.open(QIODevice::WriteOnly))
+        return;
+
+    //One run : the report as before, several runs : all of them
+    if(m_runReports.count() == 1)
+        file.write(QJsonDocument(m_runReports.at(0).toObject()).toJson());
+    else
+    {
+        jsonObj.insert("runs", m_runReports);
+        file.write(QJsonDocument(jsonObj).toJson());
+    }
+}
@@ -0,0 +1,58 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include "siamockserver.h"
+#include "datasetgenerator.h"
+#include "metrics.h"
+#include <QObject>
+#include <QProcess>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QVector>
+
+struct t_BenchConfig
+{
+    QString         appPath;    //SIA_Chunk_Backup executable
+    QString         workDir;    //Everything is generated in this directory
+    QString         backupMode; //RECURSIVE or SEPARTE_BY_DIR
+    bool            useCompression;
+    quint64         clusterSize;
+    t_DatasetConfig dataset;
+    int             runs;       //The runs after the first one backup the mutated tree
+    t_MutationScript mutation;
+    t_MockConfig    mock;
+    QString         jsonOut;    //Write the report as JSON in this file (empty => not written)
+};
+
+class ChunkBackupBenchmark : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ChunkBackupBenchmark(const t_BenchConfig config, QObject *parent = 0);
+    ~ChunkBackupBenchmark(void);
+    bool run(void);
+private slots:
+    void appFinished(int exitCode);
+private:
+    bool generateTree(void);
+    bool prepareApp(const quint16 port);
+    bool runApp(void);
+    void readMetrics(void);
+    void report(const int run);
+    void writeJson(void);
+
+    t_BenchConfig           m_config;
+    SiaMockServer           *m_mock;
+    QProcess                *m_app;
+    QElapsedTimer           m_runClock;
+    QJsonObject             m_metrics;  //Counters of each stage written by the app at the end of the run
+    DatasetGenerator        *m_generator;
+    quint64                 m_treeBytes;
+    int                     m_treeFiles;
+    qint64                  m_totalMs;
+    int                     m_exitCode;
+    QJsonArray              m_runReports;
+    t_MockStats             m_statsAtStart;
+};
+
+#endif // BENCHMARK_H
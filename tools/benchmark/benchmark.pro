@@ -0,0 +1,29 @@
+QT += core
+QT += network
+QT -= gui
+
+CONFIG += c++11
+
+TARGET = benchmark
+CONFIG += console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+#The file names of the metrics are taken from the sources of the app
+INCLUDEPATH += ../../src
+INCLUDEPATH += ../siamock
+INCLUDEPATH += ../common
+
+SOURCES += main.cpp \
+    benchmark.cpp \
+    ../siamock/siamockserver.cpp \
+    ../common/datasetgenerator.cpp
+
+HEADERS += \
+    benchmark.h \
+    ../siamock/siamockserver.h \
+    ../common/datasetgenerator.h \
+    ../common/datasetoptions.h
+
+DEFINES += QT_DEPRECATED_WARNINGS
@@ -0,0 +1,63 @@
+#include "benchmark.h"
+#include "datasetoptions.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication    app(argc, argv);
+    QCommandLineParser  parser;
+    t_BenchConfig       config;
+
+    app.setApplicationName("benchmark");
+
+    parser.setApplicationDescription("End-to-end throughput benchmark of SIA Chunk Backup against the local SIA mock.");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("app", "Path of the SIA_Chunk_Backup executable.", "path"));
+    parser.addOption(QCommandLineOption("work", "Working directory (default ./bench_work).", "dir", "./bench_work"));
+    parser.addOption(QCommandLineOption("mode", "Backup mode : RECURSIVE or SEPARTE_BY_DIR (default RECURSIVE).", "mode", "RECURSIVE"));
+    parser.addOption(QCommandLineOption("compression", "Enable the compression."));
+    parser.addOption(QCommandLineOption("cluster-size", "Cluster size in Bytes (default 40000000).", "bytes", "40000000"));
+    addDatasetOptions(&parser);
+    parser.addOption(QCommandLineOption("runs", "Backup runs, the tree is mutated before each run after the first one (default 1).", "count", "1"));
+    parser.addOption(QCommandLineOption("mutate", "Changes between two runs (default edit=0.05,append=0.02,delete=0.01,rename=0.01,create=0.02).", "script", "edit=0.05,append=0.02,delete=0.01,rename=0.01,create=0.02"));
+    parser.addOption(QCommandLineOption("latency", "Mock latency per request in ms (default 0).", "ms", "0"));
+    parser.addOption(QCommandLineOption("bandwidth", "Mock upload bandwidth in Bytes/s, 0 => instant (default 0).", "bytes", "0"));
+    parser.addOption(QCommandLineOption("curve", "Mock upload progress curve : LINEAR, SIGMOID or STEP (default LINEAR).", "curve", "LINEAR"));
+    parser.addOption(QCommandLineOption("json", "Write the result as JSON in this file.", "file"));
+    parser.process(app);
+
+    if(!parser.isSet("app"))
+    {
+        qCritical("The SIA_Chunk_Backup executable is needed (--app) !");
+        return 1;
+    }
+
+    config.appPath          = QFileInfo(parser.value("app")).absoluteFilePath();
+    config.workDir          = QFileInfo(parser.value("work")).absoluteFilePath();
+    config.backupMode       = parser.value("mode");
+    config.useCompression   = parser.isSet("compression");
+    config.clusterSize      = parser.value("cluster-size").toULongLong();
+    config.dataset          = datasetConfigFromOptions(&parser);
+    config.runs             = parser.value("runs").toInt();
+    config.jsonOut          = parser.value("json");
+
+    if(!DatasetGenerator::parseMutations(parser.value("mutate"), &config.mutation))
+    {
+        qCritical("Invalid mutation script !");
+        return 1;
+    }
+
+    config.mock.latencyMs   = parser.value("latency").toInt();
+    config.mock.bandwidth   = parser.value("bandwidth").toULongLong();
+
+    if(!SiaMockServer::parseCurve(parser.value("curve"), &config.mock.curve))
+    {
+        qCritical("Unknown progress curve !");
+        return 1;
+    }
+
+    ChunkBackupBenchmark benchmark(config);
+
+    return benchmark.run() ? 0 : 1;
+}
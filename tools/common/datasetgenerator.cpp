@@ -0,0 +1,428 @@
+#include "datasetgenerator.h"
+
+//Text of the compressible blocks
+static const char COMPRESSIBLE_TEXT[] = "SIA Chunk Backup synthetic data, the same words again and again to be compressed. ";
+
+DatasetGenerator::DatasetGenerator(const t_DatasetConfig config)
+{
+    m_config = config;
+    m_state  = 1;
+
+    this->resetStats();
+}
+
+t_DatasetConfig DatasetGenerator::defaultConfig(void)
+{
+    t_DatasetConfig config;
+
+    config.seed             = 1;
+    config.fileCount        = 1000;
+    config.dirFanOut        = 4;
+    config.maxDepth         = 8;
+    config.filesPerDir      = 32;
+    config.tinyRatio        = 0.3;
+    config.tinyMaxSize      = 1024;
+    config.minFileSize      = 1024;
+    config.maxFileSize      = 4000000;
+    config.giantRatio       = 0.0;
+    config.giantMaxSize     = 1000000000;
+    config.compressibility  = 0.0;
+    config.duplicateRatio   = 0.0;
+
+    return config;
+}
+
+bool DatasetGenerator::parseMutations(const QString str, t_MutationScript *script)
+{
+    QStringList pair;
+
+    script->editRatio   = 0.0;
+    script->appendRatio = 0.0;
+    script->deleteRatio = 0.0;
+    script->renameRatio = 0.0;
+    script->createRatio = 0.0;
+
+    //ex : "edit=0.05,append=0.02,delete=0.01,rename=0.01,create=0.02"
+    foreach(QString item, str.split(',', QString::SkipEmptyParts))
+    {
+        pair = item.trimmed().split('=');
+
+        if(pair.count() != 2)
+            return false;
+
+        if(pair[0] == "edit")
+            script->editRatio = pair[1].toDouble();
+        else if(pair[0] == "append")
+            script->appendRatio = pair[1].toDouble();
+        else if(pair[0] == "delete")
+            script->deleteRatio = pair[1].toDouble();
+        else if(pair[0] == "rename")
+            script->renameRatio = pair[1].toDouble();
+        else if(pair[0] == "create")
+            script->createRatio = pair[1].toDouble();
+        else
+            return false;
+    }
+
+    //A file gets one change at most
+    if((script->editRatio + script->appendRatio + script->deleteRatio + script->renameRatio) > 1.0)
+        return false;
+
+    return true;
+}
+
+bool DatasetGenerator::isDataset(const QString rootDir)
+{
+    QDir dir(rootDir);
+
+    //A new or empty directory can be used, else it must be a tree of the generator
+    if(!dir.exists())
+        return true;
+
+    if(dir.entryList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System).isEmpty())
+        return true;
+
+    return QFileInfo(rootDir +"/"+ DATASET_MARKER_FILE).isFile();
+}
+
+bool DatasetGenerator::generate(const QString rootDir, QStringList *files)
+{
+    QFile           marker(rootDir +"/"+ DATASET_MARKER_FILE);
+    QStringList     dirList;
+    QList<quint32>  contentSeeds;
+    QList<quint64>  sizes;
+    QString         path;
+    quint32         contentSeed;
+    quint64         fileSize;
+    int             source;
+
+    this->resetStats();
+    this->seed(m_config.seed);
+
+    //The previous tree is removed, never a directory with other data
+    if(!DatasetGenerator::isDataset(rootDir))
+    {
+        qCritical(QString(rootDir +" is not empty and was not made by the generator (no "+ DATASET_MARKER_FILE +"), it is not replaced !").toUtf8());
+        return false;
+    }
+
+    QDir(rootDir).removeRecursively();
+
+    dirList = this->buildDirs(rootDir);
+
+    if(dirList.isEmpty())
+        return false;
+
+    if(!marker.open(QIODevice::WriteOnly))
+        return false;
+
+    marker.close();
+
+    for(int i(0); i < m_config.fileCount; i++)
+    {
+        //A duplicate has the content (and the size) of a previous file
+        if((!contentSeeds.isEmpty()) && (this->nextUnit() < m_config.duplicateRatio))
+        {
+            source      = this->next() % contentSeeds.count();
+            contentSeed = contentSeeds[source];
+            fileSize    = sizes[source];
+            m_stats.duplicates++;
+        }
+        else
+        {
+            contentSeed = this->next();
+            fileSize    = this->drawSize();
+        }
+
+        path = dirList[this->next() % dirList.count()] +"/file_"+ QString::number(i) +".bin";
+
+        if(!this->writeFile(path, fileSize, contentSeed, false))
+            return false;
+
+        contentSeeds << contentSeed;
+        sizes        << fileSize;
+
+        if(files != 0)
+            (*files) << path;
+
+        m_stats.files++;
+        m_stats.bytes += fileSize;
+    }
+
+    return true;
+}
+
+bool DatasetGenerator::mutate(const QString rootDir, const t_MutationScript script, const int step)
+{
+    QStringList     fileList;
+    QStringList     dirList;
+    QFile           file;
+    QByteArray      block;
+    QString         path;
+    double          draw;
+    quint64         offset;
+    int             createCount;
+
+    this->resetStats();
+
+    //Only a tree of the generator is changed
+    if(!QFileInfo(rootDir +"/"+ DATASET_MARKER_FILE).isFile())
+    {
+        qCritical(QString(rootDir +" was not made by the generator (no "+ DATASET_MARKER_FILE +"), it is not changed !").toUtf8());
+        return false;
+    }
+
+    //Each step has its own sequence (the step 2 is the same whatever the number of runs)
+    this->seed(m_config.seed ^ (0x9E3779B9U * (quint32)step));
+
+    QDirIterator it(rootDir, QDir::Files | QDir::Hidden | QDir::System, QDirIterator::Subdirectories);
+    while(it.hasNext())
+        fileList << it.next();
+
+    //The marker is not a file of the tree
+    fileList.removeAll(rootDir +"/"+ DATASET_MARKER_FILE);
+
+    //The order of the file system is not stable
+    fileList.sort();
+
+    foreach(QString filePath, fileList)
+    {
+        draw = this->nextUnit();
+
+        if(draw < script.editRatio)
+        {
+            file.setFileName(filePath);
+            if(!file.open(QIODevice::ReadWrite))
+                return false;
+
+            //One block with new random data
+            block.resize(qMin((qint64)DATASET_BLOCK_BYTE, file.size()));
+            for(int i(0); i < block.size(); i++)
+                block[i] = (char)(this->next() & 0xFF);
+
+            offset = (file.size() > block.size()) ? (this->next() % (file.size() - block.size() + 1)) : 0;
+            //A short write (full disk) is not a mutation
+            if(!file.seek(offset) || (file.write(block) != block.size()) || !file.flush())
+            {
+                file.close();
+                return false;
+            }
+
+            file.close();
+
+            m_stats.edited++;
+        }
+        else if(draw < script.editRatio + script.appendRatio)
+        {
+            if(!this->writeFile(filePath, 1 + (this->next() % (16 * DATASET_BLOCK_BYTE)), this->next(), true))
+                return false;
+
+            m_stats.appended++;
+        }
+        else if(draw < script.editRatio + script.appendRatio + script.deleteRatio)
+        {
+            QFile::remove(filePath);
+            m_stats.deleted++;
+        }
+        else if(draw < script.editRatio + script.appendRatio + script.deleteRatio + script.renameRatio)
+        {
+            QFile::rename(filePath, filePath +".r"+ QString::number(step));
+            m_stats.renamed++;
+        }
+    }
+
+    //The new files go in the existing directorys
+    dirList << rootDir;
+    QDirIterator dirIt(rootDir, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+    while(dirIt.hasNext())
+        dirList << dirIt.next();
+
+    dirList.sort();
+
+    createCount = (int)(fileList.count() * script.createRatio);
+    for(int i(0); i < createCount; i++)
+    {
+        path = dirList[this->next() % dirList.count()] +"/new_"+ QString::number(step) +"_"+ QString::number(i) +".bin";
+
+        if(!this->writeFile(path, this->drawSize(), this->next(), false))
+            return false;
+
+        m_stats.created++;
+    }
+
+    return true;
+}
+
+t_DatasetStats DatasetGenerator::stats(void) const
+{
+    return m_stats;
+}
+
+QJsonObject DatasetGenerator::statsToJson(void) const
+{
+    QJsonObject jsonObj;
+
+    jsonObj.insert("seed", (double)m_config.seed);
+    jsonObj.insert("dirs", m_stats.dirs);
+    jsonObj.insert("files", m_stats.files);
+    jsonObj.insert("bytes", (double)m_stats.bytes);
+    jsonObj.insert("duplicates", m_stats.duplicates);
+    jsonObj.insert("edited", m_stats.edited);
+    jsonObj.insert("appended", m_stats.appended);
+    jsonObj.insert("deleted", m_stats.deleted);
+    jsonObj.insert("renamed", m_stats.renamed);
+    jsonObj.insert("created", m_stats.created);
+
+    return jsonObj;
+}
+
+void DatasetGenerator::resetStats(void)
+{
+    m_stats.dirs        = 0;
+    m_stats.files       = 0;
+    m_stats.bytes       = 0;
+    m_stats.duplicates  = 0;
+    m_stats.edited      = 0;
+    m_stats.appended    = 0;
+    m_stats.deleted     = 0;
+    m_stats.renamed     = 0;
+    m_stats.created     = 0;
+}
+
+void DatasetGenerator::seed(const quint32 seed)
+{
+    //Xorshift32 can't start from 0
+    m_state = seed ? seed : 1;
+}
+
+quint32 DatasetGenerator::next(void)
+{
+    m_state ^= m_state << 13;
+    m_state ^= m_state >> 17;
+    m_state ^= m_state << 5;
+
+    return m_state;
+}
+
+double DatasetGenerator::nextUnit(void)
+{
+    return (double)this->next() / 4294967296.0;
+}
+
+quint64 DatasetGenerator::drawSize(void)
+{
+    double  draw(this->nextUnit());
+    double  logMin, logMax;
+    double  alpha(1.2);//Pareto shape : most of the tail close to maxFileSize, some files near giantMaxSize
+    double  tailMax;
+
+    //Many tiny files
+    if(draw < m_config.tinyRatio)
+        return 1 + (this->next() % qMax(m_config.tinyMaxSize, (quint64)1));
+
+    //Some giant files (bounded Pareto)
+    if(draw < m_config.tinyRatio + m_config.giantRatio)
+    {
+        tailMax = pow((double)m_config.maxFileSize / qMax((double)m_config.giantMaxSize, (double)m_config.maxFileSize + 1.0), alpha);
+        return (quint64)(m_config.maxFileSize / pow(1.0 - this->nextUnit() * (1.0 - tailMax), 1.0 / alpha));
+    }
+
+    //The body is log-uniform
+    logMin = log((double)qMax(m_config.minFileSize, (quint64)1));
+    logMax = log((double)qMax(m_config.maxFileSize, m_config.minFileSize + 1));
+
+    return (quint64)exp(logMin + (logMax - logMin) * this->nextUnit());
+}
+
+QStringList DatasetGenerator::buildDirs(const QString rootDir)
+{
+    QStringList     dirList;
+    QList<int>      depthList;
+    int             subCount;
+
+    //Breadth first until there is enough directorys for the mean files per directory
+    dirList   << rootDir;
+    depthList << 0;
+
+    for(int i(0); (i < dirList.count()) && (dirList.count() * qMax(m_config.filesPerDir, 1) < m_config.fileCount); i++)
+    {
+        if(depthList[i] >= m_config.maxDepth)
+            continue;
+
+        subCount = 1 + (this->next() % qMax(m_config.dirFanOut, 1));
+
+        for(int j(0); j < subCount; j++)
+        {
+            dirList   << dirList[i] +"/dir_"+ QString::number(j);
+            depthList << depthList[i] + 1;
+        }
+    }
+
+    foreach(QString dir, dirList)
+    {
+        if(!QDir().mkpath(dir))
+            return QStringList();
+    }
+
+    m_stats.dirs = dirList.count();
+
+    return dirList;
+}
+
+bool DatasetGenerator::writeFile(const QString path, const quint64 size, const quint32 contentSeed, const bool append)
+{
+    QFile       file(path);
+    QByteArray  block;
+    quint32     state(contentSeed ? contentSeed : 1);
+    quint64     written;
+    qint64      length;
+    const int   TEXT_LEN(sizeof(COMPRESSIBLE_TEXT) - 1);
+
+    //The content only depends on its seed (a duplicate is the same bytes)
+    auto random = [&state]() -> quint32
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    };
+
+    if(!file.open(append ? (QIODevice::WriteOnly | QIODevice::Append) : QIODevice::WriteOnly))
+        return false;
+
+    block.resize(DATASET_BLOCK_BYTE);
+
+    for(written = 0; written < size; written += block.size())
+    {
+        //Each block is text or random data
+        if(((double)random() / 4294967296.0) < m_config.compressibility)
+        {
+            for(int i(0); i < block.size(); i++)
+                block[i] = COMPRESSIBLE_TEXT[(written + i) % TEXT_LEN];
+        }
+        else
+        {
+            for(int i(0); i < block.size(); i += 4)
+                *((quint32*)(block.data() + i)) = random();
+        }
+
+        length = qMin((quint64)block.size(), size - written);
+
+        //A short write (full disk) would count bytes which are not in the tree
+        if(file.write(block.constData(), length) != length)
+        {
+            file.close();
+            return false;
+        }
+    }
+
+    if(!file.flush())
+    {
+        file.close();
+        return false;
+    }
+
+    file.close();
+
+    return true;
+}
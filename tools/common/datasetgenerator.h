@@ -0,0 +1,83 @@
+#ifndef DATASETGENERATOR_H
+#define DATASETGENERATOR_H
+
+#include <QObject>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QByteArray>
+#include <QJsonObject>
+#include <cmath>
+
+#define DATASET_BLOCK_BYTE  4096
+#define DATASET_MARKER_FILE QString(".sia_dataset")//Written in the root of a generated tree, only such a tree is replaced or changed
+
+struct t_DatasetConfig
+{
+    quint32 seed;           //The same seed (and config) always give the same tree
+    int     fileCount;
+    int     dirFanOut;      //Max sub directorys per directory
+    int     maxDepth;       //Max depth of the directorys (0 => only the root)
+    int     filesPerDir;    //Mean files per directory (the tree grows until there is enough directorys)
+    double  tinyRatio;      //Share of tiny files (1 to tinyMaxSize Bytes)
+    quint64 tinyMaxSize;
+    quint64 minFileSize;    //The other files are log-uniform between min and max
+    quint64 maxFileSize;
+    double  giantRatio;     //Share of the long tail (Pareto from maxFileSize to giantMaxSize)
+    quint64 giantMaxSize;
+    double  compressibility;//Share of the blocks filled with text (0 => random data, 1 => all compressible)
+    double  duplicateRatio; //Share of the files with the content of a previous file
+};
+
+//Changes applied between two runs, each ratio is a share of the existing files
+struct t_MutationScript
+{
+    double  editRatio;      //One block overwritten in the file
+    double  appendRatio;    //Data appended at the end of the file
+    double  deleteRatio;
+    double  renameRatio;    //Same content, new name in the same directory
+    double  createRatio;    //New files (drawn with the same distribution)
+};
+
+struct t_DatasetStats
+{
+    int     dirs;
+    int     files;
+    quint64 bytes;
+    int     duplicates;
+    int     edited;
+    int     appended;
+    int     deleted;
+    int     renamed;
+    int     created;
+};
+
+//Reproducible synthetic source trees for the benchmarks
+class DatasetGenerator
+{
+public:
+    DatasetGenerator(const t_DatasetConfig config);
+    static t_DatasetConfig defaultConfig(void);
+    static bool parseMutations(const QString str, t_MutationScript *script);
+    static bool isDataset(const QString rootDir);
+    bool generate(const QString rootDir, QStringList *files = 0);
+    bool mutate(const QString rootDir, const t_MutationScript script, const int step);
+    t_DatasetStats stats(void) const;
+    QJsonObject statsToJson(void) const;
+private:
+    void resetStats(void);
+    void seed(const quint32 seed);
+    quint32 next(void);
+    double nextUnit(void);
+    quint64 drawSize(void);
+    QStringList buildDirs(const QString rootDir);
+    bool writeFile(const QString path, const quint64 size, const quint32 contentSeed, const bool append);
+
+    t_DatasetConfig m_config;
+    t_DatasetStats  m_stats;
+    quint32         m_state;
+};
+
+#endif // DATASETGENERATOR_H
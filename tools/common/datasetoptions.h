@@ -0,0 +1,46 @@
+#ifndef DATASETOPTIONS_H
+#define DATASETOPTIONS_H
+
+#include "datasetgenerator.h"
+#include <QCommandLineParser>
+
+//Command line options of the dataset shared by the tools (datagen, benchmark)
+inline void addDatasetOptions(QCommandLineParser *parser)
+{
+    parser->addOption(QCommandLineOption("files", "Number of files in the tree (default 1000).", "count", "1000"));
+    parser->addOption(QCommandLineOption("fan-out", "Max sub directorys per directory (default 4).", "count", "4"));
+    parser->addOption(QCommandLineOption("depth", "Max depth of the directorys (default 8).", "count", "8"));
+    parser->addOption(QCommandLineOption("files-per-dir", "Mean files per directory (default 32).", "count", "32"));
+    parser->addOption(QCommandLineOption("tiny-ratio", "Share of tiny files (default 0.3).", "ratio", "0.3"));
+    parser->addOption(QCommandLineOption("tiny-size", "Max size of a tiny file in Bytes (default 1024).", "bytes", "1024"));
+    parser->addOption(QCommandLineOption("min-size", "Min file size in Bytes (default 1024).", "bytes", "1024"));
+    parser->addOption(QCommandLineOption("max-size", "Max file size in Bytes (default 4000000).", "bytes", "4000000"));
+    parser->addOption(QCommandLineOption("giant-ratio", "Share of giant files, the long tail (default 0).", "ratio", "0"));
+    parser->addOption(QCommandLineOption("giant-size", "Max size of a giant file in Bytes (default 1000000000).", "bytes", "1000000000"));
+    parser->addOption(QCommandLineOption("compressibility", "Share of compressible blocks, 0 to 1 (default 0).", "ratio", "0"));
+    parser->addOption(QCommandLineOption("duplicates", "Share of files with the content of another file (default 0).", "ratio", "0"));
+    parser->addOption(QCommandLineOption("seed", "Seed of the tree generator (default 1).", "seed", "1"));
+}
+
+inline t_DatasetConfig datasetConfigFromOptions(const QCommandLineParser *parser)
+{
+    t_DatasetConfig config(DatasetGenerator::defaultConfig());
+
+    config.seed             = parser->value("seed").toUInt();
+    config.fileCount        = parser->value("files").toInt();
+    config.dirFanOut        = parser->value("fan-out").toInt();
+    config.maxDepth         = parser->value("depth").toInt();
+    config.filesPerDir      = parser->value("files-per-dir").toInt();
+    config.tinyRatio        = parser->value("tiny-ratio").toDouble();
+    config.tinyMaxSize      = parser->value("tiny-size").toULongLong();
+    config.minFileSize      = parser->value("min-size").toULongLong();
+    config.maxFileSize      = parser->value("max-size").toULongLong();
+    config.giantRatio       = parser->value("giant-ratio").toDouble();
+    config.giantMaxSize     = parser->value("giant-size").toULongLong();
+    config.compressibility  = parser->value("compressibility").toDouble();
+    config.duplicateRatio   = parser->value("duplicates").toDouble();
+
+    return config;
+}
+
+#endif // DATASETOPTIONS_H
@@ -0,0 +1,20 @@
+QT += core
+QT -= gui
+
+CONFIG += c++11
+
+TARGET = datagen
+CONFIG += console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += ../common
+
+SOURCES += main.cpp \
+    ../common/datasetgenerator.cpp
+
+HEADERS += \
+    ../common/datasetgenerator.h
+
+DEFINES += QT_DEPRECATED_WARNINGS
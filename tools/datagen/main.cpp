@@ -0,0 +1,70 @@
+#include "datasetgenerator.h"
+#include "datasetoptions.h"
+#include <QCoreApplication>
+#include <QJsonDocument>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication    app(argc, argv);
+    QCommandLineParser  parser;
+    t_MutationScript    script;
+    QString             outDir;
+    QFile               file;
+    bool                result;
+
+    app.setApplicationName("datagen");
+
+    parser.setApplicationDescription("Reproducible synthetic source trees (and their changes between runs) for the benchmarks of SIA Chunk Backup.");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("out", "Directory of the tree (a previous tree is removed first unless --mutate, a non-empty directory not made by datagen is refused).", "dir"));
+    addDatasetOptions(&parser);
+    parser.addOption(QCommandLineOption("mutate", "Change an existing tree instead of building it, ex : edit=0.05,append=0.02,delete=0.01,rename=0.01,create=0.02", "script"));
+    parser.addOption(QCommandLineOption("step", "Number of the mutation step (default 1), each step has its own changes.", "step", "1"));
+    parser.addOption(QCommandLineOption("json", "Write the stats as JSON in this file.", "file"));
+    parser.process(app);
+
+    if(!parser.isSet("out"))
+    {
+        qCritical("The directory of the tree is needed (--out) !");
+        return 1;
+    }
+
+    outDir = QFileInfo(parser.value("out")).absoluteFilePath();
+
+    DatasetGenerator generator(datasetConfigFromOptions(&parser));
+
+    if(parser.isSet("mutate"))
+    {
+        if(!DatasetGenerator::parseMutations(parser.value("mutate"), &script))
+        {
+            qCritical("Invalid mutation script !");
+            return 1;
+        }
+
+        result = generator.mutate(outDir, script, parser.value("step").toInt());
+
+        qInfo("Mutation step %d : %d edited, %d appended, %d deleted, %d renamed, %d created", parser.value("step").toInt(),
+              generator.stats().edited, generator.stats().appended, generator.stats().deleted, generator.stats().renamed, generator.stats().created);
+    }
+    else
+    {
+        result = generator.generate(outDir);
+
+        qInfo("Tree : %d directorys, %d files (%d duplicates), %llu bytes", generator.stats().dirs, generator.stats().files, generator.stats().duplicates, generator.stats().bytes);
+    }
+
+    if(!result)
+    {
+        qCritical("Cannot write the tree !");
+        return 1;
+    }
+
+    if(parser.isSet("json"))
+    {
+        file.setFileName(parser.value("json"));
+        if(file.open(QIODevice::WriteOnly))
+            file.write(QJsonDocument(generator.statsToJson()).toJson());
+    }
+
+    return 0;
+}
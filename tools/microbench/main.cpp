@@ -0,0 +1,52 @@
+#include "microbench.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+
+static QList<int> parseScales(const QString value)
+{
+    QList<int> scales;
+
+    foreach(QString scale, value.split(',', QString::SkipEmptyParts))
+    {
+        if(scale.trimmed().toInt() > 0)
+            scales << scale.trimmed().toInt();
+    }
+
+    return scales;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication    app(argc, argv);
+    QCommandLineParser  parser;
+    t_MicroConfig       config;
+
+    app.setApplicationName("microbench");
+
+    parser.setApplicationDescription("Micro-benchmarks of the SIA Chunk Backup engines (hash, tar, zip, packing, sync SQL).");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("work", "Working directory (default ./microbench_work).", "dir", "./microbench_work"));
+    parser.addOption(QCommandLineOption("tree-files", "Files on disk for hash, tar and zip, comma separated (default 1000,10000).", "list", "1000,10000"));
+    parser.addOption(QCommandLineOption("rows", "Rows in the database for pack and sync, comma separated (default 1000,10000,100000,1000000).", "list", "1000,10000,100000,1000000"));
+    parser.addOption(QCommandLineOption("repeat", "Timed iterations of each benchmark (default 3).", "count", "3"));
+    parser.addOption(QCommandLineOption("cluster-size", "Cluster size in Bytes (default 40000000).", "bytes", "40000000"));
+    parser.addOption(QCommandLineOption("max-size", "Max file size in Bytes (default 65536).", "bytes", "65536"));
+    parser.addOption(QCommandLineOption("seed", "Seed of the generated data (default 1).", "seed", "1"));
+    parser.addOption(QCommandLineOption("only", "Only the benchmarks starting with this name (hash, tar, zip, pack, sync).", "name"));
+    parser.addOption(QCommandLineOption("json", "Write the results as JSON in this file.", "file"));
+    parser.process(app);
+
+    config.workDir      = QFileInfo(parser.value("work")).absoluteFilePath();
+    config.treeScales   = parseScales(parser.value("tree-files"));
+    config.rowScales    = parseScales(parser.value("rows"));
+    config.repeat       = qMax(parser.value("repeat").toInt(), 1);
+    config.clusterSize  = parser.value("cluster-size").toULongLong();
+    config.maxFileSize  = parser.value("max-size").toULongLong();
+    config.seed         = parser.value("seed").toUInt();
+    config.filter       = parser.value("only");
+    config.jsonOut      = parser.value("json");
+
+    MicroBench microBench(config);
+
+    return microBench.run() ? 0 : 1;
+}
@@ -0,0 +1,484 @@
+#include "microbench.h"
+#include <QCoreApplication>
+#include <QTextStream>
+
+//Share of the synthetic rows deleted, changed and added between the index and the new scan
+#define SYNC_CHANGE_MODULO 100
+
+MicroBench::MicroBench(const t_MicroConfig config, QObject *parent) : QObject(parent)
+{
+    m_config    = config;
+    m_appConfig         = 0;
+    m_dataBase          = 0;
+    m_archiveBuilder    = 0;
+    m_rowRoot   = m_config.workDir +"/rows";
+}
+
+MicroBench::~MicroBench(void)
+{
+    delete m_archiveBuilder;
+    delete m_dataBase;
+    delete m_appConfig;
+}
+
+bool MicroBench::run(void)
+{
+    QStringList files;
+    quint64     bytes(0);
+
+    //The engines read the same config than the app, written in the work directory (the config of an app next to the tool is kept)
+    if(!this->writeAppConfig())
+        return false;
+
+    m_appConfig = new Config();
+
+    if(m_appConfig->load(m_config.workDir +"/"+ CONFIG_FILE_NAME) != true)
+    {
+        qCritical("Cannot load the benchmark config !");
+        return false;
+    }
+
+    m_dataBase = new BenchDataBase();
+
+    //The archives are built in the journal directory like the clusters of the app
+    m_archiveBuilder = new ArchiveBuilder();
+    m_archiveBuilder->setBaseDir(Config::getJournalPath());
+
+    if(!this->openDataBase())
+        return false;
+
+    //Engines working on files
+    foreach(int scale, m_config.treeScales)
+    {
+        if(!(this->isSelected("hash") || this->isSelected("tar") || this->isSelected("zip")))
+            break;
+
+        qInfo("Generating a tree of %d files...", scale);
+
+        if(!this->generateTree(scale, &files, &bytes))
+            return false;
+
+        if(this->isSelected("hash"))
+            this->benchHash(scale, &files, bytes);
+
+        if(this->isSelected("tar"))
+        {
+            this->benchTar(scale, &files, bytes);
+            this->benchTarLimit(scale, &files);
+        }
+
+        if(this->isSelected("zip"))
+            this->benchZip(scale, &files, bytes);
+
+        QDir(m_config.workDir +"/tree").removeRecursively();
+    }
+
+    //Engines working on the database only (the rows don't need real files)
+    foreach(int scale, m_config.rowScales)
+    {
+        if(this->isSelected("pack"))
+            this->benchPack(scale);
+
+        if(this->isSelected("sync"))
+            this->benchSync(scale);
+    }
+
+    QSqlDatabase::database().close();
+
+    this->report();
+
+    return true;
+}
+
+bool MicroBench::writeAppConfig(void)
+{
+    QFile ini(m_config.workDir +"/"+ CONFIG_FILE_NAME);
+
+    QDir().mkpath(m_config.workDir +"/db");
+
+    if(!ini.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        qCritical("Cannot write the benchmark config !");
+        return false;
+    }
+
+    QTextStream stream(&ini);
+    stream << "[general]\n";
+    stream << "backup_mode=RECURSIVE\n";
+    stream << "use_compression=false\n";
+    stream << "use_encryption=false\n";
+    stream << "cluster_size=" << QString::number(m_config.clusterSize) << "\n";
+    stream << "database_name=microbench.db\n";
+    stream << "database_dir=" << m_config.workDir +"/db" << "\n";
+    stream << "journal_dir=" << m_config.workDir +"/journal" << "\n";
+    stream << "progress_interval=0\n";
+    stream << "[sia]\n";
+    stream << "ip_address=127.0.0.1\n";
+    stream << "port=9980\n";
+    stream.flush();
+
+    return true;
+}
+
+bool MicroBench::openDataBase(void)
+{
+    //Always an empty database
+    if(QSqlDatabase::database().isOpen())
+        QSqlDatabase::database().close();
+
+    QFile::remove(Config::getDatabasePath() +"/"+ Config::getDatabaseName());
+
+    if(!m_dataBase->load() || !m_dataBase->setupDataBase())
+    {
+        qCritical("Cannot open the benchmark database !");
+        return false;
+    }
+
+    return true;
+}
+
+bool MicroBench::generateTree(const int fileCount, QStringList *files, quint64 *bytes)
+{
+    t_DatasetConfig datasetConfig(DatasetGenerator::defaultConfig());
+
+    //Incompressible data, many small files and some up to maxFileSize
+    datasetConfig.seed          = m_config.seed;
+    datasetConfig.fileCount     = fileCount;
+    datasetConfig.dirFanOut     = 8;
+    datasetConfig.minFileSize   = 1;
+    datasetConfig.maxFileSize   = m_config.maxFileSize;
+    datasetConfig.tinyRatio     = 0.0;
+
+    DatasetGenerator generator(datasetConfig);
+
+    files->clear();
+
+    if(!generator.generate(m_config.workDir +"/tree", files))
+        return false;
+
+    *bytes = generator.stats().bytes;
+
+    return true;
+}
+
+QString MicroBench::rowSource(const int row)
+{
+    return m_rowRoot +"/dir_"+ QString::number(row / 32) +"/file_"+ QString::number(row) +".bin";
+}
+
+void MicroBench::fillIndexRows(const int rowCount)
+{
+    QString source;
+
+    QSqlDatabase::database().transaction();
+
+    //1000 files per cluster
+    for(int i(0); i < rowCount; i++)
+    {
+        source = this->rowSource(i);
+        m_dataBase->execQuery(SQL_QUERY_INSERT_INDEX_TABLE("cluster_"+ QString::number(i / 1000), source, "bench/cluster_"+ QString::number(i / 1000), QString("%1").arg(i, 40, 16, QChar('0')), QString::number(this->rowSize(i)), source.mid(m_rowRoot.length() + 1)));
+    }
+
+    QSqlDatabase::database().commit();
+}
+
+void MicroBench::fillTempRows(const int rowCount, const bool withChanges)
+{
+    QString hash;
+    int     i;
+
+    QSqlDatabase::database().transaction();
+
+    for(i = 0; i < rowCount; i++)
+    {
+        hash = QString("%1").arg(i, 40, 16, QChar('0'));
+
+        //Compared with the index : some files are deleted, some are changed
+        if(withChanges && ((i % SYNC_CHANGE_MODULO) == 0))
+            continue;
+
+        if(withChanges && ((i % SYNC_CHANGE_MODULO) == 1))
+            hash = QString("%1").arg(i + rowCount, 40, 16, QChar('0'));
+
+        m_dataBase->execQuery(SQL_QUERY_INSERT_TABLE_TEMP(this->rowSource(i), hash, QString::number(this->rowSize(i))));
+    }
+
+    //And some are new
+    for(i = rowCount; withChanges && (i < rowCount + (rowCount / SYNC_CHANGE_MODULO)); i++)
+        m_dataBase->execQuery(SQL_QUERY_INSERT_TABLE_TEMP(this->rowSource(i), QString("%1").arg(i, 40, 16, QChar('0')), QString::number(this->rowSize(i))));
+
+    QSqlDatabase::database().commit();
+}
+
+quint64 MicroBench::rowSize(const int row)
+{
+    quint32 state((quint32)row * 2654435761U + (m_config.seed ? m_config.seed : 1));
+
+    //One xorshift32 step of a hash of the row : the same size at each fill
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+
+    return 1 + (state % qMax(m_config.maxFileSize, (quint64)1));
+}
+
+bool MicroBench::isSelected(const QString name)
+{
+    return m_config.filter.isEmpty() || name.startsWith(m_config.filter) || m_config.filter.startsWith(name);
+}
+
+void MicroBench::benchHash(const int scale, const QStringList *files, const quint64 bytes)
+{
+    QList<qint64>   timesNs;
+    QElapsedTimer   timer;
+
+    for(int r(0); r < m_config.repeat; r++)
+    {
+        timer.start();
+
+        foreach(QString file, *files)
+            m_dataBase->getFileHash(file);
+
+        timesNs << timer.nsecsElapsed();
+    }
+
+    this->record("hash", scale, timesNs, files->count(), bytes);
+}
+
+void MicroBench::benchTar(const int scale, const QStringList *files, const quint64 bytes)
+{
+    QList<qint64>   timesNs;
+    QElapsedTimer   timer;
+    QFileInfo       tarFile;
+    QStringList     clusterFiles;
+    quint64         clusterBytes(0);
+    ArchiveBuilder  *archiveBuilder(m_archiveBuilder);
+
+    Q_UNUSED(bytes);
+
+    //The files of one cluster (the size limit is not checked : one pass of libarchive)
+    foreach(QString file, *files)
+    {
+        if((clusterBytes + QFileInfo(file).size() > m_config.clusterSize) && (!clusterFiles.isEmpty()))
+            break;
+
+        clusterFiles << file;
+        clusterBytes += QFileInfo(file).size();
+    }
+
+    archiveBuilder->setWorkingDirectory(m_config.workDir +"/tree");
+
+    for(int r(0); r < m_config.repeat; r++)
+    {
+        timer.start();
+        tarFile = archiveBuilder->createTar("bench.tar", &clusterFiles);
+        timesNs << timer.nsecsElapsed();
+
+        QFile::remove(tarFile.absoluteFilePath());
+    }
+
+    this->record("tar", scale, timesNs, clusterFiles.count(), clusterBytes);
+}
+
+void MicroBench::benchTarLimit(const int scale, const QStringList *files)
+{
+    QList<qint64>   timesNs;
+    QElapsedTimer   timer;
+    t_archiveInfo   archiveInfo;
+    QStringList     candidates;
+    quint64         candidateBytes(0);
+    ArchiveBuilder  *archiveBuilder(m_archiveBuilder);
+
+    //About two clusters of candidates, the loop search how many fit in one
+    foreach(QString file, *files)
+    {
+        if(candidateBytes > 2 * m_config.clusterSize)
+            break;
+
+        candidates     << file;
+        candidateBytes += QFileInfo(file).size();
+    }
+
+    archiveBuilder->setWorkingDirectory(m_config.workDir +"/tree");
+
+    for(int r(0); r < m_config.repeat; r++)
+    {
+        timer.start();
+        archiveInfo = archiveBuilder->createTar("bench.tar", &candidates, m_config.clusterSize);
+        timesNs << timer.nsecsElapsed();
+
+        QFile::remove(archiveInfo.archiveFile.absoluteFilePath());
+    }
+
+    this->record("tar_limit", scale, timesNs, archiveInfo.entryCount, archiveInfo.archiveFile.size());
+}
+
+void MicroBench::benchZip(const int scale, const QStringList *files, const quint64 bytes)
+{
+    QList<qint64>   timesNs;
+    QElapsedTimer   timer;
+    QStringList     clusterFiles;
+    quint64         clusterBytes(0);
+    ArchiveBuilder  *archiveBuilder(m_archiveBuilder);
+
+    Q_UNUSED(bytes);
+
+    //Compression of the files of one cluster
+    foreach(QString file, *files)
+    {
+        if((clusterBytes + QFileInfo(file).size() > m_config.clusterSize) && (!clusterFiles.isEmpty()))
+            break;
+
+        clusterFiles << file;
+        clusterBytes += QFileInfo(file).size();
+    }
+
+    archiveBuilder->setWorkingDirectory(m_config.workDir +"/tree");
+
+    for(int r(0); r < m_config.repeat; r++)
+    {
+        timer.start();
+
+        foreach(QString file, clusterFiles)
+            archiveBuilder->createZIP(file);
+
+        timesNs << timer.nsecsElapsed();
+
+        archiveBuilder->cleanMirrorDir();
+    }
+
+    this->record("zip", scale, timesNs, clusterFiles.count(), clusterBytes);
+}
+
+void MicroBench::benchPack(const int scale)
+{
+    QList<qint64>       timesNs;
+    QElapsedTimer       timer;
+    ClusterCandidates   candidates;
+
+    qInfo("Packing : %d pending files...", scale);
+
+    //Every row is a new file
+    this->openDataBase();
+    this->fillTempRows(scale, false);
+
+    //One cluster selected among all the pending files
+    for(int r(0); r < m_config.repeat; r++)
+    {
+        timer.start();
+        m_dataBase->buildClusterFilesList(m_rowRoot, &candidates);
+        timesNs << timer.nsecsElapsed();
+    }
+
+    this->record("pack", scale, timesNs, scale, 0);
+}
+
+void MicroBench::benchSync(const int scale)
+{
+    QList<qint64>   deletedNs, changedNs, syncNs;
+    QElapsedTimer   timer;
+    int             deleted(0), changed(0);
+
+    qInfo("Sync : %d indexed files...", scale);
+
+    this->openDataBase();
+    this->fillIndexRows(scale);
+    this->fillTempRows(scale, true);
+
+    //Read only queries : the same tables for all the iterations
+    for(int r(0); r < m_config.repeat; r++)
+    {
+        timer.start();
+        deleted = m_dataBase->lookForDeletedFiles(m_rowRoot).count();
+        deletedNs << timer.nsecsElapsed();
+
+        timer.start();
+        changed = m_dataBase->lookForChangedFiles(m_rowRoot).count();
+        changedNs << timer.nsecsElapsed();
+    }
+
+    this->record("sync_deleted", scale, deletedNs, deleted, 0);
+    this->record("sync_changed", scale, changedNs, changed, 0);
+
+    //The sync removes rows from temp_table, it is filled again before each iteration
+    for(int r(0); r < m_config.repeat; r++)
+    {
+        if(r > 0)
+        {
+            m_dataBase->resetTemporaryTable();
+            this->fillTempRows(scale, true);
+        }
+
+        timer.start();
+        m_dataBase->syncTables();
+        syncNs << timer.nsecsElapsed();
+    }
+
+    this->record("sync_tables", scale, syncNs, scale, 0);
+}
+
+void MicroBench::record(const QString name, const int scale, const QList<qint64> timesNs, const quint64 items, const quint64 bytes)
+{
+    t_MicroResult   result;
+    qint64          best(0), total(0);
+
+    if(timesNs.isEmpty())
+        return;
+
+    foreach(qint64 timeNs, timesNs)
+    {
+        if((best == 0) || (timeNs < best))
+            best = timeNs;
+
+        total += timeNs;
+    }
+
+    result.name         = name;
+    result.scale        = scale;
+    result.iterations   = timesNs.count();
+    result.bestSeconds  = best / 1e9;
+    result.meanSeconds  = (total / timesNs.count()) / 1e9;
+    result.items        = items;
+    result.bytes        = bytes;
+
+    m_results << result;
+
+    qInfo("%-12s %10d : best %.6f s, mean %.6f s, %.1f items/s, %.2f MB/s", name.toUtf8().data(), scale, result.bestSeconds, result.meanSeconds,
+          items / qMax(result.bestSeconds, 1e-9), (bytes / 1e6) / qMax(result.bestSeconds, 1e-9));
+}
+
+void MicroBench::report(void)
+{
+    QJsonObject jsonObj;
+    QJsonObject jsonResult;
+    QJsonArray  jsonResults;
+    QFile       file;
+
+    if(m_config.jsonOut.isEmpty())
+        return;
+
+    foreach(t_MicroResult result, m_results)
+    {
+        jsonResult = QJsonObject();
+        jsonResult.insert("name", result.name);
+        jsonResult.insert("scale", result.scale);
+        jsonResult.insert("iterations", result.iterations);
+        jsonResult.insert("best_seconds", result.bestSeconds);
+        jsonResult.insert("mean_seconds", result.meanSeconds);
+        jsonResult.insert("items", (double)result.items);
+        jsonResult.insert("bytes", (double)result.bytes);
+        jsonResult.insert("items_per_second", result.items / qMax(result.bestSeconds, 1e-9));
+        jsonResult.insert("mb_per_second", (result.bytes / 1e6) / qMax(result.bestSeconds, 1e-9));
+        jsonResults.append(jsonResult);
+    }
+
+    jsonObj.insert("app_version", APP_VERSION);
+    jsonObj.insert("cluster_size", (double)m_config.clusterSize);
+    jsonObj.insert("max_file_size", (double)m_config.maxFileSize);
+    jsonObj.insert("seed", (double)m_config.seed);
+    jsonObj.insert("results", jsonResults);
+
+    file.setFileName(m_config.jsonOut);
+    if(file.open(QIODevice::WriteOnly))
+        file.write(QJsonDocument(jsonObj).toJson());
+}
@@ -0,0 +1,85 @@
+#ifndef MICROBENCH_H
+#define MICROBENCH_H
+
+#include "appchunkbackup.h"
+#include "config.h"
+#include "database.h"
+#include "archivebuilder.h"
+#include "datasetgenerator.h"
+#include <QObject>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+struct t_MicroConfig
+{
+    QString     workDir;    //Trees and database are generated in this directory
+    QList<int>  treeScales; //Files on disk (hash, tar, zip)
+    QList<int>  rowScales;  //Synthetic rows in the database (pack, sync SQL)
+    int         repeat;     //Timed iterations of each benchmark
+    quint64     clusterSize;
+    quint64     maxFileSize;
+    quint32     seed;
+    QString     filter;     //Only the benchmarks whose name start with this (empty => all)
+    QString     jsonOut;    //Write the results as JSON in this file (empty => not written)
+};
+
+struct t_MicroResult
+{
+    QString name;
+    int     scale;
+    int     iterations;
+    double  bestSeconds;
+    double  meanSeconds;
+    quint64 items;  //Handled by one iteration
+    quint64 bytes;
+};
+
+//Access to the engines of the database timed by the benchmarks
+class BenchDataBase : public DataBase
+{
+public:
+    using DataBase::execQuery;
+    using DataBase::resetTemporaryTable;
+    using DataBase::syncTables;
+    using DataBase::lookForDeletedFiles;
+    using DataBase::lookForChangedFiles;
+    using DataBase::buildClusterFilesList;
+};
+
+//Time the engines of the app one by one (no SIA, no upload)
+class MicroBench : public QObject
+{
+public:
+    explicit MicroBench(const t_MicroConfig config, QObject *parent = 0);
+    ~MicroBench(void);
+    bool run(void);
+private:
+    bool writeAppConfig(void);
+    bool openDataBase(void);
+    bool generateTree(const int fileCount, QStringList *files, quint64 *bytes);
+    QString rowSource(const int row);
+    quint64 rowSize(const int row);
+    void fillIndexRows(const int rowCount);
+    void fillTempRows(const int rowCount, const bool withChanges);
+    bool isSelected(const QString name);
+    void benchHash(const int scale, const QStringList *files, const quint64 bytes);
+    void benchTar(const int scale, const QStringList *files, const quint64 bytes);
+    void benchTarLimit(const int scale, const QStringList *files);
+    void benchZip(const int scale, const QStringList *files, const quint64 bytes);
+    void benchPack(const int scale);
+    void benchSync(const int scale);
+    void record(const QString name, const int scale, const QList<qint64> timesNs, const quint64 items, const quint64 bytes);
+    void report(void);
+
+    t_MicroConfig           m_config;
+    Config                  *m_appConfig;
+    BenchDataBase           *m_dataBase;
+    ArchiveBuilder          *m_archiveBuilder;
+    QList<t_MicroResult>    m_results;
+    QString                 m_rowRoot;
+};
+
+#endif // MICROBENCH_H
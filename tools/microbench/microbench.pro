@@ -0,0 +1,64 @@
+QT += core
+QT += sql
+QT += network
+QT -= gui
+
+CONFIG += c++11
+
+TARGET = microbench
+CONFIG += console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+#The engines are built from the sources of the app
+APP_SRC = ../../src
+
+INCLUDEPATH += $$APP_SRC
+INCLUDEPATH += ../common
+
+SOURCES += main.cpp \
+    microbench.cpp \
+    ../common/datasetgenerator.cpp \
+    $$APP_SRC/config.cpp \
+    $$APP_SRC/database.cpp \
+    $$APP_SRC/siacom.cpp \
+    $$APP_SRC/archivebuilder.cpp \
+    $$APP_SRC/chunkbuilder.cpp \
+    $$APP_SRC/defragplanner.cpp \
+    $$APP_SRC/restoreengine.cpp \
+    $$APP_SRC/cryptostream.cpp \
+    $$APP_SRC/metrics.cpp \
+    $$APP_SRC/clustercandidates.cpp \
+    $$APP_SRC/uploadscheduler.cpp \
+    $$APP_SRC/compressionpolicy.cpp \
+    $$APP_SRC/solidcompressor.cpp
+
+HEADERS += \
+    microbench.h \
+    ../common/datasetgenerator.h \
+    $$APP_SRC/config.h \
+    $$APP_SRC/database.h \
+    $$APP_SRC/siacom.h \
+    $$APP_SRC/archivebuilder.h \
+    $$APP_SRC/chunkbuilder.h \
+    $$APP_SRC/defragplanner.h \
+    $$APP_SRC/restoreengine.h \
+    $$APP_SRC/cryptostream.h \
+    $$APP_SRC/metrics.h \
+    $$APP_SRC/clustercandidates.h \
+    $$APP_SRC/uploadscheduler.h \
+    $$APP_SRC/compressionpolicy.h \
+    $$APP_SRC/solidcompressor.h
+
+DEFINES += QT_DEPRECATED_WARNINGS
+DEFINES += QT_NO_DEBUG_OUTPUT
+
+win32:LIBS += $$_PRO_FILE_PWD_/$$APP_SRC/bin/win/libarchive.dll
+unix:LIBS  += $$_PRO_FILE_PWD_/$$APP_SRC/bin/linux/libarchive.so
+
+win32:LIBS += -llibcrypto
+unix:LIBS  += -lcrypto
+
+win32:LIBS += -llibzstd
+unix:LIBS  += -lzstd
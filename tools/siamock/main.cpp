@@ -0,0 +1,42 @@
+#include "siamockserver.h"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication    app(argc, argv);
+    QCommandLineParser  parser;
+    t_MockConfig        config;
+    SiaMockServer       *server;
+
+    app.setApplicationName("siamock");
+
+    parser.setApplicationDescription("Local mock of the SIA renter API (/consensus, /renter/files, /renter/upload, /renter/delete).");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("port", "Listening port (default 9980).", "port", "9980"));
+    parser.addOption(QCommandLineOption("latency", "Delay before each reply in ms (default 0).", "ms", "0"));
+    parser.addOption(QCommandLineOption("bandwidth", "Upload bandwidth in Bytes/s shared by the uploads in progress, 0 => instant (default 0).", "bytes", "0"));
+    parser.addOption(QCommandLineOption("curve", "Upload progress curve : LINEAR, SIGMOID or STEP (default LINEAR).", "curve", "LINEAR"));
+    parser.addOption(QCommandLineOption("store", "Keep a copy of the uploaded files in this directory.", "dir"));
+    parser.process(app);
+
+    config.port         = parser.value("port").toUShort();
+    config.latencyMs    = parser.value("latency").toInt();
+    config.bandwidth    = parser.value("bandwidth").toULongLong();
+    config.storeDir     = parser.value("store");
+
+    if(!SiaMockServer::parseCurve(parser.value("curve"), &config.curve))
+    {
+        qCritical("Unknown progress curve !");
+        return 1;
+    }
+
+    server = new SiaMockServer(config, &app);
+
+    if(!server->start())
+        return 1;
+
+    qInfo("SIA mock listening on port %d", server->port());
+
+    return app.exec();
+}
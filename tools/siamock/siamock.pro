@@ -0,0 +1,19 @@
+QT += core
+QT += network
+QT -= gui
+
+CONFIG += c++11
+
+TARGET = siamock
+CONFIG += console
+CONFIG -= app_bundle
+
+TEMPLATE = app
+
+SOURCES += main.cpp \
+    siamockserver.cpp
+
+HEADERS += \
+    siamockserver.h
+
+DEFINES += QT_DEPRECATED_WARNINGS
@@ -0,0 +1,481 @@
+#include "siamockserver.h"
+#include <QPointer>
+#include <cmath>
+
+SiaMockServer::SiaMockServer(const t_MockConfig config, QObject *parent) : QObject(parent)
+{
+    m_config = config;
+    m_server = new QTcpServer(this);
+
+    m_stats.requests      = 0;
+    m_stats.uploads       = 0;
+    m_stats.deletes       = 0;
+    m_stats.downloads     = 0;
+    m_stats.streams       = 0;
+    m_stats.streamedBytes = 0;
+    m_stats.uploadedBytes = 0;
+
+    QObject::connect(m_server, SIGNAL(newConnection()), this, SLOT(newConnection()));
+}
+
+SiaMockServer::~SiaMockServer(void)
+{
+    delete m_server;
+}
+
+bool SiaMockServer::start(void)
+{
+    m_clock.start();
+    m_linkMs = 0;
+
+    if(!m_config.storeDir.isEmpty())
+        QDir().mkpath(m_config.storeDir);
+
+    //Port 0 => the system choose a free port
+    if(!m_server->listen(QHostAddress::LocalHost, m_config.port))
+    {
+        qCritical(QString("Cannot listen : "+ m_server->errorString()).toUtf8());
+        return false;
+    }
+
+    return true;
+}
+
+quint16 SiaMockServer::port(void) const
+{
+    return m_server->serverPort();
+}
+
+t_MockStats SiaMockServer::stats(void) const
+{
+    return m_stats;
+}
+
+bool SiaMockServer::parseCurve(const QString str, ProgressCurve *curve)
+{
+    if(str == "LINEAR")
+        *curve = ProgressCurve::LINEAR;
+    else if(str == "SIGMOID")
+        *curve = ProgressCurve::SIGMOID;
+    else if(str == "STEP")
+        *curve = ProgressCurve::STEP;
+    else
+        return false;
+
+    return true;
+}
+
+void SiaMockServer::newConnection(void)
+{
+    QTcpSocket *socket;
+
+    while(m_server->hasPendingConnections())
+    {
+        socket = m_server->nextPendingConnection();
+        m_buffers.insert(socket, QByteArray());
+
+        QObject::connect(socket, SIGNAL(readyRead()), this, SLOT(readyRead()));
+        QObject::connect(socket, SIGNAL(disconnected()), this, SLOT(disconnected()));
+    }
+}
+
+void SiaMockServer::disconnected(void)
+{
+    QTcpSocket *socket = qobject_cast<QTcpSocket*>(this->sender());
+
+    m_buffers.remove(socket);
+    socket->deleteLater();
+}
+
+void SiaMockServer::readyRead(void)
+{
+    QTcpSocket  *socket = qobject_cast<QTcpSocket*>(this->sender());
+    QByteArray  &buffer = m_buffers[socket];
+    QList<QByteArray> lines;
+    QList<QByteArray> requestLine;
+    int         headerEnd;
+    int         bodyLength;
+    QByteArray  range;
+
+    buffer.append(socket->readAll());
+
+    //The client keep the connection alive, so several requests can be in the buffer
+    while((headerEnd = buffer.indexOf("\r\n\r\n")) >= 0)
+    {
+        lines       = buffer.left(headerEnd).split('\n');
+        requestLine = lines.first().trimmed().split(' ');
+        bodyLength  = 0;
+        range.clear();
+
+        foreach(QByteArray line, lines)
+        {
+            if(line.toLower().startsWith("content-length:"))
+                bodyLength = line.mid(15).trimmed().toInt();
+            else if(line.toLower().startsWith("range:"))
+                range = line.mid(6).trimmed();
+        }
+
+        //Wait for the whole body (not used by the SIA API, but it must be consumed)
+        if(buffer.size() < (headerEnd + 4 + bodyLength))
+            return;
+
+        buffer.remove(0, headerEnd + 4 + bodyLength);
+
+        if(requestLine.count() < 2)
+        {
+            this->reply(socket, 400, QByteArray());
+            continue;
+        }
+
+        m_stats.requests++;
+        this->handleRequest(socket, requestLine[0], QUrl(QString::fromUtf8(requestLine[1])), range);
+    }
+}
+
+void SiaMockServer::handleRequest(QTcpSocket *socket, const QByteArray method, const QUrl url, const QByteArray range)
+{
+    QPointer<QTcpSocket>    target(socket);
+    QString                 path;
+    QString                 error;
+    int                     status(204);
+    QByteArray              body;
+    bool                    partial(false);
+
+    path = url.path();
+
+    if((method == "GET") && (path == MOCK_CONSENSUS))
+    {
+        status = 200;
+        body   = QJsonDocument(this->consensus()).toJson(QJsonDocument::Compact);
+    }
+    else if((method == "GET") && (path == MOCK_RENTER_SETTINGS))
+    {
+        status = 200;
+        body   = QJsonDocument(this->renterSettings()).toJson(QJsonDocument::Compact);
+    }
+    else if((method == "GET") && (path == MOCK_RENTER_FILES))
+    {
+        status = 200;
+        body   = QJsonDocument(this->renterFiles()).toJson(QJsonDocument::Compact);
+    }
+    else if((method == "POST") && path.startsWith(MOCK_RENTER_UPLOAD))
+    {
+        if(!this->upload(path.mid(MOCK_RENTER_UPLOAD.length()), QUrlQuery(url).queryItemValue("source"), &error))
+            status = 400;
+    }
+    else if((method == "POST") && path.startsWith(MOCK_RENTER_DELETE))
+    {
+        if(!this->remove(path.mid(MOCK_RENTER_DELETE.length()), &error))
+            status = 400;
+    }
+    else if((method == "GET") && path.startsWith(MOCK_RENTER_DOWNLOAD))
+    {
+        if(!this->download(path.mid(MOCK_RENTER_DOWNLOAD.length()), QUrlQuery(url).queryItemValue("destination"), &error))
+            status = 400;
+    }
+    else if((method == "POST") && ((path == MOCK_RENTER_SETTINGS) || (path == MOCK_RENTER_PAUSE) || (path == MOCK_RENTER_RESUME)))
+    {
+        //The upload windows of the scheduler are accepted but not simulated (the bandwidth of the mock is fixed)
+        status = 204;
+    }
+    else if((method == "GET") && path.startsWith(MOCK_RENTER_STREAM))
+    {
+        if(!this->stream(path.mid(MOCK_RENTER_STREAM.length()), range, &body, &partial, &error))
+            status = 400;
+        else
+            status = partial ? 206 : 200;
+    }
+    else
+    {
+        status = 404;
+        error  = MOCK_MSG_UNKNOWN_CALL;
+    }
+
+    if(!error.isEmpty())
+    {
+        QJsonObject jsonObj;
+        jsonObj.insert("message", error);
+        body = QJsonDocument(jsonObj).toJson(QJsonDocument::Compact);
+    }
+
+    //Simulate the network and deamon latency
+    QTimer::singleShot(m_config.latencyMs, this, [this, target, status, body]()
+    {
+        if(!target.isNull())
+            this->reply(target.data(), status, body);
+    });
+}
+
+void SiaMockServer::reply(QTcpSocket *socket, const int status, const QByteArray body)
+{
+    QByteArray header;
+
+    header.append("HTTP/1.1 "+ QByteArray::number(status) +" Mock\r\n");
+    header.append("Content-Type: application/json\r\n");
+    header.append("Content-Length: "+ QByteArray::number(body.size()) +"\r\n");
+    header.append("Connection: keep-alive\r\n\r\n");
+
+    socket->write(header);
+    socket->write(body);
+}
+
+QJsonObject SiaMockServer::consensus(void)
+{
+    QJsonObject jsonObj;
+
+    jsonObj.insert("synced", true);
+    jsonObj.insert("height", 100000);
+
+    return jsonObj;
+}
+
+QJsonObject SiaMockServer::renterSettings(void)
+{
+    QJsonObject jsonObj;
+    QJsonObject settings;
+
+    //Not limited (the bandwidth of the mock is fixed)
+    settings.insert("maxuploadspeed", 0);
+    settings.insert("maxdownloadspeed", 0);
+    jsonObj.insert("settings", settings);
+
+    return jsonObj;
+}
+
+QJsonObject SiaMockServer::renterFiles(void)
+{
+    QJsonObject jsonObj;
+    QJsonObject jsonFile;
+    QJsonArray  jsonArray;
+    double      uploadProgress;
+
+    this->advanceLink();
+
+    foreach(t_MockFile file, m_files)
+    {
+        uploadProgress = this->progress(file);
+
+        jsonFile = QJsonObject();
+        jsonFile.insert("siapath", file.siaPath);
+        jsonFile.insert("localpath", file.localPath);
+        jsonFile.insert("filesize", (double)file.size);
+        jsonFile.insert("available", uploadProgress >= 100.0);
+        jsonFile.insert("redundancy", (uploadProgress >= 100.0) ? 3.0 : 0.0);
+        jsonFile.insert("uploadprogress", uploadProgress);
+
+        jsonArray.append(jsonFile);
+    }
+
+    jsonObj.insert("files", jsonArray);
+
+    return jsonObj;
+}
+
+bool SiaMockServer::upload(const QString siaPath, const QString source, QString *error)
+{
+    QFileInfo   sourceInfo(source);
+    t_MockFile  file;
+
+    if(m_files.contains(siaPath))
+    {
+        *error = MOCK_MSG_FILE_EXISTS;
+        return false;
+    }
+
+    if(!sourceInfo.exists() || !sourceInfo.isFile())
+    {
+        *error = MOCK_MSG_NO_SOURCE;
+        return false;
+    }
+
+    //The uploads in progress get the bandwidth used until now
+    this->advanceLink();
+
+    file.siaPath    = siaPath;
+    file.localPath  = sourceInfo.absoluteFilePath();
+    file.size       = sourceInfo.size();
+    file.sentBytes  = 0.0;
+
+    //The real deamon read the source later, here it's copied at once (the client may remove it after the upload)
+    if(!m_config.storeDir.isEmpty())
+    {
+        QDir(m_config.storeDir).mkpath(QFileInfo(m_config.storeDir +"/"+ siaPath).absolutePath());
+        QFile::remove(m_config.storeDir +"/"+ siaPath);
+        QFile::copy(file.localPath, m_config.storeDir +"/"+ siaPath);
+    }
+
+    m_files.insert(siaPath, file);
+
+    m_stats.uploads++;
+    m_stats.uploadedBytes += file.size;
+
+    return true;
+}
+
+bool SiaMockServer::remove(const QString siaPath, QString *error)
+{
+    if(!m_files.contains(siaPath))
+    {
+        *error = MOCK_MSG_UNKNOWN_FILE;
+        return false;
+    }
+
+    this->advanceLink();
+
+    m_files.remove(siaPath);
+
+    if(!m_config.storeDir.isEmpty())
+        QFile::remove(m_config.storeDir +"/"+ siaPath);
+
+    m_stats.deletes++;
+
+    return true;
+}
+
+QString SiaMockServer::storedPath(const QString siaPath, QString *error)
+{
+    //The stored copy survive a restart of the mock, the source of the upload may be gone
+    if(!m_config.storeDir.isEmpty() && QFileInfo(m_config.storeDir +"/"+ siaPath).isFile())
+        return m_config.storeDir +"/"+ siaPath;
+
+    if(m_files.contains(siaPath) && QFileInfo(m_files.value(siaPath).localPath).isFile())
+        return m_files.value(siaPath).localPath;
+
+    if(!m_files.contains(siaPath))
+        *error = MOCK_MSG_UNKNOWN_FILE;
+    else
+        *error = MOCK_MSG_NOT_STORED;
+
+    return QString();
+}
+
+bool SiaMockServer::download(const QString siaPath, const QString destination, QString *error)
+{
+    QString content;
+
+    content = this->storedPath(siaPath, error);
+
+    if(content.isEmpty())
+        return false;
+
+    QFile::remove(destination);
+
+    if(!QFile::copy(content, destination))
+    {
+        *error = MOCK_MSG_NO_DESTINATION;
+        return false;
+    }
+
+    m_stats.downloads++;
+
+    return true;
+}
+
+bool SiaMockServer::stream(const QString siaPath, const QByteArray range, QByteArray *body, bool *partial, QString *error)
+{
+    QString     content;
+    QFile       file;
+    QList<QByteArray> bounds;
+    qint64      first(0), last(-1);
+
+    content = this->storedPath(siaPath, error);
+
+    if(content.isEmpty())
+        return false;
+
+    file.setFileName(content);
+    file.open(QIODevice::ReadOnly);
+
+    last = file.size() - 1;
+
+    //Only one range is supported ("bytes=first-last")
+    if(range.startsWith("bytes="))
+    {
+        bounds = range.mid(6).split('-');
+        first  = bounds.value(0).toLongLong();
+
+        if(!bounds.value(1).isEmpty())
+            last = qMin(last, bounds.value(1).toLongLong());
+
+        *partial = true;
+    }
+
+    file.seek(first);
+    *body = file.read(qMax(last - first + 1, (qint64)0));
+    file.close();
+
+    m_stats.streams++;
+    m_stats.streamedBytes += body->size();
+
+    return true;
+}
+
+void SiaMockServer::advanceLink(void)
+{
+    QHash<QString, t_MockFile>::iterator    it;
+    double                                  budget, share, left;
+    int                                     active;
+    const qint64                            NOW(m_clock.elapsed());
+
+    //Bytes sent on the link since the last share
+    budget   = (double)m_config.bandwidth * (double)(NOW - m_linkMs) / 1000.0;
+    m_linkMs = NOW;
+
+    //The link is shared by the uploads in progress, the part not used by a finished upload goes to the others
+    while(budget >= 1.0)
+    {
+        active = 0;
+
+        for(it = m_files.begin(); it != m_files.end(); ++it)
+        {
+            if(it.value().sentBytes < (double)it.value().size)
+                active++;
+        }
+
+        if(active == 0)
+            break;
+
+        share = budget / active;
+
+        for(it = m_files.begin(); it != m_files.end(); ++it)
+        {
+            left = (double)it.value().size - it.value().sentBytes;
+
+            if(left <= 0.0)
+                continue;
+
+            it.value().sentBytes += qMin(share, left);
+            budget -= qMin(share, left);
+        }
+    }
+}
+
+double SiaMockServer::progress(const t_MockFile &file) const
+{
+    double x;
+    double s0, s1;
+
+    //No bandwidth limit => the upload is done as soon as the deamon accept it
+    if((m_config.bandwidth == 0) || (file.size == 0))
+        return 100.0;
+
+    //Part of the file sent (0 to 1)
+    x = file.sentBytes / (double)file.size;
+
+    if(x >= 1.0)
+        return 100.0;
+
+    switch(m_config.curve)
+    {
+    case ProgressCurve::LINEAR:
+        return 100.0 * x;
+    case ProgressCurve::SIGMOID:
+        //Logistic curve normalized to go from 0 to 1 on [0, 1]
+        s0 = 1.0 / (1.0 + exp(6.0));
+        s1 = 1.0 / (1.0 + exp(-6.0));
+        return 100.0 * (((1.0 / (1.0 + exp(-12.0 * (x - 0.5)))) - s0) / (s1 - s0));
+    case ProgressCurve::STEP:
+    default:
+        return 0.0;
+    }
+}
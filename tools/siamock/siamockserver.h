@@ -0,0 +1,109 @@
+#ifndef SIAMOCKSERVER_H
+#define SIAMOCKSERVER_H
+
+#include <QObject>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QHash>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QDir>
+#include <QFile>
+#include <QTimer>
+#include <QUrl>
+#include <QUrlQuery>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+//Mock of the SIA renter API (only the part used by SIA Chunk Backup)
+#define MOCK_CONSENSUS          QString("/consensus")
+#define MOCK_RENTER_FILES       QString("/renter/files")
+#define MOCK_RENTER_UPLOAD      QString("/renter/upload/")
+#define MOCK_RENTER_DELETE      QString("/renter/delete/")
+#define MOCK_RENTER_DOWNLOAD    QString("/renter/download/")
+#define MOCK_RENTER_STREAM      QString("/renter/stream/")
+#define MOCK_RENTER_SETTINGS    QString("/renter")
+#define MOCK_RENTER_PAUSE       QString("/renter/uploads/pause")
+#define MOCK_RENTER_RESUME      QString("/renter/uploads/resume")
+
+#define MOCK_MSG_UNKNOWN_FILE   QString("no file known by that path")
+#define MOCK_MSG_FILE_EXISTS    QString("a file already exists at that location")
+#define MOCK_MSG_NO_SOURCE      QString("source file does not exist")
+#define MOCK_MSG_UNKNOWN_CALL   QString("unrecognized call")
+#define MOCK_MSG_NOT_STORED     QString("the file content is not available")
+#define MOCK_MSG_NO_DESTINATION QString("cannot write the destination")
+
+enum class ProgressCurve : int
+{
+    LINEAR, //The progress follow the elapsed time
+    SIGMOID,//Slow start and slow end (like a real upload with host negotiation)
+    STEP    //Nothing until the whole file is "sent"
+};
+
+struct t_MockConfig
+{
+    quint16         port;
+    int             latencyMs;  //Delay before each reply
+    quint64         bandwidth;  //Upload bandwidth in Bytes/s shared by the uploads in progress (0 => instant upload)
+    ProgressCurve   curve;
+    QString         storeDir;   //Keep a copy of the uploaded files here (empty => not stored)
+};
+
+struct t_MockFile
+{
+    QString     siaPath;
+    QString     localPath;
+    quint64     size;
+    double      sentBytes;  //Part of the file sent on the shared link
+};
+
+struct t_MockStats
+{
+    quint64 requests;
+    quint64 uploads;
+    quint64 deletes;
+    quint64 downloads;
+    quint64 streams;
+    quint64 streamedBytes;
+    quint64 uploadedBytes;
+};
+
+class SiaMockServer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit SiaMockServer(const t_MockConfig config, QObject *parent = 0);
+    ~SiaMockServer(void);
+    bool start(void);
+    quint16 port(void) const;
+    t_MockStats stats(void) const;
+    static bool parseCurve(const QString str, ProgressCurve *curve);
+private slots:
+    void newConnection(void);
+    void readyRead(void);
+    void disconnected(void);
+private:
+    void handleRequest(QTcpSocket *socket, const QByteArray method, const QUrl url, const QByteArray range);
+    void reply(QTcpSocket *socket, const int status, const QByteArray body);
+    QJsonObject consensus(void);
+    QJsonObject renterSettings(void);
+    QJsonObject renterFiles(void);
+    bool upload(const QString siaPath, const QString source, QString *error);
+    bool remove(const QString siaPath, QString *error);
+    bool download(const QString siaPath, const QString destination, QString *error);
+    bool stream(const QString siaPath, const QByteArray range, QByteArray *body, bool *partial, QString *error);
+    QString storedPath(const QString siaPath, QString *error);
+    void advanceLink(void);
+    double progress(const t_MockFile &file) const;
+
+    t_MockConfig                    m_config;
+    QTcpServer                      *m_server;
+    QElapsedTimer                   m_clock;
+    qint64                          m_linkMs;   //Time of the last share of the bandwidth
+    QHash<QTcpSocket*, QByteArray>  m_buffers;
+    QHash<QString, t_MockFile>      m_files;
+    t_MockStats                     m_stats;
+};
+
+#endif // SIAMOCKSERVER_H
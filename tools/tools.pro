@@ -0,0 +1,7 @@
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    siamock \
+    benchmark \
+    microbench \
+    datagen